@@ -0,0 +1,1158 @@
+#include "client/client.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/cdc.hpp"
+#include "common/file_utils.hpp"
+#include "common/io_stats.hpp"
+#include "common/io_uring.hpp"
+#include "common/sha256.hpp"
+#include "metadata/metadata_node.hpp"
+#include "network/framing.hpp"
+#include "network/protocol.hpp"
+#include "network/tcp_client.hpp"
+#include "storage/chunk_cache.hpp"
+#include "storage/file_chunk_store.hpp"
+#include "storage/log_chunk_store.hpp"
+#include "storage/memory_chunk_store.hpp"
+#include "storage/storage_node.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <iostream>
+#include <list>
+#include <malloc.h>
+#include <mutex>
+#include <unordered_map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+
+using dfs::network::ServerMode;
+
+// Allocations of chunk-sized blocks anywhere in the process, for the
+// buffers benchmark.
+static std::atomic<uint64_t> largeAllocations{0};
+
+// Out of line, or GCC sees malloc() paired with operator delete and warns
+// of a mismatched deallocation. The sized and array forms forward here so
+// every allocation is counted and freed the same way.
+__attribute__((noinline)) void* operator new(size_t size) {
+    if (size >= dfs::common::BufferPool::kMinBuffer) largeAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+static const int BENCH_STORAGE_PORT = 8201;
+
+static void startStorageNode(int port, ServerMode mode,
+                             std::chrono::milliseconds getDelay = std::chrono::milliseconds(0)) {
+    std::thread([port, mode, getDelay]() {
+        dfs::storage::StorageNode node;
+        node.setVerbose(false);
+        node.setArtificialDelay(getDelay);
+        node.start(port, mode);
+    }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+}
+
+static void killNode(int port) {
+    dfs::network::TCPClient client;
+    if (client.connect("127.0.0.1", port)) {
+        client.sendMessage("DIE");
+        client.close();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+}
+
+static std::vector<uint8_t> randomBytes(size_t size) {
+    std::vector<uint8_t> data(size);
+    std::mt19937 gen(42);
+    for (auto& b : data) b = static_cast<uint8_t>(gen());
+    return data;
+}
+
+static bool storeChunk(int port, const std::string& hash, const std::vector<uint8_t>& data) {
+    dfs::network::TCPClient client;
+    if (!client.connect("127.0.0.1", port)) return false;
+    if (!client.sendMessage("STORE " + hash) || client.recvMessage() != "READY") return false;
+    if (!client.sendData(data)) return false;
+    return client.recvMessage() == "ACK";
+}
+
+// Aggregate GET throughput of one storage node as concurrent readers are added.
+// Every reader fetches the same 1MB chunk over its own connection.
+static void benchGetContention(ServerMode mode) {
+    const std::string modeName = mode == ServerMode::REACTOR ? "reactor" : "threaded";
+    const auto chunk = randomBytes(1024 * 1024);
+    const std::string hash = dfs::common::sha256(chunk).toHex();
+    const auto duration = std::chrono::seconds(2);
+    startStorageNode(BENCH_STORAGE_PORT, mode);
+    if (!storeChunk(BENCH_STORAGE_PORT, hash, chunk)) {
+        std::cerr << "Failed to seed storage node" << std::endl;
+        killNode(BENCH_STORAGE_PORT);
+        return;
+    }
+
+    std::cout << "\n[GET contention] 1MB chunk, " << modeName << " storage node\n";
+    std::cout << std::setw(8) << "Readers" << std::setw(14) << "GETs/s" << std::setw(14) << "MB/s" << "\n";
+    for (int readers : {1, 2, 4, 8, 16, 32}) {
+        std::atomic<long> gets{0};
+        std::atomic<long> bytes{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int r = 0; r < readers; ++r) {
+            threads.emplace_back([&]() {
+                dfs::network::TCPClient client;
+                if (!client.connect("127.0.0.1", BENCH_STORAGE_PORT)) return;
+                while (!go) std::this_thread::yield();
+                auto end = std::chrono::steady_clock::now() + duration;
+                while (std::chrono::steady_clock::now() < end) {
+                    if (!client.sendMessage("GET " + hash) || client.recvMessage() != "FOUND") return;
+                    auto data = client.recvData();
+                    if (data.empty()) return;
+                    gets++;
+                    bytes += static_cast<long>(data.size());
+                }
+            });
+        }
+        go = true;
+        for (auto& t : threads) t.join();
+        double seconds = std::chrono::duration<double>(duration).count();
+        std::cout << std::setw(8) << readers << std::setw(14) << std::fixed << std::setprecision(0)
+                  << gets / seconds << std::setw(14) << std::setprecision(1)
+                  << bytes / seconds / (1024.0 * 1024.0) << "\n";
+    }
+    killNode(BENCH_STORAGE_PORT);
+}
+
+// The in-memory table as it was before sharding: one lock, and GET copies
+// the chunk while holding it. Kept here as the baseline for benchMemoryTable.
+class SingleLockTable {
+public:
+    void put(const dfs::common::Digest& key, std::vector<uint8_t> data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks_.emplace(key, std::move(data));
+    }
+    bool get(const dfs::common::Digest& key, std::vector<uint8_t>& data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = chunks_.find(key);
+        if (it == chunks_.end()) return false;
+        data = it->second;
+        return true;
+    }
+
+private:
+    std::unordered_map<dfs::common::Digest, std::vector<uint8_t>> chunks_;
+    std::mutex mutex_;
+};
+
+// In-process GET rate of the in-memory table as reader threads are added,
+// each reading random chunks of 64 x 1MB: the old single-lock table, the
+// sharded store copying out (get) and taking a reference (getShared).
+static void benchMemoryTable() {
+    const int chunkCount = 64;
+    const auto duration = std::chrono::milliseconds(500);
+    SingleLockTable baseline;
+    dfs::storage::MemoryChunkStore sharded;
+    std::vector<dfs::common::Digest> keys;
+    std::mt19937 gen(16);
+    for (int i = 0; i < chunkCount; ++i) {
+        std::vector<uint8_t> chunk(1024 * 1024);
+        for (auto& b : chunk) b = static_cast<uint8_t>(gen());
+        keys.push_back(dfs::common::sha256(chunk));
+        baseline.put(keys.back(), chunk);
+        sharded.put(keys.back(), std::move(chunk));
+    }
+
+    auto rate = [&](int readers, const std::function<bool(const dfs::common::Digest&)>& getOne) {
+        std::atomic<long> gets{0};
+        std::vector<std::thread> threads;
+        for (int r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r]() {
+                std::mt19937 pick(static_cast<unsigned>(r));
+                auto end = std::chrono::steady_clock::now() + duration;
+                long local = 0;
+                while (std::chrono::steady_clock::now() < end) {
+                    if (getOne(keys[pick() % keys.size()])) local++;
+                }
+                gets += local;
+            });
+        }
+        for (auto& t : threads) t.join();
+        return gets / std::chrono::duration<double>(duration).count();
+    };
+
+    std::cout << "\n[Memory table] GETs/s, " << chunkCount << " x 1MB chunks, in process\n";
+    std::cout << std::setw(8) << "Readers" << std::setw(16) << "single-lock" << std::setw(16) << "sharded copy"
+              << std::setw(16) << "sharded ref" << "\n";
+    for (int readers : {1, 2, 4, 8, 16}) {
+        double oldRate = rate(readers, [&](const dfs::common::Digest& key) {
+            std::vector<uint8_t> data;
+            return baseline.get(key, data);
+        });
+        double copyRate = rate(readers, [&](const dfs::common::Digest& key) {
+            std::vector<uint8_t> data;
+            return sharded.get(key, data);
+        });
+        double refRate = rate(readers, [&](const dfs::common::Digest& key) { return sharded.getShared(key) != nullptr; });
+        std::cout << std::setw(8) << readers << std::setw(16) << std::fixed << std::setprecision(0) << oldRate
+                  << std::setw(16) << copyRate << std::setw(16) << refRate << "\n";
+    }
+}
+
+// Distinct random 1MB chunks, one list per client connection.
+// Plain byte-budgeted LRU, the baseline benchCache compares 2Q against.
+class LruCache {
+public:
+    explicit LruCache(size_t budget) : budget_(budget) {}
+    dfs::storage::SharedChunk lookup(const dfs::common::Digest& key) {
+        auto it = entries_.find(key);
+        if (it == entries_.end()) return nullptr;
+        order_.splice(order_.begin(), order_, it->second.second);
+        return it->second.first;
+    }
+    void insert(const dfs::common::Digest& key, dfs::storage::SharedChunk chunk) {
+        bytes_ += chunk->size();
+        entries_.emplace(key, std::make_pair(std::move(chunk), order_.insert(order_.begin(), key)));
+        while (bytes_ > budget_) {
+            auto it = entries_.find(order_.back());
+            bytes_ -= it->second.first->size();
+            entries_.erase(it);
+            order_.pop_back();
+        }
+    }
+
+private:
+    using Entry = std::pair<dfs::storage::SharedChunk, std::list<dfs::common::Digest>::iterator>;
+    const size_t budget_;
+    size_t bytes_{0};
+    std::unordered_map<dfs::common::Digest, Entry> entries_;
+    std::list<dfs::common::Digest> order_;
+};
+
+// Hit rates of LRU and 2Q with an 8MB budget over a trace that mixes reads
+// of a hot set of 64 x 64KB chunks (shared by many files) with whole-file
+// downloads, i.e. sequential scans of chunks that are read once each.
+static void benchCache() {
+    const size_t chunkSize = 64 * 1024;
+    const size_t budget = 8 * 1024 * 1024;
+    const int hotChunks = 64;
+    const int accesses = 200000;
+    auto keyFor = [](uint32_t n) {
+        dfs::common::Digest key{};
+        for (int i = 0; i < 4; ++i) key.bytes[i] = static_cast<uint8_t>(n >> (8 * i));
+        key.bytes[dfs::common::Digest::kSize - 1] = 1;
+        return key;
+    };
+    auto buffer = std::make_shared<const std::vector<uint8_t>>(chunkSize);
+
+    std::cout << "\n[Cache] hit rate, 8MB budget, 4MB hot set mixed with scans of once-read chunks\n";
+    std::cout << std::setw(10) << "Hot share" << std::setw(12) << "LRU hot" << std::setw(12) << "2Q hot"
+              << std::setw(12) << "LRU all" << std::setw(12) << "2Q all" << "\n";
+    for (double hotShare : {0.5, 0.25, 0.1}) {
+        LruCache lru(budget);
+        dfs::storage::ChunkCache twoQ(budget);
+        long lruHot = 0, twoQHot = 0, lruAll = 0, twoQAll = 0, hotTotal = 0;
+        std::mt19937 gen(17);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        uint32_t nextScan = 1u << 20;
+        for (int i = 0; i < accesses; ++i) {
+            bool hot = coin(gen) < hotShare;
+            dfs::common::Digest key = keyFor(hot ? gen() % hotChunks : nextScan++);
+            bool lruHit = lru.lookup(key) != nullptr;
+            if (!lruHit) lru.insert(key, buffer);
+            bool twoQHit = twoQ.lookup(key) != nullptr;
+            if (!twoQHit) twoQ.insert(key, buffer);
+            lruAll += lruHit;
+            twoQAll += twoQHit;
+            if (hot) {
+                hotTotal++;
+                lruHot += lruHit;
+                twoQHot += twoQHit;
+            }
+        }
+        std::cout << std::setw(9) << std::fixed << std::setprecision(0) << hotShare * 100 << "%"
+                  << std::setprecision(1) << std::setw(11) << 100.0 * lruHot / hotTotal << "%" << std::setw(11)
+                  << 100.0 * twoQHot / hotTotal << "%" << std::setw(11) << 100.0 * lruAll / accesses << "%"
+                  << std::setw(11) << 100.0 * twoQAll / accesses << "%\n";
+    }
+}
+
+struct ChunkSet {
+    std::vector<std::vector<std::vector<uint8_t>>> data;
+    std::vector<std::vector<std::string>> hashes;
+};
+
+static ChunkSet makeChunkSet(int clients, int chunksPerClient) {
+    ChunkSet set;
+    set.data.resize(clients);
+    set.hashes.resize(clients);
+    std::mt19937 gen(9);
+    for (int c = 0; c < clients; ++c) {
+        for (int i = 0; i < chunksPerClient; ++i) {
+            std::vector<uint8_t> chunk(1024 * 1024);
+            for (auto& b : chunk) b = static_cast<uint8_t>(gen());
+            set.hashes[c].push_back(dfs::common::sha256(chunk).toHex());
+            set.data[c].push_back(std::move(chunk));
+        }
+    }
+    return set;
+}
+
+struct LoadResult {
+    double storeMBps{0};
+    double getMBps{0};
+    // Node-side I/O system calls per chunk, from dfs::common::syscallCount().
+    double storeSyscalls{0};
+    double getSyscalls{0};
+};
+
+// Each client stores its chunks over its own connection, then every client
+// GETs random stored chunks for readDuration.
+static LoadResult runStoreGetLoad(int port, const ChunkSet& set, std::chrono::seconds readDuration) {
+    const int clients = static_cast<int>(set.data.size());
+    LoadResult result;
+    std::atomic<long> stored{0};
+    std::atomic<long> storedBytes{0};
+    std::vector<std::thread> threads;
+    uint64_t syscallsBefore = dfs::common::syscallCount();
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c]() {
+            for (size_t i = 0; i < set.data[c].size(); ++i) {
+                if (!storeChunk(port, set.hashes[c][i], set.data[c][i])) continue;
+                stored++;
+                storedBytes += static_cast<long>(set.data[c][i].size());
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    double storeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t storeSyscalls = dfs::common::syscallCount() - syscallsBefore;
+
+    std::atomic<long> gets{0};
+    std::atomic<long> read{0};
+    threads.clear();
+    syscallsBefore = dfs::common::syscallCount();
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c]() {
+            dfs::network::TCPClient client;
+            if (!client.connect("127.0.0.1", port)) return;
+            std::mt19937 pick(static_cast<unsigned>(c));
+            auto end = std::chrono::steady_clock::now() + readDuration;
+            while (std::chrono::steady_clock::now() < end) {
+                const auto& hashes = set.hashes[pick() % clients];
+                if (!client.sendMessage("GET " + hashes[pick() % hashes.size()]) || client.recvMessage() != "FOUND") {
+                    return;
+                }
+                read += static_cast<long>(client.recvData().size());
+                gets++;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    uint64_t getSyscalls = dfs::common::syscallCount() - syscallsBefore;
+    double readSeconds = std::chrono::duration<double>(readDuration).count();
+
+    result.storeMBps = storedBytes / storeSeconds / (1024.0 * 1024.0);
+    result.getMBps = read / readSeconds / (1024.0 * 1024.0);
+    if (stored > 0) result.storeSyscalls = static_cast<double>(storeSyscalls) / stored;
+    if (gets > 0) result.getSyscalls = static_cast<double>(getSyscalls) / gets;
+    return result;
+}
+
+// Sustained STORE then GET throughput of one reactor storage node per engine.
+// Writers store distinct 1MB chunks over their own connections; readers then
+// fetch random stored chunks for a fixed time.
+static void benchStore() {
+    using dfs::storage::FsyncPolicy;
+    using dfs::storage::StoreEngine;
+    const std::string dir = "bench_chunk_store";
+    const int clients = 4;
+    const int chunksPerClient = 32;
+    const ChunkSet set = makeChunkSet(clients, chunksPerClient);
+
+    // "copy" cases serve GET through get() instead of sendfile(2).
+    struct EngineCase {
+        const char* label;
+        StoreEngine engine;
+        FsyncPolicy fsync;
+        bool zeroCopy;
+    };
+    std::cout << "\n[Store engines] " << clients << " clients x " << chunksPerClient << " x 1MB, reactor node\n";
+    std::cout << std::setw(16) << "Engine" << std::setw(14) << "STORE MB/s" << std::setw(14) << "GET MB/s" << "\n";
+    for (const EngineCase& engine : {EngineCase{"memory", StoreEngine::MEMORY, FsyncPolicy::NEVER, true},
+                                     EngineCase{"log/never", StoreEngine::LOG, FsyncPolicy::NEVER, true},
+                                     EngineCase{"log/interval", StoreEngine::LOG, FsyncPolicy::INTERVAL, true},
+                                     EngineCase{"log/always", StoreEngine::LOG, FsyncPolicy::ALWAYS, true},
+                                     EngineCase{"log/copy", StoreEngine::LOG, FsyncPolicy::NEVER, false},
+                                     EngineCase{"files", StoreEngine::FILES, FsyncPolicy::NEVER, true},
+                                     EngineCase{"files/copy", StoreEngine::FILES, FsyncPolicy::NEVER, false}}) {
+        std::filesystem::remove_all(dir);
+        std::thread([engine, dir]() {
+            std::unique_ptr<dfs::storage::ChunkStore> store;
+            if (engine.engine == StoreEngine::LOG) {
+                dfs::storage::LogStoreOptions options;
+                options.fsync = engine.fsync;
+                store.reset(new dfs::storage::LogChunkStore(dir, options));
+            } else if (engine.engine == StoreEngine::FILES) {
+                store.reset(new dfs::storage::FileChunkStore(dir, engine.fsync == FsyncPolicy::ALWAYS));
+            }
+            dfs::storage::StorageNode node(std::move(store));
+            node.setVerbose(false);
+            node.setZeroCopy(engine.zeroCopy);
+            node.start(BENCH_STORAGE_PORT, ServerMode::REACTOR);
+        }).detach();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+        LoadResult result = runStoreGetLoad(BENCH_STORAGE_PORT, set, std::chrono::seconds(2));
+        std::cout << std::setw(16) << engine.label << std::setw(14) << std::fixed << std::setprecision(1)
+                  << result.storeMBps << std::setw(14) << result.getMBps << "\n";
+        killNode(BENCH_STORAGE_PORT);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+// The same STORE/GET load against the files engine with each I/O backend:
+// epoll plus one system call per operation, io_uring, and io_uring with a
+// kernel SQ polling thread. Syscalls are counted on the node side only.
+static void benchIo() {
+    const std::string dir = "bench_chunk_io";
+    const int clients = 4;
+    const int chunksPerClient = 32;
+    const ChunkSet set = makeChunkSet(clients, chunksPerClient);
+    if (!dfs::common::IoUring::supported()) std::cout << "\n(io_uring unavailable: uring rows use the fallback)";
+
+    struct BackendCase {
+        const char* label;
+        ServerMode mode;
+        bool sqpoll;
+    };
+    std::cout << "\n[I/O backends] " << clients << " clients x " << chunksPerClient
+              << " x 1MB, files engine\n";
+    std::cout << std::setw(14) << "Backend" << std::setw(12) << "STORE MB/s" << std::setw(12) << "GET MB/s"
+              << std::setw(16) << "syscalls/STORE" << std::setw(14) << "syscalls/GET" << "\n";
+    for (const BackendCase& backend : {BackendCase{"epoll+posix", ServerMode::REACTOR, false},
+                                       BackendCase{"uring", ServerMode::URING, false},
+                                       BackendCase{"uring+sqpoll", ServerMode::URING, true}}) {
+        std::filesystem::remove_all(dir);
+        std::thread([backend, dir]() {
+            dfs::common::IoBackend io =
+                backend.mode == ServerMode::URING ? dfs::common::IoBackend::URING : dfs::common::IoBackend::POSIX;
+            std::unique_ptr<dfs::storage::ChunkStore> store(new dfs::storage::FileChunkStore(dir, false, io));
+            dfs::storage::StorageNode node(std::move(store));
+            node.setVerbose(false);
+            node.setSqPoll(backend.sqpoll);
+            node.start(BENCH_STORAGE_PORT, backend.mode);
+        }).detach();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+        LoadResult result = runStoreGetLoad(BENCH_STORAGE_PORT, set, std::chrono::seconds(2));
+        std::cout << std::setw(14) << backend.label << std::setw(12) << std::fixed << std::setprecision(1)
+                  << result.storeMBps << std::setw(12) << result.getMBps << std::setw(16) << result.storeSyscalls
+                  << std::setw(14) << result.getSyscalls << "\n";
+        killNode(BENCH_STORAGE_PORT);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+// Single-thread SHA-256 throughput of every kernel this CPU supports, on one
+// chunk-sized buffer hashed repeatedly.
+// Uploads a 64MB file to two storage nodes (two replicas) and then uploads
+// it again: the second pass only probes the replicas with HAS_MULTI.
+static void benchDedup() {
+    const int storagePorts[] = {BENCH_STORAGE_PORT, BENCH_STORAGE_PORT + 1};
+    const int metadataPort = BENCH_STORAGE_PORT + 2;
+    for (int port : storagePorts) startStorageNode(port, ServerMode::REACTOR);
+    std::thread([metadataPort]() {
+        dfs::metadata::MetadataNode node("", -1);
+        node.start(metadataPort, ServerMode::REACTOR);
+    }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    const std::string filename = "bench_dedup.bin";
+    {
+        std::vector<uint8_t> data = randomBytes(64 * 1024 * 1024);
+        std::ofstream f(filename, std::ios::binary);
+        f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+    dfs::client::Client client({"127.0.0.1:" + std::to_string(storagePorts[0]),
+                                "127.0.0.1:" + std::to_string(storagePorts[1])},
+                               {"127.0.0.1:" + std::to_string(metadataPort)});
+
+    std::cout << "\n[Dedup] 64MB file, 2 replicas\n";
+    std::cout << std::setw(12) << "Upload" << std::setw(14) << "Sent MB" << std::setw(14) << "Skipped MB"
+              << std::setw(12) << "ms" << "\n";
+    for (const char* pass : {"first", "again"}) {
+        // The client narrates every chunk; keep the table readable.
+        std::ostringstream discard;
+        std::streambuf* out = std::cout.rdbuf(discard.rdbuf());
+        client.uploadFile(filename);
+        std::cout.rdbuf(out);
+        std::cout << std::setw(12) << pass << std::fixed << std::setprecision(1) << std::setw(14)
+                  << client.lastUploadBytesSent / (1024.0 * 1024.0) << std::setw(14)
+                  << client.lastUploadBytesSkipped / (1024.0 * 1024.0) << std::setw(12)
+                  << client.lastChunkUploadDuration << "\n";
+    }
+    std::remove(filename.c_str());
+    for (int port : storagePorts) killNode(port);
+    killNode(metadataPort);
+}
+
+// Cut-point search speed of each content-defined chunking kernel, then the
+// share of an edited file's bytes that land in chunks the original already
+// had, for fixed and content-defined chunking.
+static void benchChunking() {
+    const auto data = randomBytes(256 * 1024 * 1024);
+    std::cout << "\n[Chunking] 256MB buffer, active kernel: "
+              << dfs::common::cdcKernelName(dfs::common::activeCdcKernel()) << "\n";
+    std::cout << std::setw(10) << "Kernel" << std::setw(12) << "GB/s" << std::setw(12) << "Chunks" << "\n";
+    for (auto kernel : dfs::common::supportedCdcKernels()) {
+        auto start = std::chrono::steady_clock::now();
+        size_t chunks = dfs::common::cdcSplit(data.data(), data.size(), kernel).size();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(10) << dfs::common::cdcKernelName(kernel) << std::setw(12) << std::fixed
+                  << std::setprecision(3) << data.size() / seconds / 1e9 << std::setw(12) << chunks << "\n";
+    }
+
+    auto split = [](const std::vector<uint8_t>& file, dfs::common::Chunking chunking) {
+        std::vector<size_t> lengths;
+        if (chunking == dfs::common::Chunking::CONTENT_DEFINED) return dfs::common::cdcSplit(file.data(), file.size());
+        for (size_t offset = 0; offset < file.size(); offset += dfs::common::CHUNK_SIZE) {
+            lengths.push_back(std::min<size_t>(dfs::common::CHUNK_SIZE, file.size() - offset));
+        }
+        return lengths;
+    };
+    auto dedupRatio = [&](const std::vector<uint8_t>& original, const std::vector<uint8_t>& edited,
+                          dfs::common::Chunking chunking) {
+        std::unordered_set<dfs::common::Digest> known;
+        size_t offset = 0;
+        for (size_t length : split(original, chunking)) {
+            known.insert(dfs::common::sha256(original.data() + offset, length));
+            offset += length;
+        }
+        size_t shared = 0;
+        offset = 0;
+        for (size_t length : split(edited, chunking)) {
+            if (known.count(dfs::common::sha256(edited.data() + offset, length))) shared += length;
+            offset += length;
+        }
+        return 100.0 * static_cast<double>(shared) / static_cast<double>(edited.size());
+    };
+
+    const std::vector<uint8_t> original(data.begin(), data.begin() + 64 * 1024 * 1024);
+    struct Edit {
+        const char* name;
+        std::function<void(std::vector<uint8_t>&)> apply;
+    };
+    const Edit edits[] = {
+        {"insert 1B at start", [](std::vector<uint8_t>& f) { f.insert(f.begin(), 0x5a); }},
+        {"insert 4KB mid", [](std::vector<uint8_t>& f) { f.insert(f.begin() + f.size() / 2, 4096, 0x5a); }},
+        {"delete 100KB at 1/3", [](std::vector<uint8_t>& f) {
+             f.erase(f.begin() + f.size() / 3, f.begin() + f.size() / 3 + 100 * 1024);
+         }},
+        {"overwrite 100B mid", [](std::vector<uint8_t>& f) { std::fill_n(f.begin() + f.size() / 2, 100, 0x5a); }},
+        {"append 1MB", [](std::vector<uint8_t>& f) { f.insert(f.end(), 1024 * 1024, 0x5a); }},
+    };
+    std::cout << "\n[Chunking] bytes of an edited 64MB file already stored\n";
+    std::cout << std::setw(20) << "Edit" << std::setw(12) << "fixed" << std::setw(12) << "cdc" << "\n";
+    for (const Edit& edit : edits) {
+        std::vector<uint8_t> edited = original;
+        edit.apply(edited);
+        std::cout << std::setw(20) << edit.name << std::setw(11) << std::setprecision(1)
+                  << dedupRatio(original, edited, dfs::common::Chunking::FIXED) << "%" << std::setw(11)
+                  << dedupRatio(original, edited, dfs::common::Chunking::CONTENT_DEFINED) << "%\n";
+    }
+}
+
+static void benchSha256() {
+    const auto data = randomBytes(1024 * 1024);
+    const auto duration = std::chrono::seconds(1);
+    std::cout << "\n[SHA-256] 1MB buffer, active kernel: "
+              << dfs::common::sha256KernelName(dfs::common::activeSha256Kernel()) << "\n";
+    std::cout << std::setw(10) << "Kernel" << std::setw(12) << "GB/s" << "\n";
+    for (auto kernel : dfs::common::supportedSha256Kernels()) {
+        long hashed = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::steady_clock::duration::zero();
+        while (elapsed < duration) {
+            dfs::common::sha256(data.data(), data.size(), kernel);
+            hashed += static_cast<long>(data.size());
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        std::cout << std::setw(10) << dfs::common::sha256KernelName(kernel) << std::setw(12) << std::fixed
+                  << std::setprecision(3) << hashed / seconds / 1e9 << "\n";
+    }
+
+    // Multi-buffer kernels, fed 16 buffers per call like computeCID would.
+    std::vector<const uint8_t*> buffers(16, data.data());
+    for (auto kernel : dfs::common::supportedSha256BatchKernels()) {
+        if (kernel == dfs::common::Sha256BatchKernel::NONE) continue;
+        long hashed = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::steady_clock::duration::zero();
+        while (elapsed < duration) {
+            dfs::common::sha256Batch(buffers, data.size(), kernel);
+            hashed += static_cast<long>(data.size() * buffers.size());
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        std::cout << std::setw(10) << dfs::common::sha256BatchKernelName(kernel) << std::setw(12) << std::fixed
+                  << std::setprecision(3) << hashed / seconds / 1e9 << "\n";
+    }
+}
+
+// Message size and encode/parse cost of a 1000-chunk file's metadata in
+// each wire format, then a 1000-digest HAS_MULTI round trip to a node.
+static void benchProtocol() {
+    using dfs::network::MessageReader;
+    using dfs::network::MessageWriter;
+    using dfs::network::Opcode;
+    const int chunks = 1000;
+    const int iterations = 2000;
+    std::cout << "\n[Protocol] " << chunks << "-chunk metadata, " << iterations << " iterations\n";
+    std::cout << std::setw(22) << "Message" << std::setw(10) << "Format" << std::setw(10) << "Bytes"
+              << std::setw(14) << "Encode us" << std::setw(13) << "Parse us" << "\n";
+
+    auto microsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::mt19937 gen(21);
+    for (bool contentDefined : {false, true}) {
+        dfs::common::FileMetadata meta;
+        meta.filename = "bench_protocol.bin";
+        meta.chunkSize = contentDefined ? 0 : dfs::common::CHUNK_SIZE;
+        meta.totalChunks = chunks;
+        meta.fileSize = static_cast<int64_t>(chunks) * dfs::common::CHUNK_SIZE;
+        meta.rootHash = dfs::common::sha256(randomBytes(64));
+        for (int i = 0; i < chunks; ++i) {
+            std::vector<uint8_t> seed(8);
+            for (auto& b : seed) b = static_cast<uint8_t>(gen());
+            meta.chunkHashes.push_back(dfs::common::sha256(seed));
+            if (contentDefined) {
+                size_t size = dfs::common::CDC_MIN_SIZE + gen() % dfs::common::CDC_AVG_SIZE;
+                meta.chunkSizes.push_back(static_cast<uint32_t>(size));
+            }
+        }
+        const std::string label = contentDefined ? "PUT (content-defined)" : "PUT (fixed)";
+
+        size_t textBytes = 0, binaryBytes = 0;
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            textBytes = ("PUT " + meta.filename + " " + dfs::network::formatTextMetadata(meta)).size();
+        }
+        double textEncode = microsSince(start);
+        std::string text = dfs::network::formatTextMetadata(meta);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            dfs::common::FileMetadata parsed;
+            ok = dfs::network::parseTextMetadata(text, parsed) && ok;
+        }
+        double textParse = microsSince(start);
+
+        std::vector<uint8_t> frame;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            MessageWriter writer(Opcode::PUT_META, static_cast<uint64_t>(i));
+            dfs::network::writeFileMetadata(writer, meta);
+            frame = writer.finish();
+        }
+        double binaryEncode = microsSince(start);
+        binaryBytes = frame.size();
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            dfs::network::MessageHeader header;
+            MessageReader payload;
+            dfs::common::FileMetadata parsed;
+            ok = dfs::network::parseMessage(frame, header, payload) &&
+                 dfs::network::readFileMetadata(payload, parsed) && ok;
+        }
+        double binaryParse = microsSince(start);
+        if (!ok) std::cerr << "Protocol benchmark: a message failed to parse\n";
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << std::setw(22) << label << std::setw(10) << "text" << std::setw(10) << textBytes << std::setw(14)
+                  << textEncode / iterations << std::setw(13) << textParse / iterations << "\n";
+        std::cout << std::setw(22) << label << std::setw(10) << "binary" << std::setw(10) << binaryBytes
+                  << std::setw(14) << binaryEncode / iterations << std::setw(13) << binaryParse / iterations << "\n";
+    }
+
+    // The same probe over a connection, where the node parses the request.
+    startStorageNode(BENCH_STORAGE_PORT, ServerMode::REACTOR);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::vector<dfs::common::Digest> digests;
+    for (int i = 0; i < chunks; ++i) digests.push_back(dfs::common::sha256(randomBytes(16)));
+    std::string textProbe = "HAS_MULTI ";
+    for (int i = 0; i < chunks; ++i) textProbe += (i == 0 ? "" : ",") + digests[i].toHex();
+    const int rounds = 200;
+    dfs::network::TCPClient conn;
+    if (!conn.connect("127.0.0.1", BENCH_STORAGE_PORT)) {
+        std::cerr << "Protocol benchmark: storage node unreachable\n";
+        return;
+    }
+    for (bool binary : {false, true}) {
+        size_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            if (binary) {
+                MessageWriter request(Opcode::HAS_MULTI, static_cast<uint64_t>(i));
+                request.u32(static_cast<uint32_t>(digests.size()));
+                for (const auto& digest : digests) request.digest(digest);
+                std::vector<uint8_t> frame = request.finish();
+                bytes = frame.size();
+                conn.sendData(frame);
+                conn.recvData();
+            } else {
+                bytes = textProbe.size();
+                conn.sendMessage(textProbe);
+                conn.recvMessage();
+            }
+        }
+        double us = microsSince(start);
+        std::cout << std::setw(22) << "HAS_MULTI round trip" << std::setw(10) << (binary ? "binary" : "text")
+                  << std::setw(10) << bytes << std::setw(27) << us / rounds << "\n";
+    }
+    conn.close();
+    killNode(BENCH_STORAGE_PORT);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+}
+
+// Open sockets of this process; the nodes run in-process, so a connection
+// counts on both ends.
+static long openSockets() {
+    long count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+        std::error_code ec;
+        auto target = std::filesystem::read_symlink(entry.path(), ec);
+        if (!ec && target.string().compare(0, 7, "socket:") == 0) count++;
+    }
+    return count;
+}
+
+// Chunk GETs from 32 concurrent callers over pooled lockstep connections
+// versus one multiplexed connection, against a fast node and one that takes
+// 5 ms per GET, in both server modes.
+static void benchMultiplex() {
+    const int callers = 32;
+    const auto chunk = randomBytes(64 * 1024);
+    const auto hash = dfs::common::sha256(chunk);
+    std::cout << "\n[Multiplex] 64KB chunk GETs, " << callers << " concurrent callers, one node\n";
+    std::cout << std::setw(10) << "Server" << std::setw(10) << "Service" << std::setw(14) << "Transport"
+              << std::setw(10) << "GETs" << std::setw(12) << "GETs/s" << std::setw(14) << "Connections" << "\n";
+    for (ServerMode mode : {ServerMode::THREADED, ServerMode::REACTOR}) {
+        for (int delayMs : {0, 5}) {
+            startStorageNode(BENCH_STORAGE_PORT, mode, std::chrono::milliseconds(delayMs));
+            storeChunk(BENCH_STORAGE_PORT, hash.toHex(), chunk);
+            const std::string node = "127.0.0.1:" + std::to_string(BENCH_STORAGE_PORT);
+            const int gets = delayMs == 0 ? 20000 : 3200;
+            for (bool multiplex : {false, true}) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(300));
+                const long baseline = openSockets();
+                dfs::client::PoolOptions poolOptions;
+                poolOptions.maxIdlePerNode = callers;
+                dfs::client::Client client({node}, {}, std::make_shared<dfs::client::ConnectionPool>(poolOptions));
+                client.setMultiplexing(multiplex);
+                std::atomic<int> next{0}, failed{0};
+                std::atomic<bool> running{true};
+                std::atomic<long> peak{0};
+                std::thread sampler([&]() {
+                    while (running) {
+                        peak = std::max(peak.load(), openSockets() - baseline);
+                        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    }
+                });
+                auto start = std::chrono::steady_clock::now();
+                std::vector<std::thread> threads;
+                for (int t = 0; t < callers; ++t) {
+                    threads.emplace_back([&]() {
+                        while (next++ < gets) {
+                            if (client.downloadChunkFromNode(hash, node).size() != chunk.size()) failed++;
+                        }
+                    });
+                }
+                for (auto& t : threads) t.join();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                running = false;
+                sampler.join();
+                std::cout << std::setw(10) << (mode == ServerMode::REACTOR ? "reactor" : "threaded") << std::setw(8)
+                          << delayMs << "ms" << std::setw(14) << (multiplex ? "multiplexed" : "pooled")
+                          << std::setw(10) << gets << std::setw(12) << std::fixed << std::setprecision(0)
+                          << gets / seconds << std::setw(14) << peak / 2 << "\n";
+                if (failed > 0) std::cerr << "Multiplex benchmark: " << failed << " GETs failed\n";
+            }
+            killNode(BENCH_STORAGE_PORT);
+        }
+    }
+}
+
+// Round trips of small messages on one connection (a binary HAS and its
+// 21-byte answer), and 1MB GET throughput, per server mode, with the
+// kernel's socket buffer autotuning and with fixed 4MB buffers.
+static void benchRtt() {
+    const int roundTrips = 20000;
+    const auto chunk = randomBytes(1024 * 1024);
+    const auto hash = dfs::common::sha256(chunk);
+    std::cout << "\n[RTT] " << roundTrips << " small round trips on one connection, then 1MB GETs\n";
+    std::cout << std::setw(10) << "Server" << std::setw(10) << "Buffers" << std::setw(12) << "mean us" << std::setw(10)
+              << "p50 us" << std::setw(10) << "p99 us" << std::setw(16) << "syscalls/RTT" << std::setw(14)
+              << "1MB GET MB/s" << "\n";
+    for (int buffers : {0, 4 * 1024 * 1024}) {
+        for (ServerMode mode : {ServerMode::THREADED, ServerMode::REACTOR}) {
+            dfs::network::setSocketBufferBytes(buffers);
+            startStorageNode(BENCH_STORAGE_PORT, mode);
+            storeChunk(BENCH_STORAGE_PORT, hash.toHex(), chunk);
+            dfs::network::TCPClient conn;
+            if (!conn.connect("127.0.0.1", BENCH_STORAGE_PORT)) {
+                std::cerr << "RTT benchmark: storage node unreachable\n";
+                return;
+            }
+            dfs::network::MessageWriter has(dfs::network::Opcode::HAS, 1);
+            has.digest(hash);
+            const std::vector<uint8_t> request = has.finish();
+            std::vector<double> samples;
+            samples.reserve(roundTrips);
+            uint64_t syscallsBefore = dfs::common::syscallCount();
+            for (int i = 0; i < roundTrips; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                conn.sendData(request);
+                conn.recvData();
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                samples.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+            }
+            double syscalls = static_cast<double>(dfs::common::syscallCount() - syscallsBefore) / roundTrips;
+            double mean = 0;
+            for (double sample : samples) mean += sample / roundTrips;
+            std::sort(samples.begin(), samples.end());
+
+            const int gets = 500;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < gets; ++i) {
+                conn.sendMessage("GET " + hash.toHex());
+                conn.recvMessage();
+                conn.recvData();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            conn.close();
+            std::cout << std::setw(10) << (mode == ServerMode::REACTOR ? "reactor" : "threaded") << std::setw(10)
+                      << (buffers > 0 ? "4MB" : "auto") << std::fixed
+                      << std::setprecision(1) << std::setw(12) << mean << std::setw(10) << samples[samples.size() / 2]
+                      << std::setw(10) << samples[samples.size() * 99 / 100] << std::setw(16) << syscalls
+                      << std::setw(14) << std::setprecision(0) << gets * chunk.size() / seconds / (1024 * 1024) << "\n";
+            killNode(BENCH_STORAGE_PORT);
+        }
+    }
+    dfs::network::setSocketBufferBytes(0);
+}
+
+static double residentMB() {
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return static_cast<double>(resident) * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+// A soak of STORE, GET and DELETE rounds from concurrent clients, with
+// chunks between 256KB and 1MB, against a files-engine node in this
+// process, with the buffer pool off and on:
+// chunk-sized allocations per round (client and node together), resident
+// memory, and the free memory malloc holds on to, a measure of how
+// fragmented its heap has become.
+static void benchBuffers() {
+    const std::string dir = "bench_buffers";
+    const int clients = 4;
+    const int rounds = 1000;
+    std::vector<std::vector<uint8_t>> chunks;
+    std::vector<std::string> hashes;
+    std::mt19937 gen(7);
+    for (int i = 0; i < 32; ++i) {
+        std::vector<uint8_t> chunk = randomBytes(256 * 1024 + gen() % (768 * 1024));
+        chunk[0] = static_cast<uint8_t>(i);
+        hashes.push_back(dfs::common::sha256(chunk).toHex());
+        chunks.push_back(std::move(chunk));
+    }
+
+    std::cout << "\n[Buffers] " << clients << " clients x " << rounds
+              << " rounds of STORE + GET + DELETE, 256KB-1MB chunks, files engine\n";
+    std::cout << std::setw(8) << "Pool" << std::setw(14) << "allocs/round" << std::setw(12) << "reuses" << std::setw(12)
+              << "RSS MB" << std::setw(14) << "RSS grew MB" << std::setw(16) << "malloc free MB" << std::setw(14)
+              << "pool idle MB" << std::setw(12) << "rounds/s" << "\n";
+    for (bool pooled : {false, true}) {
+        dfs::common::BufferPool& pool = dfs::common::BufferPool::shared();
+        pool.setBudget(pooled ? dfs::common::BufferPool::kDefaultBudget : 0);
+        malloc_trim(0);
+        std::filesystem::remove_all(dir);
+        std::thread([dir]() {
+            dfs::storage::StorageNode node(
+                std::unique_ptr<dfs::storage::ChunkStore>(new dfs::storage::FileChunkStore(dir, false)));
+            node.setVerbose(false);
+            node.start(BENCH_STORAGE_PORT, ServerMode::REACTOR);
+        }).detach();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+        // Each client cycles through its own quarter of the chunks.
+        auto round = [&](dfs::network::TCPClient& conn, int client, int i) {
+            size_t k = static_cast<size_t>(client + clients * i) % chunks.size();
+            bool ok = conn.sendMessage("STORE " + hashes[k]) && conn.recvMessage() == "READY" &&
+                      conn.sendData(chunks[k]) && conn.recvMessage() == "ACK";
+            ok = ok && conn.sendMessage("GET " + hashes[k]) && conn.recvMessage() == "FOUND";
+            std::vector<uint8_t> data = ok ? conn.recvData() : std::vector<uint8_t>();
+            ok = ok && data.size() == chunks[k].size();
+            pool.release(std::move(data));
+            return ok && conn.sendMessage("DELETE " + hashes[k]) && conn.recvMessage() == "ACK";
+        };
+        std::vector<std::unique_ptr<dfs::network::TCPClient>> conns;
+        for (int c = 0; c < clients; ++c) {
+            conns.emplace_back(new dfs::network::TCPClient());
+            if (!conns.back()->connect("127.0.0.1", BENCH_STORAGE_PORT)) {
+                std::cerr << "Buffers benchmark: storage node unreachable\n";
+                return;
+            }
+        }
+        std::atomic<int> failed{0};
+        auto run = [&](int count) {
+            std::vector<std::thread> threads;
+            for (int c = 0; c < clients; ++c) {
+                threads.emplace_back([&, c]() {
+                    for (int i = 0; i < count; ++i) {
+                        if (!round(*conns[c], c, i)) failed++;
+                    }
+                });
+            }
+            for (auto& t : threads) t.join();
+        };
+        // Warm-up, so both runs are measured from a steady state.
+        run(16);
+        double rssBefore = residentMB();
+        uint64_t allocationsBefore = largeAllocations;
+        uint64_t reusesBefore = pool.stats().reuses;
+        failed = 0;
+        auto start = std::chrono::steady_clock::now();
+        run(rounds);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double allocations = static_cast<double>(largeAllocations - allocationsBefore) / (clients * rounds);
+        double rss = residentMB();
+        struct mallinfo2 heap = mallinfo2();
+        std::cout << std::setw(8) << (pooled ? "on" : "off") << std::fixed << std::setprecision(2) << std::setw(14)
+                  << allocations << std::setw(12) << pool.stats().reuses - reusesBefore << std::setprecision(1)
+                  << std::setw(12) << rss << std::setw(14) << rss - rssBefore << std::setw(16)
+                  << static_cast<double>(heap.fordblks) / (1024 * 1024) << std::setw(14)
+                  << static_cast<double>(pool.stats().idleBytes) / (1024 * 1024) << std::setw(12)
+                  << clients * rounds / seconds << "\n";
+        if (failed > 0) std::cerr << "Buffers benchmark: " << failed << " rounds failed\n";
+        for (auto& conn : conns) conn->close();
+        killNode(BENCH_STORAGE_PORT);
+    }
+    dfs::common::BufferPool::shared().setBudget(dfs::common::BufferPool::kDefaultBudget);
+    std::filesystem::remove_all(dir);
+}
+
+// Many 4KB files uploaded with one STORE per chunk against STORE_MULTI
+// batches; each pass writes fresh content so nothing is skipped as stored.
+static void benchSmallFiles() {
+    const int storagePorts[] = {BENCH_STORAGE_PORT, BENCH_STORAGE_PORT + 1};
+    const int metadataPort = BENCH_STORAGE_PORT + 2;
+    for (int port : storagePorts) startStorageNode(port, ServerMode::REACTOR);
+    std::thread([metadataPort]() {
+        dfs::metadata::MetadataNode node("", -1);
+        node.start(metadataPort, ServerMode::REACTOR);
+    }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    const int files = 2000;
+    const size_t fileSize = 4096;
+    std::cout << "\n[Small files] " << files << " x 4KB files, 2 replicas\n";
+    std::cout << std::setw(12) << "Chunks" << std::setw(14) << "Chunk ms" << std::setw(12) << "Total ms"
+              << std::setw(12) << "Files/s" << std::setw(12) << "Syscalls" << "\n";
+    std::mt19937 gen(7);
+    for (size_t batchChunkBytes : {size_t(0), dfs::client::UploadOptions().batchChunkBytes}) {
+        std::vector<std::string> names;
+        std::vector<uint8_t> data(fileSize);
+        for (int i = 0; i < files; ++i) {
+            names.push_back("bench_small_" + std::to_string(i) + ".bin");
+            for (auto& b : data) b = static_cast<uint8_t>(gen());
+            std::ofstream f(names.back(), std::ios::binary);
+            f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        }
+        dfs::client::Client client({"127.0.0.1:" + std::to_string(storagePorts[0]),
+                                    "127.0.0.1:" + std::to_string(storagePorts[1])},
+                                   {"127.0.0.1:" + std::to_string(metadataPort)});
+        dfs::client::UploadOptions options;
+        options.batchChunkBytes = batchChunkBytes;
+        client.setUploadOptions(options);
+
+        std::ostringstream discard;
+        std::streambuf* out = std::cout.rdbuf(discard.rdbuf());
+        uint64_t syscalls = dfs::common::syscallCount();
+        auto start = std::chrono::steady_clock::now();
+        bool ok = client.uploadFiles(names);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        syscalls = dfs::common::syscallCount() - syscalls;
+        std::cout.rdbuf(out);
+        std::cout << std::setw(12) << (batchChunkBytes ? "batched" : "single") << std::fixed << std::setprecision(1)
+                  << std::setw(14) << client.lastChunkUploadDuration << std::setw(12) << seconds * 1000
+                  << std::setw(12) << std::setprecision(0) << files / seconds << std::setw(12) << syscalls
+                  << (ok ? "" : "  (failed)") << "\n";
+        for (const auto& name : names) std::remove(name.c_str());
+    }
+    for (int port : storagePorts) killNode(port);
+    killNode(metadataPort);
+}
+
+// Random 4KB records out of a 64MB file: read() with GET_RANGE slices,
+// against fetching each record's whole chunk and the whole file.
+static void benchRangedRead() {
+    const int storagePorts[] = {BENCH_STORAGE_PORT, BENCH_STORAGE_PORT + 1};
+    const int metadataPort = BENCH_STORAGE_PORT + 2;
+    for (int port : storagePorts) startStorageNode(port, ServerMode::REACTOR);
+    std::thread([metadataPort]() {
+        dfs::metadata::MetadataNode node("", -1);
+        node.start(metadataPort, ServerMode::REACTOR);
+    }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    const std::string filename = "bench_ranged.bin";
+    const int64_t fileSize = 64 * 1024 * 1024;
+    {
+        std::vector<uint8_t> data = randomBytes(static_cast<size_t>(fileSize));
+        std::ofstream f(filename, std::ios::binary);
+        f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+    dfs::client::Client client({"127.0.0.1:" + std::to_string(storagePorts[0]),
+                                "127.0.0.1:" + std::to_string(storagePorts[1])},
+                               {"127.0.0.1:" + std::to_string(metadataPort)});
+    std::ostringstream discard;
+    std::streambuf* out = std::cout.rdbuf(discard.rdbuf());
+    client.uploadFile(filename);
+    std::cout.rdbuf(out);
+
+    const int reads = 1000;
+    const size_t record = 4096;
+    const int64_t chunk = dfs::common::CHUNK_SIZE;
+    std::cout << "\n[Ranged read] " << reads << " random 4KB records of a 64MB file\n";
+    std::cout << std::setw(14) << "Fetch" << std::setw(14) << "Mean us" << std::setw(14) << "MB received" << "\n";
+    for (bool wholeChunk : {false, true}) {
+        std::mt19937_64 gen(25);
+        std::uniform_int_distribution<int64_t> pick(0, fileSize / static_cast<int64_t>(record) - 1);
+        size_t received = 0;
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < reads; ++i) {
+            int64_t offset = pick(gen) * static_cast<int64_t>(record);
+            std::vector<uint8_t> data = wholeChunk ? client.read(filename, offset / chunk * chunk, chunk)
+                                                   : client.read(filename, offset, record);
+            ok = ok && data.size() == (wholeChunk ? static_cast<size_t>(chunk) : record);
+            received += data.size();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(14) << (wholeChunk ? "whole chunk" : "GET_RANGE") << std::fixed << std::setprecision(1)
+                  << std::setw(14) << seconds * 1e6 / reads << std::setw(14) << received / (1024.0 * 1024.0)
+                  << (ok ? "" : "  (failed)") << "\n";
+    }
+    out = std::cout.rdbuf(discard.rdbuf());
+    client.downloadFile(filename, "bench_ranged.out");
+    std::cout.rdbuf(out);
+    std::cout << std::setw(14) << "whole file" << std::setw(14) << client.lastTotalDownloadDuration * 1000.0
+              << std::setw(14) << fileSize / (1024.0 * 1024.0) << "\n";
+    std::remove("bench_ranged.out");
+    std::remove(filename.c_str());
+    for (int port : storagePorts) killNode(port);
+    killNode(metadataPort);
+}
+
+int main(int argc, char* argv[]) {
+    std::string name = argc > 1 ? argv[1] : "all";
+    bool known = false;
+    if (name == "all" || name == "get-contention") {
+        benchGetContention(ServerMode::THREADED);
+        benchGetContention(ServerMode::REACTOR);
+        known = true;
+    }
+    if (name == "all" || name == "memory-table") {
+        benchMemoryTable();
+        known = true;
+    }
+    if (name == "all" || name == "cache") {
+        benchCache();
+        known = true;
+    }
+    if (name == "all" || name == "store") {
+        benchStore();
+        known = true;
+    }
+    if (name == "all" || name == "io") {
+        benchIo();
+        known = true;
+    }
+    if (name == "all" || name == "dedup") {
+        benchDedup();
+        known = true;
+    }
+    if (name == "all" || name == "chunking") {
+        benchChunking();
+        known = true;
+    }
+    if (name == "all" || name == "sha256") {
+        benchSha256();
+        known = true;
+    }
+    if (name == "all" || name == "protocol") {
+        benchProtocol();
+        known = true;
+    }
+    if (name == "all" || name == "multiplex") {
+        benchMultiplex();
+        known = true;
+    }
+    if (name == "all" || name == "rtt") {
+        benchRtt();
+        known = true;
+    }
+    if (name == "all" || name == "buffers") {
+        benchBuffers();
+        known = true;
+    }
+    if (name == "all" || name == "small-files") {
+        benchSmallFiles();
+        known = true;
+    }
+    if (name == "all" || name == "ranged-read") {
+        benchRangedRead();
+        known = true;
+    }
+    if (!known) {
+        std::cerr << "Usage: " << argv[0] << " [all|get-contention|memory-table|cache|store|io|dedup|chunking|sha256|protocol|multiplex|rtt|buffers|small-files|ranged-read]" << std::endl;
+        return 1;
+    }
+    return 0;
+}
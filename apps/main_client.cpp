@@ -6,8 +6,10 @@
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cout << "Usage:\n  " << argv[0] << " upload <filepath>\n  "
-                  << argv[0] << " download <filename> <output_path>" << std::endl;
+        std::cout << "Usage:\n  " << argv[0] << " upload <filepath> [--cdc] [--text]\n  "
+                  << argv[0] << " download <filename> <output_path> [--text]\n  "
+                  << argv[0] << " read <filename> <offset> <length> [--text]\n"
+                  << "  --text speaks the text protocol, for nodes without binary support" << std::endl;
         return 1;
     }
 
@@ -17,11 +19,22 @@ int main(int argc, char* argv[]) {
     dfs::client::Client client(storageNodes, metadataNodes);
     std::string command = argv[1];
     std::string arg1 = argv[2];
+    bool cdc = false;
+    for (int i = 3; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--text") client.setWireFormat(dfs::network::WireFormat::TEXT);
+        if (flag == "--cdc") cdc = true;
+    }
 
     if (command == "upload") {
+        if (cdc) {
+            dfs::client::UploadOptions options;
+            options.chunking = dfs::common::Chunking::CONTENT_DEFINED;
+            client.setUploadOptions(options);
+        }
         client.uploadFile(arg1);
     } else if (command == "download") {
-        if (argc < 4) {
+        if (argc < 4 || std::string(argv[3]) == "--text") {
             std::cout << "Usage: download <filename> <output_path>" << std::endl;
             return 1;
         }
@@ -30,6 +43,19 @@ int main(int argc, char* argv[]) {
         std::cout << "Verifying integrity..." << std::endl;
         std::string computedCID = dfs::client::computeCID(outputPath);
         std::cout << "Integrity CID: " << computedCID << std::endl;
+    } else if (command == "read") {
+        // The bytes go to stdout as they are, for piping.
+        if (argc < 5) {
+            std::cout << "Usage: read <filename> <offset> <length>" << std::endl;
+            return 1;
+        }
+        std::vector<uint8_t> data = client.read(arg1, std::stoll(argv[3]), std::stoull(argv[4]));
+        if (data.empty()) {
+            std::cerr << "Nothing read." << std::endl;
+            return 1;
+        }
+        std::cout.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        std::cout.flush();
     } else {
         std::cout << "Unknown command: " << command << std::endl;
         return 1;
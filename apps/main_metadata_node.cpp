@@ -5,12 +5,14 @@
 #include <cstdlib>
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cout << "Usage: " << argv[0] << " <config_file> <node_id>" << std::endl;
+    if (argc != 3 && argc != 4) {
+        std::cout << "Usage: " << argv[0] << " <config_file> <node_id> [reactor|threaded]" << std::endl;
         return 1;
     }
     std::string configFile = argv[1];
     int nodeId = std::stoi(argv[2]);
+    dfs::network::ServerMode mode = dfs::network::ServerMode::REACTOR;
+    if (argc == 4 && std::string(argv[3]) == "threaded") mode = dfs::network::ServerMode::THREADED;
     dfs::common::NodeConfig config(configFile, nodeId);
     dfs::common::NodeInfo myNode = config.getMyNode();
     if (myNode.port == 0 && myNode.host.empty()) {
@@ -39,6 +41,6 @@ int main(int argc, char* argv[]) {
     }
 
     dfs::metadata::MetadataNode node(nextIp, nextPort);
-    node.start(myNode.port);
+    node.start(myNode.port, mode);
     return 0;
 }
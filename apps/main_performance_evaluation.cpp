@@ -1,6 +1,9 @@
 #include "client/client.hpp"
+#include "common/file_utils.hpp"
+#include "common/latency_tracker.hpp"
 #include "metadata/metadata_node.hpp"
 #include "storage/storage_node.hpp"
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iomanip>
@@ -74,12 +77,47 @@ static void runTest(std::ofstream& writer, dfs::client::Client& client,
     double downloadThroughput = sizeBytes / 1024.0 / 1024.0 / (downloadLatency / 1000.0);
 
     writer << "Total Download Latency: " << downloadLatency << " ms\n";
-    writer << "Download Throughput: " << std::fixed << std::setprecision(2) << downloadThroughput << " MB/s\n\n";
+    writer << "Download Throughput: " << std::fixed << std::setprecision(2) << downloadThroughput << " MB/s\n";
+    writer << "Chunk GET Latency p50/p99/p999: " << dfs::common::percentile(client.lastChunkLatencies, 50) << " / "
+           << dfs::common::percentile(client.lastChunkLatencies, 99) << " / "
+           << dfs::common::percentile(client.lastChunkLatencies, 99.9) << " ms\n\n";
     writer.flush();
 
     remove(downloadPath.c_str());
 }
 
+// Chunk upload throughput of one large file as the in-flight window grows.
+static void runWindowSweep(std::ofstream& writer, dfs::client::Client& client, int sizeBytes) {
+    std::cout << "\nRunning Upload Window Sweep (" << sizeBytes << " bytes)\n";
+    std::string filepath = std::string(TEST_DIR) + "/window_sweep.dat";
+    createDummyFile(filepath, sizeBytes);
+
+    writer << "Upload Window Sweep\n-------------------------------\nFile Size: " << sizeBytes << " bytes\n";
+    for (size_t window : {1, 2, 4, 8, 16, 32}) {
+        dfs::client::UploadOptions options;
+        options.windowChunks = window;
+        options.windowBytes = window * dfs::common::CHUNK_SIZE;
+        // Every window re-uploads the same file; skipping what the replicas
+        // already hold would time the HAS_MULTI probe instead.
+        options.skipExisting = false;
+        client.setUploadOptions(options);
+        client.uploadFile(filepath);
+        double seconds = std::max(client.lastChunkUploadDuration, 1L) / 1000.0;
+        double throughput = sizeBytes / 1024.0 / 1024.0 / seconds;
+        writer << "Window " << std::setw(2) << window << ": " << std::fixed << std::setprecision(2)
+               << throughput << " MB/s (" << client.lastChunkUploadDuration << " ms, "
+               << client.lastUploadBytesSent / 1024.0 / 1024.0 << " MB sent)\n";
+        if (client.lastUploadBytesSent < sizeBytes) {
+            std::cerr << "Window " << window << " sent " << client.lastUploadBytesSent << " of " << sizeBytes
+                      << " bytes; its throughput does not measure the window" << std::endl;
+        }
+    }
+    writer << "\n";
+    writer.flush();
+    client.setUploadOptions(dfs::client::UploadOptions());
+    remove(filepath.c_str());
+}
+
 int main(int argc, char* argv[]) {
     mkdir(TEST_DIR, 0755);
     std::ofstream writer(OUTPUT_FILE);
@@ -99,6 +137,7 @@ int main(int argc, char* argv[]) {
     runTest(writer, client, "small_file.dat", 100 * 1024);
     runTest(writer, client, "medium_file.dat", 5 * 1024 * 1024);
     runTest(writer, client, "large_file.dat", 20 * 1024 * 1024);
+    runWindowSweep(writer, client, 64 * 1024 * 1024);
 
     std::cout << "Performance evaluation complete. Results saved to " << OUTPUT_FILE << "\n";
     return 0;
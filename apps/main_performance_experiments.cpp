@@ -1,4 +1,5 @@
 #include "client/client.hpp"
+#include "common/latency_tracker.hpp"
 #include "metadata/metadata_node.hpp"
 #include "network/tcp_client.hpp"
 #include "storage/storage_node.hpp"
@@ -11,9 +12,12 @@
 
 static const char* RESULTS_FILE = "results.csv";
 
-static void startStorageNode(int port) {
-    std::thread([port]() {
+static void startStorageNode(int port, std::chrono::milliseconds delay = std::chrono::milliseconds(0),
+                             double delayProbability = 0.0) {
+    std::thread([port, delay, delayProbability]() {
         dfs::storage::StorageNode node;
+        node.setVerbose(false);
+        node.setArtificialDelay(delay, delayProbability);
         node.start(port);
     }).detach();
 }
@@ -33,9 +37,15 @@ static void killNode(int port) {
     }
 }
 
-static void startCluster(int storageCount) {
+// With slowNode set, 5% of the GETs served by the first storage node stall
+// for 200ms, like a replica with a noisy neighbour.
+static void startCluster(int storageCount, bool slowNode = false) {
     for (int i = 1; i <= storageCount; ++i) {
-        startStorageNode(8000 + i);
+        if (slowNode && i == 1) {
+            startStorageNode(8000 + i, std::chrono::milliseconds(200), 0.05);
+        } else {
+            startStorageNode(8000 + i);
+        }
     }
     startMetadataNode(9003, "", -1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
@@ -55,14 +65,19 @@ static void stopCluster(int storageCount) {
 
 struct ExperimentResult {
     double avgUpload = 0, avgDownload = 0, successRate = 0;
+    double p50Chunk = 0, p99Chunk = 0, p999Chunk = 0;
 };
 
-static ExperimentResult runWorkload(int clientCount, int fileSize) {
+static ExperimentResult runWorkload(int clientCount, int fileSize,
+                                    const dfs::client::DownloadOptions& downloadOptions = {}) {
     std::vector<std::string> storageNodes = {"127.0.0.1:8001", "127.0.0.1:8002"};
     std::vector<std::string> metadataNodes = {"127.0.0.1:9001", "127.0.0.1:9002", "127.0.0.1:9003"};
 
+    // All simulated clients share one set of keep-alive connections.
+    auto pool = std::make_shared<dfs::client::ConnectionPool>();
     std::vector<long> uploadLatencies;
     std::vector<long> downloadLatencies;
+    std::vector<double> chunkLatencies;
     std::vector<bool> successes;
     std::mutex mtx;
 
@@ -81,7 +96,8 @@ static ExperimentResult runWorkload(int clientCount, int fileSize) {
                     std::ofstream f(fname, std::ios::binary);
                     f.write(reinterpret_cast<const char*>(data.data()), data.size());
                 }
-                dfs::client::Client c(storageNodes, metadataNodes);
+                dfs::client::Client c(storageNodes, metadataNodes, pool);
+                c.setDownloadOptions(downloadOptions);
                 c.uploadFile(fname);
                 long up = c.lastTotalUploadDuration;
                 std::string outName = "perf_out_" + std::to_string(i) + ".bin";
@@ -92,6 +108,7 @@ static ExperimentResult runWorkload(int clientCount, int fileSize) {
                 std::lock_guard<std::mutex> lock(mtx);
                 uploadLatencies.push_back(up);
                 downloadLatencies.push_back(down);
+                chunkLatencies.insert(chunkLatencies.end(), c.lastChunkLatencies.begin(), c.lastChunkLatencies.end());
                 successes.push_back(true);
             } catch (...) {
                 std::lock_guard<std::mutex> lock(mtx);
@@ -111,12 +128,22 @@ static ExperimentResult runWorkload(int clientCount, int fileSize) {
         r.avgUpload = sumUp / uploadLatencies.size();
         r.avgDownload = sumDown / downloadLatencies.size();
     }
+    r.p50Chunk = dfs::common::percentile(chunkLatencies, 50);
+    r.p99Chunk = dfs::common::percentile(chunkLatencies, 99);
+    r.p999Chunk = dfs::common::percentile(chunkLatencies, 99.9);
     int ok = 0;
     for (bool b : successes) if (b) ++ok;
     r.successRate = clientCount > 0 ? (100.0 * ok / clientCount) : 0;
     return r;
 }
 
+static void printResult(const ExperimentResult& result) {
+    std::cout << "    -> Avg Upload: " << result.avgUpload << " ms, Avg Download: " << result.avgDownload
+              << " ms, Success: " << result.successRate << "%\n";
+    std::cout << "       Chunk GET p50/p99/p999: " << result.p50Chunk << " / " << result.p99Chunk << " / "
+              << result.p999Chunk << " ms\n";
+}
+
 int main(int argc, char* argv[]) {
     std::cout << "=== STARTING PERFORMANCE EXPERIMENTS ===\n";
     std::ofstream writer(RESULTS_FILE);
@@ -124,7 +151,8 @@ int main(int argc, char* argv[]) {
         std::cerr << "Cannot open " << RESULTS_FILE << std::endl;
         return 1;
     }
-    writer << "Experiment,Variable,Value,AvgUploadLatency,AvgDownloadLatency,SuccessRate\n";
+    writer << "Experiment,Variable,Value,AvgUploadLatency,AvgDownloadLatency,SuccessRate,"
+              "P50ChunkLatency,P99ChunkLatency,P999ChunkLatency\n";
 
     // Scalability
     std::cout << "\n[Experiment A] Scalability (Varying Clients)\n";
@@ -136,10 +164,10 @@ int main(int argc, char* argv[]) {
         std::this_thread::sleep_for(std::chrono::seconds(2));
         ExperimentResult result = runWorkload(clients, fileSize);
         writer << "Scalability,Clients," << clients << ","
-               << result.avgUpload << "," << result.avgDownload << "," << result.successRate << "\n";
+               << result.avgUpload << "," << result.avgDownload << "," << result.successRate << ","
+               << result.p50Chunk << "," << result.p99Chunk << "," << result.p999Chunk << "\n";
         writer.flush();
-        std::cout << "    -> Avg Upload: " << result.avgUpload << " ms, Avg Download: " << result.avgDownload
-                  << " ms, Success: " << result.successRate << "%\n";
+        printResult(result);
         stopCluster(2);
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }
@@ -153,10 +181,28 @@ int main(int argc, char* argv[]) {
         std::this_thread::sleep_for(std::chrono::seconds(2));
         ExperimentResult result = runWorkload(1, size);
         writer << "Throughput,FileSize," << size << ","
-               << result.avgUpload << "," << result.avgDownload << "," << result.successRate << "\n";
+               << result.avgUpload << "," << result.avgDownload << "," << result.successRate << ","
+               << result.p50Chunk << "," << result.p99Chunk << "," << result.p999Chunk << "\n";
+        writer.flush();
+        printResult(result);
+        stopCluster(2);
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    }
+
+    // Tail latency
+    std::cout << "\n[Experiment C] Tail Latency (One Slow Storage Node)\n";
+    for (bool hedged : {false, true}) {
+        std::cout << "  Running with hedged reads " << (hedged ? "on" : "off") << "...\n";
+        startCluster(2, true);
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+        dfs::client::DownloadOptions options;
+        options.hedgedReads = hedged;
+        ExperimentResult result = runWorkload(20, 10 * 1024 * 1024, options);
+        writer << "TailLatency,Hedged," << (hedged ? 1 : 0) << ","
+               << result.avgUpload << "," << result.avgDownload << "," << result.successRate << ","
+               << result.p50Chunk << "," << result.p99Chunk << "," << result.p999Chunk << "\n";
         writer.flush();
-        std::cout << "    -> Avg Upload: " << result.avgUpload << " ms, Avg Download: " << result.avgDownload
-                  << " ms, Success: " << result.successRate << "%\n";
+        printResult(result);
         stopCluster(2);
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }
@@ -1,22 +1,94 @@
 #include "common/node_config.hpp"
+#include "storage/file_chunk_store.hpp"
+#include "storage/log_chunk_store.hpp"
 #include "storage/storage_node.hpp"
 #include <iostream>
 #include <cstdlib>
+#include <memory>
+
+static int usage(const char* program) {
+    std::cout << "Usage: " << program << " <config_file> <node_id> [reactor|threaded|uring]"
+              << " [--engine memory|log|files] [--data-dir DIR] [--fsync always|interval|never]"
+              << " [--cache-mb N] [--no-zero-copy] [--sqpoll]" << std::endl;
+    return 1;
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cout << "Usage: " << argv[0] << " <config_file> <node_id>" << std::endl;
-        return 1;
-    }
+    if (argc < 3) return usage(argv[0]);
     std::string configFile = argv[1];
     int nodeId = std::stoi(argv[2]);
+    dfs::network::ServerMode mode = dfs::network::ServerMode::REACTOR;
+    dfs::storage::StoreEngine engine = dfs::storage::StoreEngine::MEMORY;
+    std::string dataDir = "data/storage-" + std::to_string(nodeId);
+    dfs::storage::LogStoreOptions logOptions;
+    bool zeroCopy = true;
+    bool sqpoll = false;
+    long cacheMb = -1;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "threaded") {
+            mode = dfs::network::ServerMode::THREADED;
+        } else if (arg == "reactor") {
+            mode = dfs::network::ServerMode::REACTOR;
+        } else if (arg == "uring") {
+            mode = dfs::network::ServerMode::URING;
+        } else if (arg == "--engine" && (value == "memory" || value == "log" || value == "files")) {
+            engine = value == "log"     ? dfs::storage::StoreEngine::LOG
+                     : value == "files" ? dfs::storage::StoreEngine::FILES
+                                        : dfs::storage::StoreEngine::MEMORY;
+            ++i;
+        } else if (arg == "--data-dir" && !value.empty()) {
+            dataDir = value;
+            ++i;
+        } else if (arg == "--fsync" && (value == "always" || value == "interval" || value == "never")) {
+            logOptions.fsync = value == "always"     ? dfs::storage::FsyncPolicy::ALWAYS
+                               : value == "interval" ? dfs::storage::FsyncPolicy::INTERVAL
+                                                     : dfs::storage::FsyncPolicy::NEVER;
+            ++i;
+        } else if (arg == "--cache-mb" && !value.empty() && value.find_first_not_of("0123456789") == std::string::npos) {
+            cacheMb = std::stol(value);
+            ++i;
+        } else if (arg == "--no-zero-copy") {
+            zeroCopy = false;
+        } else if (arg == "--sqpoll") {
+            sqpoll = true;
+        } else {
+            return usage(argv[0]);
+        }
+    }
     dfs::common::NodeConfig config(configFile, nodeId);
     dfs::common::NodeInfo myNode = config.getMyNode();
     if (myNode.port == 0 && myNode.host.empty()) {
         std::cerr << "Error: Node ID " << nodeId << " not found in config file." << std::endl;
         return 1;
     }
-    dfs::storage::StorageNode node;
-    node.start(myNode.port);
+
+    std::unique_ptr<dfs::storage::ChunkStore> store;
+    if (engine == dfs::storage::StoreEngine::LOG) {
+        std::unique_ptr<dfs::storage::LogChunkStore> log(new dfs::storage::LogChunkStore(dataDir, logOptions));
+        if (!log->isOpen()) return 1;
+        std::cout << "Recovered " << log->chunkCount() << " chunks from " << dataDir << std::endl;
+        store = std::move(log);
+    } else if (engine == dfs::storage::StoreEngine::FILES) {
+        // The files engine has no interval sync; only "always" makes puts durable.
+        bool syncWrites = logOptions.fsync == dfs::storage::FsyncPolicy::ALWAYS;
+        // In uring mode the chunk files go through io_uring as well.
+        dfs::common::IoBackend backend = mode == dfs::network::ServerMode::URING ? dfs::common::IoBackend::URING
+                                                                                  : dfs::common::IoBackend::POSIX;
+        std::unique_ptr<dfs::storage::FileChunkStore> files(
+            new dfs::storage::FileChunkStore(dataDir, syncWrites, backend));
+        if (!files->isOpen()) return 1;
+        std::cout << "Found " << files->chunkCount() << " chunks in " << dataDir << std::endl;
+        store = std::move(files);
+    }
+    // The disk engines get a 256MB hot-chunk cache unless told otherwise;
+    // the memory engine already holds everything in RAM.
+    if (cacheMb < 0) cacheMb = store ? 256 : 0;
+    dfs::storage::StorageNode node(std::move(store));
+    node.setCacheBudget(static_cast<size_t>(cacheMb) * 1024 * 1024);
+    node.setZeroCopy(zeroCopy);
+    node.setSqPoll(sqpoll);
+    node.start(myNode.port, mode);
     return 0;
 }
@@ -1,24 +1,36 @@
 #include "client/verify_files.hpp"
 #include <iostream>
 #include <cstdlib>
+#include <string>
+#include <vector>
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <original_file> <reconstructed_file>" << std::endl;
+    std::vector<std::string> paths;
+    size_t threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " [--threads N] <original_file> <reconstructed_file>" << std::endl;
         return 1;
     }
-    std::string originalPath = argv[1];
-    std::string reconstructedPath = argv[2];
+    std::string originalPath = paths[0];
+    std::string reconstructedPath = paths[1];
 
     std::cout << "Computing CID for original file..." << std::endl;
-    std::string originalCID = dfs::client::computeCID(originalPath);
+    std::string originalCID = dfs::client::computeCID(originalPath, threads);
     if (originalCID.empty()) {
         std::cerr << "Error: Could not process original file" << std::endl;
         return 1;
     }
 
     std::cout << "Computing CID for reconstructed file..." << std::endl;
-    std::string reconstructedCID = dfs::client::computeCID(reconstructedPath);
+    std::string reconstructedCID = dfs::client::computeCID(reconstructedPath, threads);
     if (reconstructedCID.empty()) {
         std::cerr << "Error: Could not process reconstructed file" << std::endl;
         return 1;
@@ -1,24 +1,74 @@
 #include "client/client.hpp"
+#include "client/transfer_window.hpp"
+#include "common/buffer_pool.hpp"
 #include "common/file_utils.hpp"
 #include "common/hash_utils.hpp"
+#include "common/sha256.hpp"
+#include "common/thread_pool.hpp"
+#include "network/protocol.hpp"
 #include "network/tcp_client.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
-#include <sys/stat.h>
+#include <map>
+#include <mutex>
+#include <thread>
 
 namespace dfs {
 namespace client {
 
-static int64_t getFileSize(const std::string& path) {
-    struct stat st;
-    if (stat(path.c_str(), &st) != 0) return 0;
-    return static_cast<int64_t>(st.st_size);
+static double mbPerSecond(int64_t bytes, double seconds) {
+    if (seconds <= 0) return 0.0;
+    return std::round(bytes / seconds / (1024.0 * 1024.0) * 10.0) / 10.0;
+}
+
+// Where each chunk of `meta` starts in the file and how long it is, for
+// fixed-size and content-defined chunks alike. False if the chunk lengths
+// do not add up to the file.
+static bool chunkExtents(const common::FileMetadata& meta, std::vector<int64_t>& offsets,
+                         std::vector<size_t>& lengths) {
+    offsets.clear();
+    lengths.clear();
+    if (!meta.chunkSizes.empty()) {
+        if (meta.chunkSizes.size() != meta.chunkHashes.size()) return false;
+        int64_t offset = 0;
+        for (uint32_t size : meta.chunkSizes) {
+            offsets.push_back(offset);
+            lengths.push_back(size);
+            offset += size;
+        }
+        return offset == meta.fileSize;
+    }
+    const int chunkSize = meta.chunkSize > 0 ? meta.chunkSize : common::CHUNK_SIZE;
+    for (size_t i = 0; i < meta.chunkHashes.size(); ++i) {
+        int64_t offset = static_cast<int64_t>(i) * chunkSize;
+        offsets.push_back(offset);
+        int64_t length = std::min<int64_t>(chunkSize, meta.fileSize - offset);
+        lengths.push_back(static_cast<size_t>(std::max<int64_t>(0, length)));
+    }
+    return true;
+}
+
+// Sends one binary request and reads its response. False on transport
+// failure or a response that does not answer this request, which leaves the
+// connection out of step.
+static bool binaryExchange(network::TCPClient& conn, network::MessageWriter& request, network::Opcode op,
+                           uint64_t requestId, std::vector<uint8_t>& response, network::Status& status,
+                           network::MessageReader& payload) {
+    if (!conn.sendData(request.finish())) return false;
+    response = conn.recvData();
+    return network::parseResponse(response, op, requestId, status, payload);
 }
 
 Client::Client(const std::vector<std::string>& storageNodes,
-               const std::vector<std::string>& metadataNodes)
-    : metadataNodes_(metadataNodes) {
+               const std::vector<std::string>& metadataNodes,
+               std::shared_ptr<ConnectionPool> pool)
+    : metadataNodes_(metadataNodes), pool_(pool ? std::move(pool) : std::make_shared<ConnectionPool>()) {
     for (const auto& node : storageNodes) {
         dht_.addNode(node);
     }
@@ -28,96 +78,308 @@ void Client::uploadFile(const std::string& filepath) {
     auto startTime = std::chrono::steady_clock::now();
     std::cout << "Uploading " << filepath << std::endl;
 
-    auto chunks = common::splitFileIntoChunks(filepath);
-    if (chunks.empty()) {
-        std::cerr << "File is empty or not found" << std::endl;
-        return;
-    }
-    common::hashAllChunks(chunks);
+    std::vector<FileUpload> files(1);
+    files[0].path = filepath;
+    auto startChunkUpload = std::chrono::steady_clock::now();
+    bool chunksStored = uploadChunks(files);
+    lastChunkUploadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startChunkUpload).count();
+    if (!chunksStored) return;
 
-    std::vector<std::string> hashes;
-    for (const auto& c : chunks) hashes.push_back(c.hash);
-    std::string rootHash = common::computeRootHash(hashes);
-    std::cout << "Root Hash (CID): " << rootHash << std::endl;
+    auto startMetadataUpload = std::chrono::steady_clock::now();
+    bool metadataSuccess = putMetadata(files[0]);
+    lastMetadataUploadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startMetadataUpload).count();
+
+    if (metadataSuccess) std::cout << "Upload complete." << std::endl;
+    lastTotalUploadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
 
-    const int replicationFactor = 2;
+bool Client::uploadFiles(const std::vector<std::string>& filepaths) {
+    auto startTime = std::chrono::steady_clock::now();
+    std::cout << "Uploading " << filepaths.size() << " files" << std::endl;
+
+    std::vector<FileUpload> files(filepaths.size());
+    for (size_t i = 0; i < filepaths.size(); ++i) files[i].path = filepaths[i];
     auto startChunkUpload = std::chrono::steady_clock::now();
-    for (const auto& chunk : chunks) {
-        auto nodes = dht_.getNodesForKey(chunk.hash, replicationFactor);
-        std::cout << "Chunk " << chunk.index << " -> ";
-        for (const auto& n : nodes) std::cout << n << " ";
-        std::cout << std::endl;
-
-        int successCount = 0;
-        for (const auto& nodeAddr : nodes) {
-            if (uploadChunkToNode(chunk, nodeAddr)) {
-                successCount++;
-            } else {
-                std::cerr << "  Failed to upload to " << nodeAddr << std::endl;
-            }
-        }
-        if (successCount == 0) {
-            std::cerr << "Failed to upload chunk " << chunk.index << " to any node!" << std::endl;
-            return;
-        }
-    }
+    bool chunksStored = uploadChunks(files);
     lastChunkUploadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now() - startChunkUpload).count();
+    if (!chunksStored) return false;
 
+    // One PUT per file, as many in flight as the window has chunks.
     auto startMetadataUpload = std::chrono::steady_clock::now();
-    bool metadataSuccess = false;
-    for (const auto& nodeAddr : metadataNodes_) {
-        std::cout << "Trying to put metadata to " << nodeAddr << std::endl;
-        if (putMetadataToNode(nodeAddr, filepath, chunks, rootHash)) {
-            std::cout << "Metadata uploaded successfully to " << nodeAddr << std::endl;
-            metadataSuccess = true;
-            break;
+    std::atomic<size_t> missing{0};
+    {
+        common::ThreadPool workers(std::max<size_t>(1, uploadOptions_.windowChunks));
+        for (const FileUpload& file : files) {
+            workers.submit([this, &file, &missing]() {
+                if (!putMetadata(file)) missing++;
+            });
         }
-        std::cerr << "Failed to connect/write to " << nodeAddr << ". Trying next..." << std::endl;
+        workers.shutdown();
     }
     lastMetadataUploadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now() - startMetadataUpload).count();
-
-    if (!metadataSuccess) {
-        std::cerr << "Failed to upload metadata to any node!" << std::endl;
-    } else {
-        std::cout << "Upload complete." << std::endl;
-    }
     lastTotalUploadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now() - startTime).count();
+
+    if (missing > 0) {
+        std::cerr << missing << " of " << files.size() << " files have no metadata" << std::endl;
+        return false;
+    }
+    std::cout << "Upload complete." << std::endl;
+    return true;
 }
 
-bool Client::putMetadataToNode(const std::string& nodeAddr, const std::string& filepath,
-                               const std::vector<common::Chunk>& chunks, const std::string& rootHash) {
-    size_t colon = nodeAddr.find(':');
-    if (colon == std::string::npos) return false;
-    std::string ip = nodeAddr.substr(0, colon);
-    int port = std::stoi(nodeAddr.substr(colon + 1));
+bool Client::putMetadata(const FileUpload& file) {
+    common::Digest rootHash = common::computeRootHash(file.hashes);
+    std::cout << "Root Hash (CID): " << rootHash << std::endl;
+    for (const auto& nodeAddr : metadataNodes_) {
+        std::cout << "Trying to put metadata to " << nodeAddr << std::endl;
+        if (putMetadataToNode(nodeAddr, file.path, file.size, file.hashes, file.sizes, rootHash)) {
+            std::cout << "Metadata uploaded successfully to " << nodeAddr << std::endl;
+            return true;
+        }
+        std::cerr << "Failed to connect/write to " << nodeAddr << ". Trying next..." << std::endl;
+    }
+    std::cerr << "Failed to upload metadata to any node!" << std::endl;
+    return false;
+}
+
+bool Client::uploadChunks(std::vector<FileUpload>& files) {
+    // Each reader hashes its chunks as they come off disk. Chunks are handed
+    // to the workers in batches: each replica node is asked once per batch
+    // which of its chunks it already has, and only the rest are sent. A batch
+    // goes out when it fills the window or the window has no room for the
+    // next chunk, so chunk i is read while earlier chunks are on the wire.
+    // The reader's buffer goes back to it once every replica finished. Files
+    // are read one after another and their chunks share batches, so the
+    // small chunks of many small files go out together.
+    struct ChunkProgress {
+        common::Chunk chunk;
+        // Owns the chunk's buffer; let go once every replica is done, so a
+        // finished file's reader goes away with its last chunk.
+        std::shared_ptr<common::ChunkReader> reader;
+        size_t file{0};
+        bool small{false};  // sent in STORE_MULTI batches
+        int required{0};
+        std::atomic<int> pending{0};
+        std::atomic<int> stored{0};
+    };
+    using Batch = std::vector<std::shared_ptr<ChunkProgress>>;
+    const UploadOptions options = uploadOptions_;
+    const bool batching = options.batchChunkBytes > 0 && wireFormat_ == network::WireFormat::BINARY;
+    TransferWindow window(options.windowChunks, options.windowBytes);
+    std::atomic<bool> failed{false};
+    std::atomic<int64_t> bytesSent{0};
+    std::atomic<int64_t> bytesSkipped{0};
+    std::vector<std::shared_ptr<ChunkProgress>> progress;
+
+    // Declared before the workers so they outlive their last task.
+    auto retire = [&window](const std::shared_ptr<ChunkProgress>& state) {
+        size_t bytes = state->chunk.data.size();
+        state->reader->recycle(state->chunk);
+        state->reader.reset();
+        window.release(bytes, state->small ? 0 : 1);
+    };
+    auto finishReplica = [&retire, &failed](const std::shared_ptr<ChunkProgress>& state) {
+        if (--state->pending > 0) return;
+        if (state->stored < state->required && !failed.exchange(true)) {
+            std::cerr << "Failed to upload chunk " << state->chunk.index << " to " << state->required
+                      << " node(s)!" << std::endl;
+        }
+        retire(state);
+    };
+    common::ThreadPool workers(std::max<size_t>(1, options.windowChunks) *
+                               static_cast<size_t>(std::max(1, options.replicationFactor)));
+
+    auto uploadOne = [&](const std::shared_ptr<ChunkProgress>& state, const std::string& nodeAddr) {
+        const common::Chunk& chunk = state->chunk;
+        if (!failed && uploadChunkToNode(chunk, nodeAddr)) {
+            bytesSent += static_cast<int64_t>(chunk.data.size());
+            state->stored++;
+        } else if (!failed) {
+            std::cerr << "  Failed to upload chunk " << chunk.index << " to " << nodeAddr << std::endl;
+        }
+        finishReplica(state);
+    };
+    // A node that could not take the batch, such as one that predates
+    // STORE_MULTI, gets its chunks one by one.
+    auto uploadGroup = [&](const Batch& group, const std::string& nodeAddr) {
+        std::vector<const common::Chunk*> chunks;
+        for (const auto& state : group) chunks.push_back(&state->chunk);
+        std::vector<bool> stored = failed ? std::vector<bool>() : uploadChunksToNode(chunks, nodeAddr);
+        for (size_t i = 0; i < group.size(); ++i) {
+            if (stored.empty()) {
+                uploadOne(group[i], nodeAddr);
+                continue;
+            }
+            if (stored[i]) {
+                bytesSent += static_cast<int64_t>(group[i]->chunk.data.size());
+                group[i]->stored++;
+            } else if (!failed) {
+                std::cerr << "  Failed to upload chunk " << group[i]->chunk.index << " to " << nodeAddr << std::endl;
+            }
+            finishReplica(group[i]);
+        }
+    };
+
+    auto uploadBatch = [&](const Batch& batch) {
+        std::map<std::string, Batch> byNode;
+        for (const auto& state : batch) {
+            common::Chunk& chunk = state->chunk;
+            auto nodes = dht_.getNodesForKey(chunk.hash, options.replicationFactor);
+            std::cout << "Chunk " << chunk.index << " -> ";
+            for (const auto& n : nodes) std::cout << n << " ";
+            std::cout << std::endl;
+            if (nodes.empty()) {
+                if (!failed.exchange(true)) {
+                    std::cerr << "No storage nodes available for chunk " << chunk.index << std::endl;
+                }
+                retire(state);
+                continue;
+            }
+            state->required = std::min(std::max(1, options.minReplicas), static_cast<int>(nodes.size()));
+            state->pending = static_cast<int>(nodes.size());
+            for (const auto& nodeAddr : nodes) byNode[nodeAddr].push_back(state);
+        }
 
-    network::TCPClient client;
-    if (!client.connect(ip, port)) return false;
+        for (auto& entry : byNode) {
+            workers.submit([&, nodeAddr = entry.first, chunks = std::move(entry.second)]() {
+                std::vector<bool> present;
+                if (options.skipExisting && !failed) {
+                    std::vector<common::Digest> digests;
+                    for (const auto& state : chunks) digests.push_back(state->chunk.hash);
+                    present = probeChunks(nodeAddr, digests);
+                }
+                Batch group;
+                size_t groupBytes = 0;
+                auto sendGroup = [&]() {
+                    if (group.empty()) return;
+                    workers.submit([&, nodeAddr, group]() { uploadGroup(group, nodeAddr); });
+                    group.clear();
+                    groupBytes = 0;
+                };
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    const std::shared_ptr<ChunkProgress>& state = chunks[i];
+                    size_t bytes = state->chunk.data.size();
+                    if (i < present.size() && present[i]) {
+                        bytesSkipped += static_cast<int64_t>(bytes);
+                        state->stored++;
+                        finishReplica(state);
+                    } else if (state->small) {
+                        if (groupBytes + bytes > options.batchBytes) sendGroup();
+                        group.push_back(state);
+                        groupBytes += bytes;
+                    } else {
+                        workers.submit([&, state, nodeAddr]() { uploadOne(state, nodeAddr); });
+                    }
+                }
+                sendGroup();
+            });
+        }
+    };
+
+    Batch batch;
+    size_t batchChunks = 0;      // chunks sent on their own
+    size_t batchSmallBytes = 0;  // bytes of chunks sent in STORE_MULTI
+    auto dispatch = [&]() {
+        if (batch.empty()) return;
+        workers.submit([&uploadBatch, batch]() { uploadBatch(batch); });
+        batch.clear();
+        batchChunks = 0;
+        batchSmallBytes = 0;
+    };
+    for (size_t f = 0; f < files.size() && !failed; ++f) {
+        auto reader = std::make_shared<common::ChunkReader>(files[f].path, options.windowChunks + 1, true,
+                                                            options.chunking);
+        if (!reader->isOpen() || reader->fileSize() == 0) {
+            std::cerr << "File is empty or not found: " << files[f].path << std::endl;
+            failed = true;
+            break;
+        }
+        files[f].size = reader->fileSize();
+        auto state = std::make_shared<ChunkProgress>();
+        while (!failed && reader->next(state->chunk)) {
+            size_t bytes = state->chunk.data.size();
+            state->reader = reader;
+            state->file = f;
+            state->small = batching && bytes <= options.batchChunkBytes;
+            size_t weight = state->small ? 0 : 1;
+            if (!window.tryAcquire(bytes, weight)) {
+                // The batch holds window space; send it before waiting for more.
+                dispatch();
+                window.acquire(bytes, weight);
+            }
+            progress.push_back(state);
+            batch.push_back(state);
+            if (state->small) {
+                batchSmallBytes += bytes;
+            } else {
+                batchChunks++;
+            }
+            if (batchChunks >= std::max<size_t>(1, options.windowChunks) || batchSmallBytes >= options.batchBytes) {
+                dispatch();
+            }
+            state = std::make_shared<ChunkProgress>();
+        }
+    }
+    dispatch();
+    window.waitIdle();
+    // Tasks may still be returning after their last release; the lambdas
+    // they reference must outlive them.
+    workers.shutdown();
+    lastUploadBytesSent = bytesSent;
+    lastUploadBytesSkipped = bytesSkipped;
+    if (bytesSkipped > 0) {
+        std::cout << "Skipped " << bytesSkipped << " chunk bytes the replicas already stored ("
+                  << bytesSent << " bytes sent)" << std::endl;
+    }
+    for (const auto& p : progress) {
+        FileUpload& file = files[p->file];
+        file.hashes.push_back(p->chunk.hash);
+        if (options.chunking != common::Chunking::FIXED) file.sizes.push_back(static_cast<uint32_t>(p->chunk.size));
+    }
+    return !failed && !progress.empty();
+}
 
-    int64_t size = getFileSize(filepath);
+bool Client::putMetadataToNode(const std::string& nodeAddr, const std::string& filepath, int64_t size,
+                               const std::vector<common::Digest>& hashes, const std::vector<uint32_t>& sizes,
+                               const common::Digest& rootHash) {
     size_t slash = filepath.find_last_of("/\\");
     std::string filename = (slash != std::string::npos) ? filepath.substr(slash + 1) : filepath;
-    int chunkSize = common::CHUNK_SIZE;
-    int totalChunks = static_cast<int>(chunks.size());
+    common::FileMetadata meta;
+    meta.filename = filename;
+    meta.rootHash = rootHash;
+    meta.fileSize = size;
+    meta.chunkSize = sizes.empty() ? common::CHUNK_SIZE : 0;
+    meta.totalChunks = static_cast<int>(hashes.size());
+    meta.chunkHashes = hashes;
+    meta.chunkSizes = sizes;
 
-    std::string hashesStr;
-    for (size_t i = 0; i < chunks.size(); ++i) {
-        if (i > 0) hashesStr += ",";
-        hashesStr += chunks[i].hash;
+    if (wireFormat_ == network::WireFormat::BINARY) {
+        network::Status status = network::Status::ERROR;
+        bool ok = withConnection(nodeAddr, [&](network::TCPClient& conn) {
+            uint64_t id = nextRequestId_++;
+            network::MessageWriter request(network::Opcode::PUT_META, id);
+            network::writeFileMetadata(request, meta);
+            std::vector<uint8_t> response;
+            network::MessageReader payload;
+            return binaryExchange(conn, request, network::Opcode::PUT_META, id, response, status, payload);
+        });
+        return ok && status == network::Status::OK;
     }
-    std::string cmd = "PUT " + filename + " " + std::to_string(size) + " " + std::to_string(chunkSize) +
-                      " " + std::to_string(totalChunks) + " " + rootHash + " " + hashesStr;
 
-    if (!client.sendMessage(cmd)) {
-        client.close();
-        return false;
-    }
-    std::string response = client.recvMessage();
-    client.close();
-    return response == "ACK";
+    std::string cmd = "PUT " + filename + " " + network::formatTextMetadata(meta);
+    std::string response;
+    bool ok = withConnection(nodeAddr, [&](network::TCPClient& conn) {
+        if (!conn.sendMessage(cmd)) return false;
+        response = conn.recvMessage();
+        return !response.empty();
+    });
+    return ok && response == "ACK";
 }
 
 void Client::downloadFile(const std::string& filename, const std::string& outputPath) {
@@ -125,134 +387,595 @@ void Client::downloadFile(const std::string& filename, const std::string& output
     std::cout << "Downloading " << filename << std::endl;
 
     common::FileMetadata meta;
-    bool found = false;
-    for (int i = static_cast<int>(metadataNodes_.size()) - 1; i >= 0; --i) {
-        meta = getMetadataFromNode(metadataNodes_[i], filename);
-        if (!meta.filename.empty() || !meta.chunkHashes.empty()) {
-            std::cout << "Retrieved metadata from " << metadataNodes_[i] << std::endl;
-            found = true;
-            break;
-        }
-    }
-    if (!found) {
+    std::string source;
+    if (!findMetadata(filename, meta, source)) {
         std::cerr << "File not found in metadata (or all nodes down)." << std::endl;
         return;
     }
+    std::cout << "Retrieved metadata from " << source << std::endl;
     std::cout << "Metadata found. Root: " << meta.rootHash << std::endl;
 
-    std::vector<common::Chunk> chunks;
-    for (size_t i = 0; i < meta.chunkHashes.size(); ++i) {
-        const std::string& hash = meta.chunkHashes[i];
-        auto nodes = dht_.getNodesForKey(hash, 2);
-        std::vector<uint8_t> data;
-        for (const auto& node : nodes) {
-            data = downloadChunkFromNode(hash, node);
-            if (!data.empty()) {
-                std::cout << "Retrieved chunk " << i << " from " << node << std::endl;
-                break;
+    if (!downloadChunks(meta, outputPath)) {
+        std::cerr << "Reconstruction failed." << std::endl;
+        std::remove(outputPath.c_str());
+    } else {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "File reconstructed at " << outputPath << " (" << meta.chunkHashes.size()
+                  << " chunks verified, " << mbPerSecond(meta.fileSize, seconds) << " MB/s)" << std::endl;
+    }
+    lastTotalDownloadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool Client::downloadChunks(const common::FileMetadata& meta, const std::string& outputPath) {
+    // Up to windowChunks chunks are fetched concurrently; each one is checked
+    // against its hash and written at its own offset as soon as it arrives.
+    const DownloadOptions options = downloadOptions_;
+    const int chunkSize = meta.chunkSize > 0 ? meta.chunkSize : common::CHUNK_SIZE;
+    std::vector<int64_t> offsets;
+    std::vector<size_t> lengths;
+    if (!chunkExtents(meta, offsets, lengths)) return false;
+    size_t largest = static_cast<size_t>(chunkSize);
+    for (size_t length : lengths) largest = std::max(largest, length);
+    common::ChunkWriter writer(outputPath, meta.fileSize, chunkSize);
+    if (!writer.isOpen()) return false;
+
+    TransferWindow window(options.windowChunks, options.windowChunks * largest);
+    common::ThreadPool workers(std::max<size_t>(1, options.windowChunks));
+    std::atomic<bool> failed{false};
+    std::mutex latencyMutex;
+    lastChunkLatencies.clear();
+
+    for (size_t i = 0; i < meta.chunkHashes.size() && !failed; ++i) {
+        size_t expected = lengths[i];
+        int64_t offset = offsets[i];
+        window.acquire(expected);
+        workers.submit([this, &meta, &writer, &window, &failed, &latencyMutex, &options, i, expected, offset]() {
+            auto start = std::chrono::steady_clock::now();
+            std::string node;
+            ChunkBytes data = fetchChunk(meta.chunkHashes[i], static_cast<int>(i), expected, options, node);
+            bool stored = !data.empty() && writer.writeAt(offset, data.data(), data.size());
+            if (stored) {
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "Retrieved chunk " << i << " from " << node << " ("
+                          << mbPerSecond(static_cast<int64_t>(data.size()), seconds) << " MB/s)" << std::endl;
+                std::lock_guard<std::mutex> lock(latencyMutex);
+                lastChunkLatencies.push_back(seconds * 1000.0);
+            } else if (!data.empty()) {
+                std::cerr << "Failed to write chunk " << i << std::endl;
+            }
+            if (!stored && !failed.exchange(true)) {
+                std::cerr << "Failed to retrieve chunk " << i << std::endl;
+            }
+            common::BufferPool::shared().release(std::move(data.buffer));
+            window.release(expected);
+        });
+    }
+    window.waitIdle();
+    return writer.close() && !failed;
+}
+
+std::vector<uint8_t> Client::read(const std::string& filename, int64_t offset, size_t length) {
+    common::FileMetadata meta;
+    std::string source;
+    std::vector<int64_t> offsets;
+    std::vector<size_t> lengths;
+    if (offset < 0 || length == 0 || !findMetadata(filename, meta, source)) return {};
+    if (offset >= meta.fileSize || !chunkExtents(meta, offsets, lengths)) return {};
+    const int64_t end = offset + static_cast<int64_t>(std::min<uint64_t>(length, meta.fileSize - offset));
+    // Chunks first .. last - 1 overlap the range.
+    size_t first = static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), offset) - offsets.begin()) - 1;
+    size_t last = static_cast<size_t>(std::lower_bound(offsets.begin(), offsets.end(), end) - offsets.begin());
+
+    const DownloadOptions options = downloadOptions_;
+    std::vector<uint8_t> out(static_cast<size_t>(end - offset));
+    std::atomic<bool> failed{false};
+    auto fetch = [&](size_t k) {
+        size_t i = first + k;
+        int64_t from = std::max(offset, offsets[i]);
+        int64_t to = std::min<int64_t>(end, offsets[i] + static_cast<int64_t>(lengths[i]));
+        size_t len = static_cast<size_t>(to - from);
+        ChunkBytes data;
+        if (len == lengths[i]) {
+            std::string node;
+            data = fetchChunk(meta.chunkHashes[i], static_cast<int>(i), len, options, node);
+        } else {
+            data = fetchRange(meta.chunkHashes[i], static_cast<uint64_t>(from - offsets[i]), len, options);
+        }
+        if (data.size() == len) {
+            std::copy(data.data(), data.data() + len, out.begin() + (from - offset));
+        } else if (!failed.exchange(true)) {
+            std::cerr << "Failed to read chunk " << i << " of " << filename << std::endl;
+        }
+        common::BufferPool::shared().release(std::move(data.buffer));
+    };
+    if (last - first == 1) {
+        fetch(0);
+    } else {
+        // The calling thread fetches too, so windowChunks - 1 workers fill the window.
+        size_t parallelism = std::max<size_t>(1, std::min(options.windowChunks, last - first));
+        readWorkers(std::max<size_t>(2, options.windowChunks) - 1)->parallelFor(last - first, fetch, parallelism);
+    }
+    if (failed) return {};
+    return out;
+}
+
+std::shared_ptr<common::ThreadPool> Client::readWorkers(size_t threads) {
+    std::lock_guard<std::mutex> lock(readMutex_);
+    // A read still running keeps the pool it started with alive.
+    if (!readWorkers_ || readWorkers_->size() < threads) readWorkers_ = std::make_shared<common::ThreadPool>(threads);
+    return readWorkers_;
+}
+
+Client::ChunkBytes Client::fetchChunk(const common::Digest& hash, int index, size_t expected,
+                                      const DownloadOptions& options, std::string& servedBy) {
+    auto nodes = dht_.getNodesForKey(hash, options.replicationFactor);
+    if (options.hedgedReads && nodes.size() > 1) {
+        return fetchChunkHedged(hash, index, expected, nodes, hedgeDelay(options), servedBy);
+    }
+    for (const auto& node : nodes) {
+        auto start = std::chrono::steady_clock::now();
+        ChunkBytes data;
+        common::Digest digest;
+        if (multiplexed()) {
+            withMultiplexed(node, [&](network::MultiplexedClient& conn) {
+                return requestChunkMultiplexed(conn, hash, data, digest);
+            });
+        } else {
+            withConnection(node, [&](network::TCPClient& conn) { return requestChunk(conn, hash, data, digest); });
+        }
+        if (!verifyChunk(data, digest, hash, index, expected, node)) continue;
+        chunkLatency_.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        servedBy = node;
+        return data;
+    }
+    return {};
+}
+
+Client::ChunkBytes Client::fetchChunkHedged(const common::Digest& hash, int index, size_t expected,
+                                            const std::vector<std::string>& nodes,
+                                            std::chrono::milliseconds delay, std::string& servedBy) {
+    // Replicas are asked in order; the next one is also asked whenever the
+    // outstanding requests have been quiet for `delay` or have all failed.
+    // The first verified response wins and the others are aborted.
+    struct HedgedRead {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done{false};
+        int running{0};
+        ChunkBytes data;
+        std::string node;
+        std::vector<network::TCPClient*> inFlight;
+    } read;
+
+    auto attempt = [this, &read, &hash, index, expected](const std::string& node) {
+        auto start = std::chrono::steady_clock::now();
+        ChunkBytes data;
+        common::Digest digest;
+        for (int tries = 0; tries < 2; ++tries) {
+            ConnectionPool::Lease lease = pool_->acquire(node);
+            if (!lease) break;
+            {
+                std::lock_guard<std::mutex> lock(read.mutex);
+                if (read.done) break;
+                read.inFlight.push_back(&*lease);
+            }
+            bool ok = requestChunk(*lease, hash, data, digest);
+            bool cancelled;
+            {
+                std::lock_guard<std::mutex> lock(read.mutex);
+                read.inFlight.erase(std::find(read.inFlight.begin(), read.inFlight.end(), &*lease));
+                cancelled = read.done;
+            }
+            if (!ok || cancelled) lease.invalidate();
+            if (ok || cancelled || !lease.reused()) break;
+        }
+
+        bool verified = verifyChunk(data, digest, hash, index, expected, node);
+        if (verified) {
+            chunkLatency_.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::lock_guard<std::mutex> lock(read.mutex);
+        if (verified && !read.done) {
+            read.done = true;
+            read.data = std::move(data);
+            read.node = node;
+            for (network::TCPClient* conn : read.inFlight) conn->abort();
+        }
+        read.running--;
+        read.cv.notify_all();
+    };
+
+    std::vector<std::thread> attempts;
+    std::unique_lock<std::mutex> lock(read.mutex);
+    size_t next = 0;
+    while (!read.done && (read.running > 0 || next < nodes.size())) {
+        if (next < nodes.size()) {
+            if (read.running > 0) {
+                std::cout << "Hedging chunk " << index << " to " << nodes[next] << std::endl;
             }
+            read.running++;
+            attempts.emplace_back(attempt, nodes[next++]);
         }
-        if (data.empty()) {
-            std::cerr << "Failed to retrieve chunk " << i << std::endl;
-            return;
+        if (next < nodes.size()) {
+            read.cv.wait_for(lock, delay, [&read]() { return read.done || read.running == 0; });
+        } else {
+            read.cv.wait(lock, [&read]() { return read.done || read.running == 0; });
         }
-        common::Chunk c;
-        c.index = static_cast<int>(i);
-        c.hash = hash;
-        c.data = std::move(data);
-        c.size = static_cast<int>(c.data.size());
-        chunks.push_back(std::move(c));
     }
+    lock.unlock();
+    for (auto& t : attempts) t.join();
+    servedBy = read.node;
+    return std::move(read.data);
+}
 
-    if (common::reconstructFile(chunks, outputPath)) {
-        std::cout << "File reconstructed at " << outputPath << std::endl;
-        std::cout << "Verifying integrity... (use verify_files tool to check)" << std::endl;
-    } else {
-        std::cerr << "Reconstruction failed." << std::endl;
+Client::ChunkBytes Client::fetchRange(const common::Digest& hash, uint64_t offset, size_t length,
+                                      const DownloadOptions& options) {
+    for (const auto& node : dht_.getNodesForKey(hash, options.replicationFactor)) {
+        ChunkBytes data;
+        common::Digest digest;
+        if (multiplexed()) {
+            withMultiplexed(node, [&](network::MultiplexedClient& conn) {
+                return requestChunkMultiplexed(conn, hash, data, digest, offset, length);
+            });
+        } else {
+            withConnection(node, [&](network::TCPClient& conn) {
+                return requestChunk(conn, hash, data, digest, offset, length);
+            });
+        }
+        if (data.size() == length) return data;
+        if (!data.empty()) std::cerr << "Range of chunk " << hash << " from " << node << " is short" << std::endl;
     }
-    lastTotalDownloadDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - startTime).count();
+    return {};
+}
+
+std::chrono::milliseconds Client::hedgeDelay(const DownloadOptions& options) const {
+    if (chunkLatency_.count() < kMinHedgeSamples) return options.initialHedgeDelay;
+    auto observed = std::chrono::milliseconds(static_cast<long>(chunkLatency_.percentile(options.hedgePercentile)));
+    return std::max(options.minHedgeDelay, observed);
+}
+
+bool Client::verifyChunk(const ChunkBytes& data, const common::Digest& digest, const common::Digest& hash,
+                         int index, size_t expected, const std::string& nodeAddr) {
+    if (data.empty()) return false;
+    if (data.size() != expected || digest != hash) {
+        std::cerr << "Chunk " << index << " from " << nodeAddr << " failed verification" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Client::findMetadata(const std::string& filename, common::FileMetadata& meta, std::string& source) {
+    for (int i = static_cast<int>(metadataNodes_.size()) - 1; i >= 0; --i) {
+        meta = getMetadataFromNode(metadataNodes_[i], filename);
+        if (!meta.filename.empty() || !meta.chunkHashes.empty()) {
+            source = metadataNodes_[i];
+            return true;
+        }
+    }
+    return false;
 }
 
 common::FileMetadata Client::getMetadataFromNode(const std::string& nodeAddr, const std::string& filename) {
     common::FileMetadata meta;
-    size_t colon = nodeAddr.find(':');
-    if (colon == std::string::npos) return meta;
-    std::string ip = nodeAddr.substr(0, colon);
-    int port = std::stoi(nodeAddr.substr(colon + 1));
-
-    network::TCPClient client;
-    if (!client.connect(ip, port)) return meta;
-    if (!client.sendMessage("GET " + filename)) {
-        client.close();
-        return meta;
+    if (wireFormat_ == network::WireFormat::BINARY) {
+        bool found = false;
+        withConnection(nodeAddr, [&](network::TCPClient& conn) {
+            uint64_t id = nextRequestId_++;
+            network::MessageWriter request(network::Opcode::GET_META, id);
+            request.string(filename);
+            std::vector<uint8_t> response;
+            network::Status status;
+            network::MessageReader payload;
+            if (!binaryExchange(conn, request, network::Opcode::GET_META, id, response, status, payload)) {
+                return false;
+            }
+            found = status == network::Status::OK && network::readFileMetadata(payload, meta);
+            return true;
+        });
+        return found ? meta : common::FileMetadata();
     }
-    std::string response = client.recvMessage();
-    client.close();
+
+    std::string response;
+    bool ok = withConnection(nodeAddr, [&](network::TCPClient& conn) {
+        if (!conn.sendMessage("GET " + filename)) return false;
+        response = conn.recvMessage();
+        return !response.empty();
+    });
+    if (!ok) return meta;
 
     if (response.size() > 6 && response.substr(0, 6) == "FOUND ") {
-        std::istringstream iss(response.substr(6));
-        std::string hashesStr;
-        iss >> meta.fileSize >> meta.chunkSize >> meta.totalChunks >> meta.rootHash;
-        if (iss >> hashesStr) {
-            meta.filename = filename;
-            meta.chunkHashes.clear();
-            std::istringstream hs(hashesStr);
-            std::string h;
-            while (std::getline(hs, h, ',')) {
-                if (!h.empty()) meta.chunkHashes.push_back(h);
-            }
-        }
+        if (!network::parseTextMetadata(response.substr(6), meta)) return common::FileMetadata();
+        meta.filename = filename;
     }
     return meta;
 }
 
 bool Client::uploadChunkToNode(const common::Chunk& chunk, const std::string& nodeAddr) {
-    size_t colon = nodeAddr.find(':');
-    if (colon == std::string::npos) return false;
-    std::string ip = nodeAddr.substr(0, colon);
-    int port = std::stoi(nodeAddr.substr(colon + 1));
-
-    network::TCPClient client;
-    if (!client.connect(ip, port)) return false;
-    if (!client.sendMessage("STORE " + chunk.hash)) {
-        client.close();
-        return false;
+    if (multiplexed()) {
+        // The chunk rides in the request frame; no READY round trip.
+        network::Status status = network::Status::ERROR;
+        bool ok = withMultiplexed(nodeAddr, [&](network::MultiplexedClient& conn) {
+            uint64_t id = conn.nextRequestId();
+            network::MessageWriter request(network::Opcode::STORE, id, network::kFlagMultiplexed);
+            request.digest(chunk.hash);
+            std::vector<uint8_t> response =
+                conn.call(request.finish(chunk.data.size()), chunk.data.data(), chunk.data.size());
+            network::MessageReader payload;
+            return network::parseResponse(response, network::Opcode::STORE, id, status, payload);
+        });
+        return ok && status == network::Status::OK;
     }
-    std::string response = client.recvMessage();
-    if (response != "READY") {
-        client.close();
-        return false;
+    if (wireFormat_ == network::WireFormat::BINARY) {
+        network::Status status = network::Status::ERROR;
+        bool ok = withConnection(nodeAddr, [&](network::TCPClient& conn) {
+            uint64_t id = nextRequestId_++;
+            network::MessageWriter request(network::Opcode::STORE, id);
+            request.digest(chunk.hash);
+            std::vector<uint8_t> response;
+            network::MessageReader payload;
+            if (!binaryExchange(conn, request, network::Opcode::STORE, id, response, status, payload)) return false;
+            if (status != network::Status::READY) return true;
+            if (!conn.sendData(chunk.data)) return false;
+            response = conn.recvData();
+            return network::parseResponse(response, network::Opcode::STORE, id, status, payload);
+        });
+        return ok && status == network::Status::OK;
     }
-    if (!client.sendData(chunk.data)) {
-        client.close();
-        return false;
+
+    std::string response;
+    bool ok = withConnection(nodeAddr, [&](network::TCPClient& conn) {
+        if (!conn.sendMessage("STORE " + chunk.hash.toHex())) return false;
+        response = conn.recvMessage();
+        if (response != "READY") return !response.empty();
+        if (!conn.sendData(chunk.data)) return false;
+        response = conn.recvMessage();
+        return !response.empty();
+    });
+    return ok && response == "ACK";
+}
+
+std::vector<bool> Client::uploadChunksToNode(const std::vector<const common::Chunk*>& chunks,
+                                            const std::string& nodeAddr) {
+    auto encode = [&chunks](network::MessageWriter& request) {
+        request.u32(static_cast<uint32_t>(chunks.size()));
+        for (const common::Chunk* chunk : chunks) {
+            request.digest(chunk->hash).u32(static_cast<uint32_t>(chunk->data.size()));
+            request.bytes(chunk->data.data(), chunk->data.size());
+        }
+    };
+    std::vector<bool> stored;
+    auto decode = [&chunks, &stored](network::Status status, network::MessageReader& payload) {
+        const uint8_t* statuses;
+        if (status != network::Status::OK || !payload.bytes(statuses, chunks.size())) return;
+        stored.resize(chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i) stored[i] = statuses[i] == static_cast<uint8_t>(network::Status::OK);
+    };
+    if (multiplexed()) {
+        withMultiplexed(nodeAddr, [&](network::MultiplexedClient& conn) {
+            uint64_t id = conn.nextRequestId();
+            network::MessageWriter request(network::Opcode::STORE_MULTI, id, network::kFlagMultiplexed);
+            encode(request);
+            std::vector<uint8_t> response = conn.call(request.finish());
+            network::Status status;
+            network::MessageReader payload;
+            if (!network::parseResponse(response, network::Opcode::STORE_MULTI, id, status, payload)) return false;
+            decode(status, payload);
+            return true;
+        });
+        return stored;
     }
-    response = client.recvMessage();
-    client.close();
-    return response == "ACK";
+    withConnection(nodeAddr, [&](network::TCPClient& conn) {
+        uint64_t id = nextRequestId_++;
+        network::MessageWriter request(network::Opcode::STORE_MULTI, id);
+        encode(request);
+        std::vector<uint8_t> response;
+        network::Status status;
+        network::MessageReader payload;
+        if (!binaryExchange(conn, request, network::Opcode::STORE_MULTI, id, response, status, payload)) return false;
+        decode(status, payload);
+        return true;
+    });
+    return stored;
 }
 
-std::vector<uint8_t> Client::downloadChunkFromNode(const std::string& hash, const std::string& nodeAddr) {
-    size_t colon = nodeAddr.find(':');
-    if (colon == std::string::npos) return {};
-    std::string ip = nodeAddr.substr(0, colon);
-    int port = std::stoi(nodeAddr.substr(colon + 1));
-
-    network::TCPClient client;
-    if (!client.connect(ip, port)) return {};
-    if (!client.sendMessage("GET " + hash)) {
-        client.close();
+std::vector<bool> Client::probeChunks(const std::string& nodeAddr, const std::vector<common::Digest>& hashes) {
+    if (wireFormat_ == network::WireFormat::BINARY) {
+        std::vector<bool> present;
+        withConnection(nodeAddr, [&](network::TCPClient& conn) {
+            uint64_t id = nextRequestId_++;
+            network::MessageWriter request(network::Opcode::HAS_MULTI, id);
+            request.u32(static_cast<uint32_t>(hashes.size()));
+            for (const auto& hash : hashes) request.digest(hash);
+            std::vector<uint8_t> response;
+            network::Status status;
+            network::MessageReader payload;
+            if (!binaryExchange(conn, request, network::Opcode::HAS_MULTI, id, response, status, payload)) {
+                return false;
+            }
+            const uint8_t* bitmap;
+            if (status == network::Status::OK && payload.bytes(bitmap, (hashes.size() + 7) / 8)) {
+                present.resize(hashes.size());
+                for (size_t i = 0; i < hashes.size(); ++i) present[i] = bitmap[i / 8] & (0x80 >> (i % 8));
+            }
+            return true;
+        });
+        return present;
+    }
+
+    std::string cmd = "HAS_MULTI ";
+    cmd.reserve(cmd.size() + hashes.size() * (common::Digest::kSize * 2 + 1));
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        if (i > 0) cmd += ",";
+        cmd += hashes[i].toHex();
+    }
+    std::string response;
+    bool ok = withConnection(nodeAddr, [&](network::TCPClient& conn) {
+        if (!conn.sendMessage(cmd)) return false;
+        response = conn.recvMessage();
+        return !response.empty();
+    });
+    // Nodes that predate HAS_MULTI answer ERROR; everything is then sent.
+    const std::string prefix = "PRESENT ";
+    if (!ok || response.compare(0, prefix.size(), prefix) != 0 || response.size() != prefix.size() + hashes.size()) {
         return {};
     }
-    std::string response = client.recvMessage();
-    if (response == "FOUND") {
-        auto data = client.recvData();
-        client.close();
-        return data;
+    std::vector<bool> present(hashes.size());
+    for (size_t i = 0; i < hashes.size(); ++i) present[i] = response[prefix.size() + i] == '1';
+    return present;
+}
+
+std::vector<uint8_t> Client::downloadChunkFromNode(const common::Digest& hash, const std::string& nodeAddr) {
+    ChunkBytes data;
+    common::Digest digest;
+    if (multiplexed()) {
+        withMultiplexed(nodeAddr, [&](network::MultiplexedClient& conn) {
+            return requestChunkMultiplexed(conn, hash, data, digest);
+        });
+    } else {
+        withConnection(nodeAddr, [&](network::TCPClient& conn) { return requestChunk(conn, hash, data, digest); });
     }
-    client.close();
-    return {};
+    // Callers want the chunk on its own; only one behind a header is copied.
+    if (data.offset == 0) return std::move(data.buffer);
+    return std::vector<uint8_t>(data.data(), data.data() + data.size());
+}
+
+std::vector<std::vector<uint8_t>> Client::downloadChunksFromNode(const std::vector<common::Digest>& hashes,
+                                                                 const std::string& nodeAddr) {
+    std::vector<std::vector<uint8_t>> chunks(hashes.size());
+    // Chunks the batch did not carry, over kMaxBatchBytes or for want of
+    // the binary format, are fetched one by one.
+    std::vector<bool> single(hashes.size(), true);
+    if (wireFormat_ == network::WireFormat::BINARY) {
+        withConnection(nodeAddr, [&](network::TCPClient& conn) {
+            uint64_t id = nextRequestId_++;
+            network::MessageWriter request(network::Opcode::GET_MULTI, id);
+            request.u32(static_cast<uint32_t>(hashes.size()));
+            for (const auto& hash : hashes) request.digest(hash);
+            std::vector<uint8_t> response;
+            network::Status status;
+            network::MessageReader payload;
+            if (!binaryExchange(conn, request, network::Opcode::GET_MULTI, id, response, status, payload)) {
+                return false;
+            }
+            if (status != network::Status::OK) return true;
+            for (size_t i = 0; i < hashes.size(); ++i) {
+                uint8_t itemStatus;
+                if (!payload.u8(itemStatus)) break;
+                if (itemStatus == static_cast<uint8_t>(network::Status::ERROR)) continue;
+                single[i] = false;
+                if (itemStatus != static_cast<uint8_t>(network::Status::OK)) continue;
+                uint32_t len;
+                const uint8_t* data;
+                if (!payload.u32(len) || !payload.bytes(data, len)) break;
+                if (common::sha256(data, len) == hashes[i]) chunks[i].assign(data, data + len);
+            }
+            return true;
+        });
+    }
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        if (!single[i]) continue;
+        std::vector<uint8_t> data = downloadChunkFromNode(hashes[i], nodeAddr);
+        if (!data.empty() && common::sha256(data) == hashes[i]) chunks[i] = std::move(data);
+    }
+    return chunks;
+}
+
+bool Client::requestChunkMultiplexed(network::MultiplexedClient& conn, const common::Digest& hash,
+                                     ChunkBytes& data, common::Digest& digest, uint64_t offset, size_t length) {
+    data.buffer.clear();
+    data.offset = 0;
+    digest = common::Digest();
+    uint64_t id = conn.nextRequestId();
+    network::Opcode op = length > 0 ? network::Opcode::GET_RANGE : network::Opcode::GET;
+    network::MessageWriter request(op, id, network::kFlagMultiplexed);
+    request.digest(hash);
+    if (length > 0) request.u64(offset).u32(static_cast<uint32_t>(length));
+    std::vector<uint8_t> response = conn.call(request.finish());
+    network::Status status;
+    network::MessageReader payload;
+    if (!network::parseResponse(response, op, id, status, payload)) return false;
+    if (status != network::Status::OK) return true;
+    // The chunk follows the status byte in the same frame; it stays there.
+    data.buffer = std::move(response);
+    data.offset = network::kHeaderSize + 1;
+    digest = common::sha256(data.data(), data.size());
+    return !data.empty();
+}
+
+bool Client::requestChunk(network::TCPClient& conn, const common::Digest& hash, ChunkBytes& data,
+                          common::Digest& digest, uint64_t offset, size_t length) {
+    data.buffer.clear();
+    data.offset = 0;
+    digest = common::Digest();
+    if (wireFormat_ == network::WireFormat::BINARY) {
+        uint64_t id = nextRequestId_++;
+        network::Opcode op = length > 0 ? network::Opcode::GET_RANGE : network::Opcode::GET;
+        network::MessageWriter request(op, id);
+        request.digest(hash);
+        if (length > 0) request.u64(offset).u32(static_cast<uint32_t>(length));
+        std::vector<uint8_t> response;
+        network::Status status;
+        network::MessageReader payload;
+        if (!binaryExchange(conn, request, op, id, response, status, payload)) return false;
+        if (status != network::Status::OK) return true;
+    } else {
+        std::string command = "GET " + hash.toHex();
+        if (length > 0) {
+            command = "GET_RANGE " + hash.toHex() + " " + std::to_string(offset) + " " + std::to_string(length);
+        }
+        if (!conn.sendMessage(command)) return false;
+        std::string response = conn.recvMessage();
+        if (response != "FOUND") return !response.empty();
+    }
+    common::Sha256 hasher;
+    data.buffer = conn.recvData(hasher);
+    digest = hasher.final();
+    return !data.empty();
+}
+
+bool Client::withConnection(const std::string& nodeAddr,
+                            const std::function<bool(network::TCPClient&)>& exchange) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        ConnectionPool::Lease lease = pool_->acquire(nodeAddr);
+        if (!lease) return false;
+        if (exchange(*lease)) return true;
+        lease.invalidate();
+        // A fresh connection that fails means the node itself is unavailable.
+        if (!lease.reused()) return false;
+    }
+    return false;
+}
+
+bool Client::withMultiplexed(const std::string& nodeAddr,
+                             const std::function<bool(network::MultiplexedClient&)>& exchange) {
+    size_t colon = nodeAddr.find(':');
+    if (colon == std::string::npos) return false;
+    const char* portText = nodeAddr.c_str() + colon + 1;
+    char* end = nullptr;
+    long port = std::strtol(portText, &end, 10);
+    if (end == portText || *end != '\0' || port <= 0 || port > 65535) return false;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::shared_ptr<network::MultiplexedClient> conn;
+        bool fresh = false;
+        {
+            std::lock_guard<std::mutex> lock(muxMutex_);
+            std::shared_ptr<network::MultiplexedClient>& slot = multiplexed_[nodeAddr];
+            if (!slot || !slot->isConnected()) {
+                slot = std::make_shared<network::MultiplexedClient>();
+                fresh = true;
+                if (!slot->connect(nodeAddr.substr(0, colon), static_cast<int>(port))) {
+                    slot.reset();
+                    return false;
+                }
+            }
+            conn = slot;
+        }
+        if (exchange(*conn)) return true;
+        // A node that answered, or a connection just opened, is not retried.
+        if (conn->isConnected() || fresh) return false;
+    }
+    return false;
 }
 
 }  // namespace client
@@ -1,36 +1,186 @@
 #pragma once
 
+#include "client/connection_pool.hpp"
 #include "common/chunk.hpp"
+#include "common/digest.hpp"
 #include "common/file_metadata.hpp"
+#include "common/file_utils.hpp"
+#include "common/latency_tracker.hpp"
+#include "common/thread_pool.hpp"
 #include "dht/consistent_hash.hpp"
+#include "network/multiplexed_client.hpp"
+#include "network/protocol.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace dfs {
 namespace client {
 
+struct UploadOptions {
+    size_t windowChunks{8};                  // chunks in flight at once
+    size_t windowBytes{64 * 1024 * 1024};    // bytes in flight at once
+    int replicationFactor{2};
+    int minReplicas{1};                      // stored copies required per chunk
+    // Ask each replica which chunks it already has (HAS_MULTI) and send it
+    // only the others; a replica that has a chunk counts as a stored copy.
+    bool skipExisting{true};
+    // Content-defined chunks keep their hashes when data is inserted or
+    // removed elsewhere in the file, so edited files re-upload little.
+    common::Chunking chunking{common::Chunking::FIXED};
+    // Chunks up to batchChunkBytes, such as small files and tails, reach
+    // each replica many to a STORE_MULTI request of up to batchBytes instead
+    // of a STORE round trip each, and count against the window by bytes
+    // alone. Binary format only; 0 sends every chunk on its own.
+    size_t batchChunkBytes{64 * 1024};
+    size_t batchBytes{4 * 1024 * 1024};
+};
+
+struct DownloadOptions {
+    size_t windowChunks{8};                  // chunks fetched at once
+    int replicationFactor{2};                // replicas tried per chunk
+    // Hedged reads: when a replica has not answered within the hedgePercentile
+    // latency of recent chunk GETs, the same GET also goes to the next replica.
+    bool hedgedReads{false};
+    double hedgePercentile{95.0};
+    std::chrono::milliseconds minHedgeDelay{2};
+    std::chrono::milliseconds initialHedgeDelay{50};  // until enough samples exist
+};
+
 class Client {
 public:
+    // Clients that share a pool also share its keep-alive connections.
     Client(const std::vector<std::string>& storageNodes,
-           const std::vector<std::string>& metadataNodes);
+           const std::vector<std::string>& metadataNodes,
+           std::shared_ptr<ConnectionPool> pool = nullptr);
 
+    void setUploadOptions(const UploadOptions& options) { uploadOptions_ = options; }
+    void setDownloadOptions(const DownloadOptions& options) { downloadOptions_ = options; }
+    // BINARY by default; TEXT talks to nodes that predate the binary protocol.
+    void setWireFormat(network::WireFormat format) { wireFormat_ = format; }
+    // Sends every chunk STORE and GET for a storage node over one
+    // multiplexed connection, however many are in flight, instead of one
+    // pooled connection each. Needs the binary format. Hedged reads keep
+    // using the pool: they cancel the losing request by aborting its socket.
+    void setMultiplexing(bool enabled) { multiplexing_ = enabled; }
     void uploadFile(const std::string& filepath);
+    // Uploads the files together: their chunks share the upload window and
+    // batches, and metadata for several files is put at once. False if any
+    // file failed.
+    bool uploadFiles(const std::vector<std::string>& filepaths);
     void downloadFile(const std::string& filename, const std::string& outputPath);
-    std::vector<uint8_t> downloadChunkFromNode(const std::string& hash, const std::string& nodeAddr);
+    // Bytes [offset, offset + length) of the file, cut short at its end.
+    // Only the chunks the range overlaps are fetched, and of a chunk it
+    // covers in part only that part, with GET_RANGE. Whole chunks are
+    // verified against their digests; a partial one is only checked for
+    // length. Empty past the end of the file or on failure.
+    std::vector<uint8_t> read(const std::string& filename, int64_t offset, size_t length);
+    std::vector<uint8_t> downloadChunkFromNode(const common::Digest& hash, const std::string& nodeAddr);
+    // Fetches the chunks with GET_MULTI: one entry per digest, empty for a
+    // chunk the node does not have or that fails verification.
+    std::vector<std::vector<uint8_t>> downloadChunksFromNode(const std::vector<common::Digest>& hashes,
+                                                             const std::string& nodeAddr);
 
     long lastMetadataUploadDuration{0};
     long lastChunkUploadDuration{0};
     long lastTotalUploadDuration{0};
     long lastTotalDownloadDuration{0};
+    int64_t lastUploadBytesSent{0};       // chunk bytes put on the wire, all replicas
+    int64_t lastUploadBytesSkipped{0};    // chunk bytes replicas already had
+    std::vector<double> lastChunkLatencies;  // ms per chunk of the last download
 
 private:
-    bool putMetadataToNode(const std::string& nodeAddr, const std::string& filepath,
-                           const std::vector<common::Chunk>& chunks, const std::string& rootHash);
+    // A file being uploaded; `sizes` stays empty for fixed-size chunks.
+    struct FileUpload {
+        std::string path;
+        int64_t size{0};
+        std::vector<common::Digest> hashes;
+        std::vector<uint32_t> sizes;
+    };
+
+    // `sizes` is empty for fixed-size chunks.
+    bool putMetadataToNode(const std::string& nodeAddr, const std::string& filepath, int64_t size,
+                           const std::vector<common::Digest>& hashes, const std::vector<uint32_t>& sizes,
+                           const common::Digest& rootHash);
     common::FileMetadata getMetadataFromNode(const std::string& nodeAddr, const std::string& filename);
+    // Asks the metadata nodes from the tail of the chain back; `source` is
+    // the one that answered. False if none knows the file.
+    bool findMetadata(const std::string& filename, common::FileMetadata& meta, std::string& source);
+    // Streams the files one after another through the upload window,
+    // filling in each one's size, chunk hashes and chunk lengths.
+    bool uploadChunks(std::vector<FileUpload>& files);
+    // Puts the file's metadata to the first metadata node that takes it.
+    bool putMetadata(const FileUpload& file);
+    // Chunk bytes as they arrived: `offset` into `buffer`, past the
+    // response header a multiplexed GET carries them behind, so they are
+    // never moved to the front.
+    struct ChunkBytes {
+        std::vector<uint8_t> buffer;
+        size_t offset{0};
+        const uint8_t* data() const { return buffer.data() + offset; }
+        size_t size() const { return buffer.size() - offset; }
+        bool empty() const { return size() == 0; }
+    };
+
+    // Fetches, verifies and writes every chunk of `meta` into outputPath.
+    bool downloadChunks(const common::FileMetadata& meta, const std::string& outputPath);
+    ChunkBytes fetchChunk(const common::Digest& hash, int index, size_t expected, const DownloadOptions& options,
+                          std::string& servedBy);
+    ChunkBytes fetchChunkHedged(const common::Digest& hash, int index, size_t expected,
+                                const std::vector<std::string>& nodes, std::chrono::milliseconds delay,
+                                std::string& servedBy);
+    std::chrono::milliseconds hedgeDelay(const DownloadOptions& options) const;
+    // `length` bytes of the chunk from `offset` on, from the first replica
+    // that has them; never hedged.
+    ChunkBytes fetchRange(const common::Digest& hash, uint64_t offset, size_t length, const DownloadOptions& options);
+    // `digest` is what requestChunk() computed while the chunk arrived.
+    static bool verifyChunk(const ChunkBytes& data, const common::Digest& digest, const common::Digest& hash,
+                            int index, size_t expected, const std::string& nodeAddr);
+    // A GET, or with a nonzero `length` a GET_RANGE for that slice.
+    bool requestChunk(network::TCPClient& conn, const common::Digest& hash, ChunkBytes& data,
+                      common::Digest& digest, uint64_t offset = 0, size_t length = 0);
+    bool requestChunkMultiplexed(network::MultiplexedClient& conn, const common::Digest& hash, ChunkBytes& data,
+                                 common::Digest& digest, uint64_t offset = 0, size_t length = 0);
     bool uploadChunkToNode(const common::Chunk& chunk, const std::string& nodeAddr);
+    // One STORE_MULTI: a flag per chunk, whether the node stored it. Empty
+    // if the node could not take the batch.
+    std::vector<bool> uploadChunksToNode(const std::vector<const common::Chunk*>& chunks, const std::string& nodeAddr);
+    // One flag per digest: whether `nodeAddr` already stores it. Empty if
+    // the node could not be asked.
+    std::vector<bool> probeChunks(const std::string& nodeAddr, const std::vector<common::Digest>& hashes);
+    // Runs one request/response exchange on a pooled connection. `exchange`
+    // returns false on transport failure; a stale reused connection is retried
+    // once on a fresh socket.
+    bool withConnection(const std::string& nodeAddr, const std::function<bool(network::TCPClient&)>& exchange);
+    // As withConnection(), on the node's multiplexed connection, which is
+    // opened on first use and replaced once if it broke.
+    bool withMultiplexed(const std::string& nodeAddr,
+                         const std::function<bool(network::MultiplexedClient&)>& exchange);
+    bool multiplexed() const { return multiplexing_ && wireFormat_ == network::WireFormat::BINARY; }
+    // Workers for the chunks of a read(), kept between calls; replaced by a
+    // larger pool once the window needs more than `threads`.
+    std::shared_ptr<common::ThreadPool> readWorkers(size_t threads);
 
     dht::ConsistentHash dht_;
     std::vector<std::string> metadataNodes_;
+    std::shared_ptr<ConnectionPool> pool_;
+    UploadOptions uploadOptions_;
+    DownloadOptions downloadOptions_;
+    network::WireFormat wireFormat_{network::WireFormat::BINARY};
+    std::atomic<uint64_t> nextRequestId_{1};
+    bool multiplexing_{false};
+    std::mutex muxMutex_;
+    std::map<std::string, std::shared_ptr<network::MultiplexedClient>> multiplexed_;
+    std::mutex readMutex_;
+    std::shared_ptr<common::ThreadPool> readWorkers_;
+    // Latency of recent successful chunk GETs; drives the hedge delay.
+    common::LatencyTracker chunkLatency_;
+    static constexpr size_t kMinHedgeSamples = 20;
 };
 
 }  // namespace client
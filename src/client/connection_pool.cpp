@@ -0,0 +1,94 @@
+#include "client/connection_pool.hpp"
+#include <cstdlib>
+
+namespace dfs {
+namespace client {
+
+ConnectionPool::Lease::Lease(ConnectionPool* pool, std::string nodeAddr,
+                             std::unique_ptr<network::TCPClient> client, bool reused)
+    : pool_(pool), nodeAddr_(std::move(nodeAddr)), client_(std::move(client)), reused_(reused) {}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_),
+      nodeAddr_(std::move(other.nodeAddr_)),
+      client_(std::move(other.client_)),
+      reused_(other.reused_),
+      reusable_(other.reusable_) {
+    other.pool_ = nullptr;
+}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        nodeAddr_ = std::move(other.nodeAddr_);
+        client_ = std::move(other.client_);
+        reused_ = other.reused_;
+        reusable_ = other.reusable_;
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+ConnectionPool::Lease::~Lease() {
+    release();
+}
+
+void ConnectionPool::Lease::release() {
+    if (pool_) pool_->release(nodeAddr_, std::move(client_), reusable_);
+    pool_ = nullptr;
+}
+
+ConnectionPool::ConnectionPool(PoolOptions options) : options_(options) {}
+
+ConnectionPool::Lease ConnectionPool::acquire(const std::string& nodeAddr) {
+    size_t colon = nodeAddr.find(':');
+    if (colon == std::string::npos) return Lease();
+    std::string ip = nodeAddr.substr(0, colon);
+    // A malformed port only fails the connect, as it did before pooling.
+    const char* portText = nodeAddr.c_str() + colon + 1;
+    char* end = nullptr;
+    long port = std::strtol(portText, &end, 10);
+    if (end == portText || *end != '\0' || port <= 0 || port > 65535) return Lease();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    NodePool& node = nodes_[nodeAddr];
+    if (!node.cv.wait_for(lock, options_.acquireTimeout,
+                          [&]() { return node.active < options_.maxActivePerNode; })) {
+        return Lease();
+    }
+    node.active++;
+    while (!node.idle.empty()) {
+        std::unique_ptr<network::TCPClient> client = std::move(node.idle.back());
+        node.idle.pop_back();
+        // The node may have closed the socket while it sat in the pool.
+        if (client->isHealthy()) return Lease(this, nodeAddr, std::move(client), true);
+    }
+    lock.unlock();
+
+    std::unique_ptr<network::TCPClient> client(new network::TCPClient());
+    if (!client->connect(ip, static_cast<int>(port))) {
+        release(nodeAddr, nullptr, false);
+        return Lease();
+    }
+    return Lease(this, nodeAddr, std::move(client), false);
+}
+
+void ConnectionPool::release(const std::string& nodeAddr, std::unique_ptr<network::TCPClient> client,
+                             bool reusable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodePool& node = nodes_[nodeAddr];
+    node.active--;
+    if (client && reusable && client->isConnected() && node.idle.size() < options_.maxIdlePerNode) {
+        node.idle.push_back(std::move(client));
+    }
+    node.cv.notify_one();
+}
+
+void ConnectionPool::closeIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& p : nodes_) p.second.idle.clear();
+}
+
+}  // namespace client
+}  // namespace dfs
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "network/tcp_client.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dfs {
+namespace client {
+
+struct PoolOptions {
+    size_t maxIdlePerNode{4};
+    size_t maxActivePerNode{64};
+    std::chrono::milliseconds acquireTimeout{10000};
+};
+
+// Keep-alive TCP connections per "ip:port", shared by any number of threads and
+// Client instances. Idle connections are health-checked before they are reused.
+class ConnectionPool {
+public:
+    // Exclusive use of one connection; returned to the pool on destruction
+    // unless invalidate() was called.
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        explicit operator bool() const { return client_ != nullptr; }
+        network::TCPClient& operator*() const { return *client_; }
+        network::TCPClient* operator->() const { return client_.get(); }
+        bool reused() const { return reused_; }
+        void invalidate() { reusable_ = false; }
+
+    private:
+        friend class ConnectionPool;
+        Lease(ConnectionPool* pool, std::string nodeAddr, std::unique_ptr<network::TCPClient> client, bool reused);
+        void release();
+
+        ConnectionPool* pool_{nullptr};
+        std::string nodeAddr_;
+        std::unique_ptr<network::TCPClient> client_;
+        bool reused_{false};
+        bool reusable_{true};
+    };
+
+    explicit ConnectionPool(PoolOptions options = PoolOptions());
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    Lease acquire(const std::string& nodeAddr);
+    void closeIdle();
+
+private:
+    struct NodePool {
+        std::deque<std::unique_ptr<network::TCPClient>> idle;
+        size_t active{0};
+        std::condition_variable cv;
+    };
+
+    void release(const std::string& nodeAddr, std::unique_ptr<network::TCPClient> client, bool reusable);
+
+    PoolOptions options_;
+    std::mutex mutex_;
+    std::map<std::string, NodePool> nodes_;
+};
+
+}  // namespace client
+}  // namespace dfs
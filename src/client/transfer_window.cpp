@@ -0,0 +1,39 @@
+#include "client/transfer_window.hpp"
+
+namespace dfs {
+namespace client {
+
+TransferWindow::TransferWindow(size_t maxChunks, size_t maxBytes)
+    : maxChunks_(maxChunks == 0 ? 1 : maxChunks), maxBytes_(maxBytes) {}
+
+void TransferWindow::acquire(size_t bytes, size_t chunks) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() { return fits(bytes, chunks); });
+    chunks_ += chunks;
+    bytes_ += bytes;
+}
+
+bool TransferWindow::tryAcquire(size_t bytes, size_t chunks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fits(bytes, chunks)) return false;
+    chunks_ += chunks;
+    bytes_ += bytes;
+    return true;
+}
+
+void TransferWindow::release(size_t bytes, size_t chunks) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks_ -= chunks;
+        bytes_ -= bytes;
+    }
+    cv_.notify_all();
+}
+
+void TransferWindow::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() { return chunks_ == 0 && bytes_ == 0; });
+}
+
+}  // namespace client
+}  // namespace dfs
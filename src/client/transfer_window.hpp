@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace dfs {
+namespace client {
+
+// Bounds the chunks and bytes a transfer keeps in flight. acquire() blocks
+// until the new chunk fits; a single chunk larger than the byte budget is
+// admitted once the window is otherwise empty. A chunk may count as 0
+// chunks, such as small ones that travel many to a request, and is then
+// bounded by its bytes alone.
+class TransferWindow {
+public:
+    TransferWindow(size_t maxChunks, size_t maxBytes);
+
+    void acquire(size_t bytes, size_t chunks = 1);
+    // acquire() without blocking; false if the chunk does not fit yet.
+    bool tryAcquire(size_t bytes, size_t chunks = 1);
+    void release(size_t bytes, size_t chunks = 1);
+    void waitIdle();
+
+private:
+    bool fits(size_t bytes, size_t chunks) const {
+        return (chunks_ == 0 && bytes_ == 0) || (chunks_ + chunks <= maxChunks_ && bytes_ + bytes <= maxBytes_);
+    }
+
+    const size_t maxChunks_;
+    const size_t maxBytes_;
+    size_t chunks_{0};
+    size_t bytes_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+}  // namespace client
+}  // namespace dfs
@@ -1,19 +1,37 @@
 #include "client/verify_files.hpp"
 #include "common/file_utils.hpp"
 #include "common/hash_utils.hpp"
+#include "common/sha256.hpp"
+#include "common/thread_pool.hpp"
+#include <algorithm>
 
 namespace dfs {
 namespace client {
 
-std::string computeCID(const std::string& filepath) {
-    auto chunks = common::splitFileIntoChunks(filepath);
-    if (chunks.empty()) return "";
-    common::hashAllChunks(chunks);
-    std::vector<std::string> chunkHashes;
-    for (const auto& c : chunks) {
-        chunkHashes.push_back(c.hash);
-    }
-    return common::computeRootHash(chunkHashes);
+std::string computeCID(const std::string& filepath, size_t threads) {
+    // Each round reads one chunk per multi-buffer lane for every hashing
+    // thread, capped so read-ahead stays within kMaxBufferedChunks.
+    const size_t kMaxBufferedChunks = 64;
+    const size_t lanes = common::sha256BatchLanes();
+    if (threads == 0) threads = common::ThreadPool::shared().size();
+    threads = std::max<size_t>(1, std::min(threads, kMaxBufferedChunks / lanes));
+    const size_t perRound = lanes * threads;
+
+    common::ChunkReader reader(filepath, perRound);
+    std::vector<common::Chunk> batch(perRound);
+    std::vector<common::Digest> chunkHashes;
+    size_t count;
+    do {
+        count = 0;
+        while (count < perRound && reader.next(batch[count])) ++count;
+        common::hashChunks(batch.data(), count, threads);
+        for (size_t i = 0; i < count; ++i) {
+            chunkHashes.push_back(batch[i].hash);
+            reader.recycle(batch[i]);
+        }
+    } while (count == perRound);
+    if (chunkHashes.empty()) return "";
+    return common::computeRootHash(chunkHashes).toHex();
 }
 
 }  // namespace client
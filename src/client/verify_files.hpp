@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace dfs {
 namespace client {
 
-std::string computeCID(const std::string& filepath);
+// Root hash of a file, in hex, as the client computes it on upload. Chunks are hashed
+// on up to `threads` threads of the shared pool (0 = all of them).
+std::string computeCID(const std::string& filepath, size_t threads = 0);
 
 }  // namespace client
 }  // namespace dfs
@@ -0,0 +1,100 @@
+#include "common/buffer_pool.hpp"
+#include <utility>
+
+namespace dfs {
+namespace common {
+
+BufferPool& BufferPool::shared() {
+    // Never destroyed: detached server threads may still release buffers
+    // while static objects are torn down at exit.
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+BufferPool::BufferPool(size_t budgetBytes) : budget_(budgetBytes) {}
+
+size_t BufferPool::classOf(size_t bytes) {
+    size_t c = 0;
+    while (c + 1 < kClasses && (kMinBuffer << (c + 1)) <= bytes) ++c;
+    return c;
+}
+
+std::vector<uint8_t> BufferPool::acquire(size_t len) {
+    std::vector<uint8_t> buffer;
+    if (len >= kMinBuffer && len <= kMaxBuffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Buffers of len's own class may be too small for it; those of the
+        // next class up all fit.
+        size_t first = classOf(len);
+        for (size_t c = first; c < kClasses && c <= first + 1 && buffer.capacity() == 0; ++c) {
+            std::vector<std::vector<uint8_t>>& list = idle_[c];
+            for (size_t i = list.size(); i-- > 0;) {
+                if (list[i].capacity() < len) continue;
+                std::swap(list[i], list.back());
+                buffer = std::move(list.back());
+                list.pop_back();
+                break;
+            }
+        }
+        if (buffer.capacity() > 0) {
+            stats_.reuses++;
+            stats_.idleBuffers--;
+            stats_.idleBytes -= buffer.capacity();
+        } else {
+            stats_.allocations++;
+        }
+    }
+    if (buffer.capacity() == 0) buffer.reserve(len);
+    // A recycled buffer still has the size it was released with, so only
+    // bytes past that are zero-filled; for same-sized chunks, none.
+    buffer.resize(len);
+    return buffer;
+}
+
+void BufferPool::resize(std::vector<uint8_t>& buffer, size_t len) {
+    if (buffer.capacity() >= len || len < kMinBuffer) {
+        buffer.resize(len);
+        return;
+    }
+    release(std::move(buffer));
+    buffer = acquire(len);
+}
+
+void BufferPool::release(std::vector<uint8_t>&& buffer) {
+    std::vector<uint8_t> freed(std::move(buffer));
+    size_t capacity = freed.capacity();
+    if (capacity < kMinBuffer || capacity >= (kMinBuffer << kClasses)) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stats_.idleBytes + capacity > budget_) {
+        stats_.discarded++;
+        return;
+    }
+    idle_[classOf(capacity)].push_back(std::move(freed));
+    stats_.idleBuffers++;
+    stats_.idleBytes += capacity;
+}
+
+void BufferPool::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    trimLocked(bytes);
+}
+
+void BufferPool::trimLocked(size_t budget) {
+    for (size_t c = kClasses; c-- > 0 && stats_.idleBytes > budget;) {
+        std::vector<std::vector<uint8_t>>& list = idle_[c];
+        while (!list.empty() && stats_.idleBytes > budget) {
+            stats_.idleBuffers--;
+            stats_.idleBytes -= list.back().capacity();
+            list.pop_back();
+        }
+    }
+}
+
+BufferPoolStats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}  // namespace common
+}  // namespace dfs
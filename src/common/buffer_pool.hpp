@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace dfs {
+namespace common {
+
+struct BufferPoolStats {
+    uint64_t allocations{0};  // acquisitions no idle buffer could serve
+    uint64_t reuses{0};       // acquisitions served by an idle buffer
+    uint64_t discarded{0};    // releases freed for lack of budget
+    size_t idleBuffers{0};
+    size_t idleBytes{0};
+};
+
+// Recycles chunk-sized byte buffers, so a frame received, stored and dropped
+// hands its memory to the next one instead of going back to malloc and
+// being zero-filled again. Idle buffers are kept in power-of-two size
+// classes from kMinBuffer to kMaxBuffer, up to a budget of idle bytes;
+// smaller and larger buffers are never pooled. Safe to use from any thread.
+class BufferPool {
+public:
+    static constexpr size_t kMinBuffer = 64 * 1024;
+    static constexpr size_t kMaxBuffer = 64 * 1024 * 1024;
+    static constexpr size_t kDefaultBudget = 64 * 1024 * 1024;
+
+    explicit BufferPool(size_t budgetBytes = kDefaultBudget);
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // A buffer of `len` bytes. A recycled one keeps its old contents, so
+    // callers must overwrite all of it.
+    std::vector<uint8_t> acquire(size_t len);
+    // Sizes `buffer` to `len` bytes like acquire(), keeping it when it is
+    // big enough and otherwise trading it for a pooled one.
+    void resize(std::vector<uint8_t>& buffer, size_t len);
+    // Takes back a buffer its owner is done with.
+    void release(std::vector<uint8_t>&& buffer);
+
+    // 0 turns pooling off. Idle buffers beyond a lowered budget are freed.
+    void setBudget(size_t bytes);
+    BufferPoolStats stats() const;
+
+    // Process-wide pool used by the network and storage layers.
+    static BufferPool& shared();
+
+private:
+    static constexpr size_t kClasses = 11;  // 64KB .. 64MB
+
+    // The class whose buffers all hold at least `bytes`, rounding down.
+    static size_t classOf(size_t bytes);
+    void trimLocked(size_t budget);
+
+    // Buffers of class c have a capacity in [kMinBuffer << c, kMinBuffer << (c + 1)).
+    std::vector<std::vector<uint8_t>> idle_[kClasses];
+    size_t budget_;
+    BufferPoolStats stats_;
+    mutable std::mutex mutex_;
+};
+
+}  // namespace common
+}  // namespace dfs
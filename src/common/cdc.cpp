@@ -0,0 +1,238 @@
+// FastCDC cut-point search. The gear hash is updated as h = (h << 1) +
+// gear[byte], so after 64 bytes earlier input has been shifted out: the hash
+// at any position is a function of the 64 bytes ending there. Both kernels
+// rely on that, warming up from 64 bytes back instead of carrying a hash in,
+// which lets the AVX2 kernel scan four stripes of the buffer at once and
+// still find exactly the scalar kernel's cuts (and the AVX-512 one eight).
+#include "common/cdc.hpp"
+#include "common/sha256_kernels.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace dfs {
+namespace common {
+
+namespace {
+
+constexpr size_t kWindow = 64;
+
+// 256 pseudo-random words from a fixed splitmix64 sequence. Part of the
+// on-disk format: changing the seed moves every cut point.
+constexpr std::array<uint64_t, 256> makeGearTable() {
+    std::array<uint64_t, 256> table{};
+    uint64_t x = 0x6a09e667f3bcc908ull;
+    for (auto& entry : table) {
+        x += 0x9e3779b97f4a7c15ull;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        entry = z ^ (z >> 31);
+    }
+    return table;
+}
+constexpr std::array<uint64_t, 256> kGear = makeGearTable();
+
+// High bits of the hash depend on the most input bytes. The strict mask
+// (log2(avg) + 2 bits) is a superset of the loose one (log2(avg) - 2), so a
+// strict match is always a loose match: the kernels search for loose
+// matches and the few below CDC_AVG_SIZE are then checked against the
+// strict mask.
+constexpr uint64_t topBits(int n) { return ~0ull << (64 - n); }
+constexpr uint64_t kMaskStrict = topBits(22);
+constexpr uint64_t kMaskLoose = topBits(18);
+static_assert(CDC_AVG_SIZE == 1u << 20, "masks assume a 1MB average");
+static_assert(CDC_MIN_SIZE >= kWindow, "the hash window must fit before the first cut");
+
+uint64_t hashAt(const uint8_t* data, size_t pos) {
+    uint64_t h = 0;
+    for (size_t i = pos + 1 - kWindow; i <= pos; ++i) h = (h << 1) + kGear[data[i]];
+    return h;
+}
+
+// First position in [begin, end) whose hash matches `mask`, or `end`.
+// begin must be at least kWindow - 1.
+size_t candidateScalar(const uint8_t* data, size_t begin, size_t end, uint64_t mask) {
+    uint64_t h = 0;
+    for (size_t i = begin + 1 - kWindow; i < begin; ++i) h = (h << 1) + kGear[data[i]];
+    for (size_t pos = begin; pos < end; ++pos) {
+        h = (h << 1) + kGear[data[pos]];
+        if ((h & mask) == 0) return pos;
+    }
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Four lanes hash four consecutive stripes of kStripe bytes in lockstep,
+// each warmed up on the 63 bytes before its stripe. Every lane loads eight
+// input bytes at a time and peels one byte per step off that word to index
+// the gear gather. The lowest lane with a match holds the round's first.
+__attribute__((target("avx2"))) size_t candidateAvx2(const uint8_t* data, size_t begin, size_t end,
+                                                     uint64_t mask) {
+    const size_t kStripe = 2048;
+    const long long* gear = reinterpret_cast<const long long*>(kGear.data());
+    const __m256i maskv = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i byteMask = _mm256_set1_epi64x(0xff);
+    const __m256i zero = _mm256_setzero_si256();
+    auto load8 = [](const uint8_t* p) {
+        long long v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    };
+    size_t base = begin;
+    while (end - base >= 4 * kStripe) {
+        // Lane j starts kWindow bytes before its stripe; its first step adds
+        // a byte that the window has already dropped by the stripe's start.
+        const uint8_t* p0 = data + base - kWindow;
+        const uint8_t* p1 = p0 + kStripe;
+        const uint8_t* p2 = p1 + kStripe;
+        const uint8_t* p3 = p2 + kStripe;
+        __m256i h = zero;
+        unsigned found = 0;
+        size_t hit[4] = {0, 0, 0, 0};
+        for (size_t i = 0; i < kStripe + kWindow && !(found & 1u); i += 8) {
+            __m256i bytes = _mm256_set_epi64x(load8(p3 + i), load8(p2 + i), load8(p1 + i), load8(p0 + i));
+            unsigned match = 0;
+            for (int k = 0; k < 8; ++k) {
+                __m256i idx = _mm256_and_si256(_mm256_srli_epi64(bytes, 8 * k), byteMask);
+                h = _mm256_add_epi64(_mm256_slli_epi64(h, 1), _mm256_i64gather_epi64(gear, idx, 8));
+                if (i < kWindow) continue;
+                unsigned m = static_cast<unsigned>(_mm256_movemask_pd(
+                    _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(h, maskv), zero))));
+                // Record each lane's first match within these eight bytes.
+                for (unsigned fresh = m & ~(found | match); fresh; fresh &= fresh - 1) {
+                    unsigned lane = static_cast<unsigned>(__builtin_ctz(fresh));
+                    hit[lane] = i + k - kWindow;
+                }
+                match |= m;
+            }
+            found |= match;
+        }
+        if (found) {
+            unsigned lane = static_cast<unsigned>(__builtin_ctz(found));
+            return base + lane * kStripe + hit[lane];
+        }
+        base += 4 * kStripe;
+    }
+    return candidateScalar(data, base, end, mask);
+}
+
+// The AVX2 kernel widened to eight lanes; the lanes' input words come from
+// one gather as well. Gathers and shifts use the masked forms with every
+// lane kept: GCC 12's plain ones start from an uninitialized vector and
+// warn -Wmaybe-uninitialized.
+__attribute__((target("avx512f"))) size_t candidateAvx512(const uint8_t* data, size_t begin, size_t end,
+                                                          uint64_t mask) {
+    const size_t kStripe = 2048;
+    const __mmask8 all = 0xFF;
+    const __m512i zero = _mm512_setzero_si512();
+    const long long* gear = reinterpret_cast<const long long*>(kGear.data());
+    const __m512i maskv = _mm512_set1_epi64(static_cast<long long>(mask));
+    const __m512i byteMask = _mm512_set1_epi64(0xff);
+    const __m512i stripes = _mm512_set_epi64(7 * kStripe, 6 * kStripe, 5 * kStripe, 4 * kStripe, 3 * kStripe,
+                                             2 * kStripe, kStripe, 0);
+    size_t base = begin;
+    while (end - base >= 8 * kStripe) {
+        const uint8_t* p0 = data + base - kWindow;
+        __m512i h = _mm512_setzero_si512();
+        unsigned found = 0;
+        size_t hit[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        for (size_t i = 0; i < kStripe + kWindow && !(found & 1u); i += 8) {
+            __m512i bytes = _mm512_mask_i64gather_epi64(zero, all, stripes, p0 + i, 1);
+            unsigned match = 0;
+            for (int k = 0; k < 8; ++k) {
+                __m512i idx = _mm512_and_si512(_mm512_maskz_srli_epi64(all, bytes, 8 * k), byteMask);
+                h = _mm512_add_epi64(_mm512_maskz_slli_epi64(all, h, 1),
+                                     _mm512_mask_i64gather_epi64(zero, all, idx, gear, 8));
+                if (i < kWindow) continue;
+                unsigned m = _mm512_testn_epi64_mask(h, maskv);
+                for (unsigned fresh = m & ~(found | match); fresh; fresh &= fresh - 1) {
+                    hit[__builtin_ctz(fresh)] = i + k - kWindow;
+                }
+                match |= m;
+            }
+            found |= match;
+        }
+        if (found) {
+            unsigned lane = static_cast<unsigned>(__builtin_ctz(found));
+            return base + lane * kStripe + hit[lane];
+        }
+        base += 8 * kStripe;
+    }
+    return candidateAvx2(data, base, end, mask);
+}
+
+#endif
+
+using CandidateFn = size_t (*)(const uint8_t*, size_t, size_t, uint64_t);
+
+CandidateFn candidateFn(CdcKernel kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == CdcKernel::AVX2) return cpuHasAvx2() ? candidateAvx2 : nullptr;
+    if (kernel == CdcKernel::AVX512) return cpuHasAvx512() && cpuHasAvx2() ? candidateAvx512 : nullptr;
+#endif
+    return kernel == CdcKernel::SCALAR ? candidateScalar : nullptr;
+}
+
+}  // namespace
+
+std::vector<CdcKernel> supportedCdcKernels() {
+    std::vector<CdcKernel> kernels{CdcKernel::SCALAR};
+#if defined(__x86_64__) || defined(__i386__)
+    if (cpuHasAvx2()) kernels.push_back(CdcKernel::AVX2);
+    if (cpuHasAvx2() && cpuHasAvx512()) kernels.push_back(CdcKernel::AVX512);
+#endif
+    return kernels;
+}
+
+CdcKernel activeCdcKernel() {
+    static const CdcKernel kernel = supportedCdcKernels().back();
+    return kernel;
+}
+
+const char* cdcKernelName(CdcKernel kernel) {
+    switch (kernel) {
+        case CdcKernel::SCALAR: return "scalar";
+        case CdcKernel::AVX2: return "avx2";
+        case CdcKernel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+size_t cdcFindCut(const uint8_t* data, size_t from, size_t len) {
+    return cdcFindCut(data, from, len, activeCdcKernel());
+}
+
+size_t cdcFindCut(const uint8_t* data, size_t from, size_t len, CdcKernel kernel) {
+    CandidateFn candidate = candidateFn(kernel);
+    if (!candidate) return 0;
+    // A cut after position pos makes a chunk of pos + 1 bytes.
+    size_t pos = from > CDC_MIN_SIZE - 1 ? from : CDC_MIN_SIZE - 1;
+    size_t end = len < CDC_MAX_SIZE ? len : CDC_MAX_SIZE;
+    while (pos < end) {
+        pos = candidate(data, pos, end, kMaskLoose);
+        if (pos == end) break;
+        if (pos + 1 >= CDC_AVG_SIZE || (hashAt(data, pos) & kMaskStrict) == 0) return pos + 1;
+        ++pos;
+    }
+    return len >= CDC_MAX_SIZE ? CDC_MAX_SIZE : 0;
+}
+
+std::vector<size_t> cdcSplit(const uint8_t* data, size_t len, CdcKernel kernel) {
+    std::vector<size_t> lengths;
+    while (len > 0) {
+        size_t cut = cdcFindCut(data, 0, len, kernel);
+        if (cut == 0) cut = len;
+        lengths.push_back(cut);
+        data += cut;
+        len -= cut;
+    }
+    return lengths;
+}
+
+}  // namespace common
+}  // namespace dfs
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dfs {
+namespace common {
+
+// Content-defined chunking (FastCDC with normalized chunking): a cut falls
+// where a gear rolling hash over the preceding 64 bytes matches a mask, so
+// an insertion or deletion only changes the chunks around it. Chunks are
+// CDC_MIN_SIZE to CDC_MAX_SIZE bytes; below CDC_AVG_SIZE a stricter mask
+// applies and above it a looser one, which keeps lengths close to the
+// average. Cut points depend only on file content and these constants, so
+// they must never change once files have been stored with them.
+constexpr size_t CDC_MIN_SIZE = 256 * 1024;
+constexpr size_t CDC_AVG_SIZE = 1024 * 1024;
+constexpr size_t CDC_MAX_SIZE = 4 * 1024 * 1024;
+
+// Cut-point search kernels. cdcFindCut() uses the fastest one the CPU
+// supports; all of them find the same cuts.
+enum class CdcKernel { SCALAR, AVX2, AVX512 };
+
+// Kernels this CPU can run, slowest first; the last one is the active kernel.
+std::vector<CdcKernel> supportedCdcKernels();
+CdcKernel activeCdcKernel();
+const char* cdcKernelName(CdcKernel kernel);
+
+// Length of the chunk that starts at data[0], given its first `len` bytes
+// and that none of the first `from` bytes were a cut (so a caller reading
+// incrementally only scans the new bytes). Returns 0 if the cut lies beyond
+// `len`; the caller supplies more bytes, or at end of file takes all `len`.
+size_t cdcFindCut(const uint8_t* data, size_t from, size_t len);
+size_t cdcFindCut(const uint8_t* data, size_t from, size_t len, CdcKernel kernel);
+
+// Chunk lengths of an in-memory buffer, for tests and benchmarks.
+std::vector<size_t> cdcSplit(const uint8_t* data, size_t len, CdcKernel kernel = activeCdcKernel());
+
+}  // namespace common
+}  // namespace dfs
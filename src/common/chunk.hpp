@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common/digest.hpp"
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -9,7 +10,7 @@ namespace common {
 
 struct Chunk {
     int index{0};
-    std::string hash;
+    Digest hash;
     std::vector<uint8_t> data;
     int size{0};
 
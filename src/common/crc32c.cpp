@@ -0,0 +1,60 @@
+#include "common/crc32c.hpp"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace dfs {
+namespace common {
+
+namespace {
+
+const uint32_t kPolynomial = 0x82f63b78;  // Castagnoli, reflected
+
+struct Crc32cTable {
+    uint32_t entries[256];
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+            entries[i] = crc;
+        }
+    }
+};
+
+uint32_t crc32cPortable(const uint8_t* data, size_t len, uint32_t crc) {
+    static const Crc32cTable table;
+    for (size_t i = 0; i < len; ++i) crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t crc32cSse42(const uint8_t* data, size_t len, uint32_t crc) {
+    uint64_t crc64 = crc;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; len > 0; --len, ++data) crc = _mm_crc32_u8(crc, *data);
+    return crc;
+}
+#endif
+
+}  // namespace
+
+uint32_t crc32c(const uint8_t* data, size_t len, uint32_t crc) {
+    crc = ~crc;
+#if defined(__x86_64__)
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    crc = sse42 ? crc32cSse42(data, len, crc) : crc32cPortable(data, len, crc);
+#else
+    crc = crc32cPortable(data, len, crc);
+#endif
+    return ~crc;
+}
+
+}  // namespace common
+}  // namespace dfs
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dfs {
+namespace common {
+
+// CRC-32C (Castagnoli), as used for on-disk record checksums. Pass the
+// previous result as `crc` to checksum a record in pieces. Uses the SSE4.2
+// crc32 instruction when the CPU has it.
+uint32_t crc32c(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+}  // namespace common
+}  // namespace dfs
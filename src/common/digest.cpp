@@ -0,0 +1,41 @@
+#include "common/digest.hpp"
+
+namespace dfs {
+namespace common {
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string Digest::toHex() const {
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string hex(kSize * 2, '0');
+    for (size_t i = 0; i < kSize; ++i) {
+        hex[i * 2] = hexDigits[bytes[i] >> 4];
+        hex[i * 2 + 1] = hexDigits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+bool Digest::fromHex(const std::string& hex, Digest& out) {
+    if (hex.size() != kSize * 2) return false;
+    Digest parsed;
+    for (size_t i = 0; i < kSize; ++i) {
+        int hi = hexValue(hex[i * 2]);
+        int lo = hexValue(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) return false;
+        parsed.bytes[i] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    out = parsed;
+    return true;
+}
+
+std::ostream& operator<<(std::ostream& os, const Digest& digest) {
+    return os << digest.toHex();
+}
+
+}  // namespace common
+}  // namespace dfs
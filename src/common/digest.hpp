@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace dfs {
+namespace common {
+
+// A SHA-256 digest as a 32-byte value. Chunk names, metadata and storage keys
+// carry it directly; hex only appears on the text protocol, in logs and in
+// the CLI, through toHex()/fromHex().
+struct Digest {
+    static constexpr size_t kSize = 32;
+    std::array<uint8_t, kSize> bytes{};
+
+    // 64 lowercase hex characters.
+    std::string toHex() const;
+    // Parses 64 hex characters (either case); false leaves `out` untouched.
+    static bool fromHex(const std::string& hex, Digest& out);
+    bool isZero() const { return *this == Digest(); }
+
+    friend bool operator==(const Digest& a, const Digest& b) {
+        return std::memcmp(a.bytes.data(), b.bytes.data(), kSize) == 0;
+    }
+    friend bool operator!=(const Digest& a, const Digest& b) { return !(a == b); }
+    friend bool operator<(const Digest& a, const Digest& b) {
+        return std::memcmp(a.bytes.data(), b.bytes.data(), kSize) < 0;
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const Digest& digest);
+
+}  // namespace common
+}  // namespace dfs
+
+namespace std {
+// The digest is already uniformly distributed, so its first word is the hash.
+template <>
+struct hash<dfs::common::Digest> {
+    size_t operator()(const dfs::common::Digest& digest) const {
+        size_t h;
+        std::memcpy(&h, digest.bytes.data(), sizeof(h));
+        return h;
+    }
+};
+}  // namespace std
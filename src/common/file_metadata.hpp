@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common/digest.hpp"
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -9,11 +10,12 @@ namespace common {
 
 struct FileMetadata {
     std::string filename;
-    std::string rootHash;
+    Digest rootHash;
     int64_t fileSize{0};
-    int chunkSize{0};
+    int chunkSize{0};  // 0: content-defined chunks, lengths in chunkSizes
     int totalChunks{0};
-    std::vector<std::string> chunkHashes;
+    std::vector<Digest> chunkHashes;
+    std::vector<uint32_t> chunkSizes;  // empty: every chunk but the last is chunkSize
 };
 
 }  // namespace common
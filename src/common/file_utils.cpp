@@ -1,63 +1,170 @@
 #include "common/file_utils.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/cdc.hpp"
 #include <algorithm>
-#include <fstream>
+#include <cerrno>
+#include <fcntl.h>
 #include <iostream>
+#include <unistd.h>
 
 namespace dfs {
 namespace common {
 
-std::vector<Chunk> splitFileIntoChunks(const std::string& filepath) {
-    std::vector<Chunk> chunks;
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) {
+// Small enough that a slice is still in L2 when it is hashed.
+static const size_t kReadSlice = 64 * 1024;
+
+ChunkReader::ChunkReader(const std::string& filepath, size_t bufferCount, bool hashWhileReading,
+                         Chunking chunking)
+    : file_(filepath, std::ios::binary),
+      bufferCount_(bufferCount == 0 ? 1 : bufferCount),
+      hashWhileReading_(hashWhileReading),
+      chunking_(chunking) {
+    if (!file_) {
         std::cerr << "Error, file cannot be opened " << filepath << std::endl;
-        return chunks;
+        return;
     }
+    file_.seekg(0, std::ios::end);
+    fileSize_ = static_cast<int64_t>(file_.tellg());
+    file_.seekg(0, std::ios::beg);
+}
+
+ChunkReader::~ChunkReader() {
+    for (auto& buffer : freeBuffers_) BufferPool::shared().release(std::move(buffer));
+}
 
-    std::vector<uint8_t> buffer(CHUNK_SIZE);
-    int index = 0;
+bool ChunkReader::next(Chunk& chunk) {
+    if (file_.is_open() && file_.eof() && carry_.empty()) file_.close();
+    if (!file_.is_open()) return false;
 
-    while (file.read(reinterpret_cast<char*>(buffer.data()), CHUNK_SIZE) || file.gcount() > 0) {
-        std::streamsize bytesRead = file.gcount();
-        if (bytesRead > 0) {
-            Chunk chunk;
-            chunk.index = index++;
-            chunk.size = static_cast<int>(bytesRead);
-            chunk.data.assign(buffer.begin(), buffer.begin() + bytesRead);
-            chunks.push_back(std::move(chunk));
+    std::vector<uint8_t> buffer;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return !freeBuffers_.empty() || buffersCreated_ < bufferCount_; });
+        if (!freeBuffers_.empty()) {
+            buffer = std::move(freeBuffers_.back());
+            freeBuffers_.pop_back();
+        } else {
+            buffersCreated_++;
         }
     }
-    return chunks;
-}
-
-bool reconstructFile(const std::vector<Chunk>& chunks, const std::string& outputPath) {
-    if (chunks.empty()) {
-        std::cerr << "Empty chunks. Can't reconstruct." << std::endl;
+    size_t bytesRead = 0;
+    if (chunking_ == Chunking::CONTENT_DEFINED) {
+        bytesRead = readContentDefined(buffer);
+    } else {
+        // Chunks end at the size the file had when opened, which is the size
+        // its metadata records; small files take small buffers.
+        int64_t left = fileSize_ - static_cast<int64_t>(nextIndex_) * CHUNK_SIZE;
+        left = std::max<int64_t>(0, std::min<int64_t>(left, CHUNK_SIZE));
+        BufferPool::shared().resize(buffer, static_cast<size_t>(left));
+        while (bytesRead < buffer.size()) {
+            size_t want =
+                hashWhileReading_ ? std::min(kReadSlice, buffer.size() - bytesRead) : buffer.size() - bytesRead;
+            file_.read(reinterpret_cast<char*>(buffer.data() + bytesRead), static_cast<std::streamsize>(want));
+            size_t got = static_cast<size_t>(file_.gcount());
+            if (hashWhileReading_) hasher_.update(buffer.data() + bytesRead, got);
+            bytesRead += got;
+            if (got < want) break;
+        }
+    }
+    if (bytesRead == 0) {
+        file_.close();
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeBuffers_.push_back(std::move(buffer));
+        cv_.notify_one();
         return false;
     }
+    buffer.resize(bytesRead);
+    chunk.index = nextIndex_++;
+    chunk.size = static_cast<int>(bytesRead);
+    chunk.hash = hashWhileReading_ ? hasher_.final() : Digest();
+    chunk.data = std::move(buffer);
+    return true;
+}
 
-    std::vector<Chunk> sortedChunks = chunks;
-    std::sort(sortedChunks.begin(), sortedChunks.end(),
-              [](const Chunk& a, const Chunk& b) { return a.index < b.index; });
-
-    for (size_t i = 0; i < sortedChunks.size(); ++i) {
-        if (sortedChunks[i].index != static_cast<int>(i)) {
-            std::cerr << "Error: missing chunk " << i << std::endl;
-            return false;
+size_t ChunkReader::readContentDefined(std::vector<uint8_t>& buffer) {
+    BufferPool::shared().resize(buffer, CDC_MAX_SIZE);
+    size_t bytesRead = carry_.size();
+    std::copy(carry_.begin(), carry_.end(), buffer.begin());
+    carry_.clear();
+    // Bytes before `scanned` hold no cut, so they belong to this chunk and
+    // can be hashed before the cut is known.
+    size_t scanned = 0;
+    size_t cut = 0;
+    while (true) {
+        if (bytesRead > scanned) {
+            cut = cdcFindCut(buffer.data(), scanned, bytesRead);
+            if (cut > 0) break;
+            if (hashWhileReading_) hasher_.update(buffer.data() + scanned, bytesRead - scanned);
+            scanned = bytesRead;
         }
+        if (file_.eof()) break;
+        size_t want = std::min(kReadSlice, buffer.size() - bytesRead);
+        file_.read(reinterpret_cast<char*>(buffer.data() + bytesRead), static_cast<std::streamsize>(want));
+        bytesRead += static_cast<size_t>(file_.gcount());
     }
+    if (cut == 0) cut = bytesRead;
+    if (hashWhileReading_ && cut > scanned) hasher_.update(buffer.data() + scanned, cut - scanned);
+    carry_.assign(buffer.begin() + static_cast<std::ptrdiff_t>(cut),
+                  buffer.begin() + static_cast<std::ptrdiff_t>(bytesRead));
+    return cut;
+}
 
-    std::ofstream out(outputPath, std::ios::binary);
-    if (!out) {
+void ChunkReader::recycle(Chunk& chunk) {
+    if (chunk.data.capacity() == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeBuffers_.push_back(std::move(chunk.data));
+    }
+    chunk.data.clear();
+    cv_.notify_one();
+}
+
+ChunkWriter::ChunkWriter(const std::string& outputPath, int64_t fileSize, int chunkSize)
+    : fileSize_(fileSize), chunkSize_(chunkSize) {
+    fd_ = ::open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
         std::cerr << "Error: file could not be created " << outputPath << std::endl;
-        return false;
+        return;
+    }
+    if (fileSize_ > 0 && fallocate(fd_, 0, 0, fileSize_) != 0 && ftruncate(fd_, fileSize_) != 0) {
+        std::cerr << "Error: could not size " << outputPath << " to " << fileSize_ << " bytes" << std::endl;
+        ::close(fd_);
+        fd_ = -1;
     }
+}
+
+ChunkWriter::~ChunkWriter() {
+    close();
+}
 
-    for (const auto& chunk : sortedChunks) {
-        out.write(reinterpret_cast<const char*>(chunk.data.data()), chunk.size);
+bool ChunkWriter::write(int index, const uint8_t* data, size_t len) {
+    if (index < 0) return false;
+    return writeAt(static_cast<int64_t>(index) * chunkSize_, data, len);
+}
+
+bool ChunkWriter::writeAt(int64_t start, const uint8_t* data, size_t len) {
+    if (fd_ < 0 || start < 0) return false;
+    off_t offset = static_cast<off_t>(start);
+    if (offset + static_cast<off_t>(len) > fileSize_) return false;
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd_, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += n;
     }
     return true;
 }
 
+bool ChunkWriter::close() {
+    if (fd_ < 0) return false;
+    int rc = ::close(fd_);
+    fd_ = -1;
+    return rc == 0;
+}
+
 }  // namespace common
 }  // namespace dfs
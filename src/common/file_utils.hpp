@@ -1,6 +1,11 @@
 #pragma once
 
 #include "common/chunk.hpp"
+#include "common/sha256.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -9,8 +14,73 @@ namespace common {
 
 constexpr int CHUNK_SIZE = 1048576;  // 1MB
 
-std::vector<Chunk> splitFileIntoChunks(const std::string& filepath);
-bool reconstructFile(const std::vector<Chunk>& chunks, const std::string& outputPath);
+// How a file is cut into chunks: at every CHUNK_SIZE bytes, or at content-
+// defined cut points (see common/cdc.hpp).
+enum class Chunking { FIXED, CONTENT_DEFINED };
+
+// Streams a file as chunks backed by a fixed set of reusable buffers, so
+// memory stays at bufferCount x the largest chunk whatever the file size.
+// The buffers come from BufferPool::shared() and go back to it at the end.
+// next() is called by one producer; recycle() may be called from any thread.
+// With hashWhileReading, each chunk is read in cache-sized slices that are
+// hashed as they land, and next() returns it with chunk.hash already set.
+class ChunkReader {
+public:
+    explicit ChunkReader(const std::string& filepath, size_t bufferCount = 2, bool hashWhileReading = false,
+                         Chunking chunking = Chunking::FIXED);
+    ~ChunkReader();
+    ChunkReader(const ChunkReader&) = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    bool isOpen() const { return file_.is_open(); }
+    int64_t fileSize() const { return fileSize_; }
+    // Reads the next chunk into a pooled buffer, waiting for one to be recycled
+    // if all are in use. Returns false at end of file, and closes the file,
+    // though chunks still out keep their buffers until recycled.
+    bool next(Chunk& chunk);
+    // Hands the chunk's buffer back to the pool.
+    void recycle(Chunk& chunk);
+
+private:
+    // Fills `buffer` up to the next cut point; bytes read past it are kept
+    // in carry_ for the next chunk.
+    size_t readContentDefined(std::vector<uint8_t>& buffer);
+
+    std::ifstream file_;
+    int64_t fileSize_{0};
+    int nextIndex_{0};
+    size_t bufferCount_;
+    bool hashWhileReading_;
+    Chunking chunking_;
+    std::vector<uint8_t> carry_;
+    Sha256 hasher_;
+    size_t buffersCreated_{0};
+    std::vector<std::vector<uint8_t>> freeBuffers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// Writes chunks straight to their offset (index x chunkSize) in an output file
+// that is sized up front, so chunks may arrive in any order and from any
+// thread without being buffered or sorted.
+class ChunkWriter {
+public:
+    ChunkWriter(const std::string& outputPath, int64_t fileSize, int chunkSize = CHUNK_SIZE);
+    ~ChunkWriter();
+    ChunkWriter(const ChunkWriter&) = delete;
+    ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+    bool isOpen() const { return fd_ >= 0; }
+    bool write(int index, const uint8_t* data, size_t len);
+    // For chunks of varying length, whose offsets the caller knows.
+    bool writeAt(int64_t offset, const uint8_t* data, size_t len);
+    bool close();
+
+private:
+    int fd_{-1};
+    int64_t fileSize_;
+    int chunkSize_;
+};
 
 }  // namespace common
 }  // namespace dfs
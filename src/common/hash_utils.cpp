@@ -1,34 +1,54 @@
 #include "common/hash_utils.hpp"
 #include "common/sha256.hpp"
+#include "common/thread_pool.hpp"
+#include <algorithm>
+#include <map>
 
 namespace dfs {
 namespace common {
 
-std::string computeSHA256(const uint8_t* data, size_t len) {
+Digest computeSHA256(const uint8_t* data, size_t len) {
     return sha256(data, len);
 }
 
-std::string computeSHA256(const std::vector<uint8_t>& data) {
+Digest computeSHA256(const std::vector<uint8_t>& data) {
     return sha256(data);
 }
 
 void hashChunk(Chunk& chunk) {
-    std::vector<uint8_t> validData(chunk.data.begin(), chunk.data.begin() + chunk.size);
-    chunk.hash = computeSHA256(validData);
+    chunk.hash = computeSHA256(chunk.data.data(), static_cast<size_t>(chunk.size));
 }
 
-void hashAllChunks(std::vector<Chunk>& chunks) {
-    for (auto& chunk : chunks) {
-        hashChunk(chunk);
+void hashChunks(Chunk* chunks, size_t count, size_t maxThreads) {
+    // Equal-sized chunks (all but a short last one) are split into batches of
+    // one chunk per multi-buffer lane; batches are hashed on the shared pool.
+    std::map<int, std::vector<Chunk*>> bySize;
+    for (size_t i = 0; i < count; ++i) bySize[chunks[i].size].push_back(&chunks[i]);
+    const size_t lanes = sha256BatchLanes();
+    std::vector<std::vector<Chunk*>> batches;
+    for (const auto& group : bySize) {
+        for (size_t start = 0; start < group.second.size(); start += lanes) {
+            size_t end = std::min(group.second.size(), start + lanes);
+            batches.emplace_back(group.second.begin() + start, group.second.begin() + end);
+        }
     }
+    ThreadPool::shared().parallelFor(batches.size(), [&batches](size_t b) {
+        const std::vector<Chunk*>& batch = batches[b];
+        std::vector<const uint8_t*> buffers;
+        for (const Chunk* chunk : batch) buffers.push_back(chunk->data.data());
+        std::vector<Digest> hashes = sha256Batch(buffers, static_cast<size_t>(batch.front()->size));
+        for (size_t i = 0; i < hashes.size(); ++i) batch[i]->hash = hashes[i];
+    }, maxThreads);
 }
 
-std::string computeRootHash(const std::vector<std::string>& chunkHashes) {
-    std::string combined;
-    for (const auto& h : chunkHashes) {
-        combined += h;
-    }
-    return computeSHA256(reinterpret_cast<const uint8_t*>(combined.data()), combined.size());
+void hashAllChunks(std::vector<Chunk>& chunks) {
+    hashChunks(chunks.data(), chunks.size());
+}
+
+Digest computeRootHash(const std::vector<Digest>& chunkHashes) {
+    Sha256 hasher;
+    for (const auto& h : chunkHashes) hasher.update(h);
+    return hasher.final();
 }
 
 }  // namespace common
@@ -1,17 +1,22 @@
 #pragma once
 
 #include "common/chunk.hpp"
-#include <string>
+#include "common/digest.hpp"
 #include <vector>
 
 namespace dfs {
 namespace common {
 
-std::string computeSHA256(const uint8_t* data, size_t len);
-std::string computeSHA256(const std::vector<uint8_t>& data);
+Digest computeSHA256(const uint8_t* data, size_t len);
+Digest computeSHA256(const std::vector<uint8_t>& data);
 void hashChunk(Chunk& chunk);
+// Hashes several chunks at once on ThreadPool::shared(), using at most
+// maxThreads threads (0 = the whole pool) and the multi-buffer SHA-256
+// kernel when the CPU has one.
+void hashChunks(Chunk* chunks, size_t count, size_t maxThreads = 0);
 void hashAllChunks(std::vector<Chunk>& chunks);
-std::string computeRootHash(const std::vector<std::string>& chunkHashes);
+// SHA-256 over the concatenated binary chunk digests.
+Digest computeRootHash(const std::vector<Digest>& chunkHashes);
 
 }  // namespace common
 }  // namespace dfs
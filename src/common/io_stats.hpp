@@ -0,0 +1,23 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dfs {
+namespace common {
+
+// Process-wide count of the I/O system calls the servers and chunk stores
+// make, so benchmarks can report syscalls per chunk. Relaxed: it is only
+// ever read as a difference across a finished run.
+inline std::atomic<uint64_t> ioSyscalls{0};
+
+inline void countSyscalls(uint64_t n = 1) {
+    ioSyscalls.fetch_add(n, std::memory_order_relaxed);
+}
+
+inline uint64_t syscallCount() {
+    return ioSyscalls.load(std::memory_order_relaxed);
+}
+
+}  // namespace common
+}  // namespace dfs
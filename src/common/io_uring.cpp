@@ -0,0 +1,162 @@
+#include "common/io_uring.hpp"
+#include "common/io_stats.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dfs {
+namespace common {
+
+namespace {
+
+// How long an idle SQPOLL thread spins before it sleeps and needs a wakeup.
+constexpr unsigned kSqThreadIdleMs = 50;
+
+}  // namespace
+
+IoUring::~IoUring() {
+    if (sqes_) ::munmap(sqes_, sqesSize_);
+    if (cqRing_ && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+    if (sqRing_) ::munmap(sqRing_, sqRingSize_);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool IoUring::supported() {
+    static const bool available = []() {
+        IoUring ring;
+        return ring.init(2);
+    }();
+    return available;
+}
+
+bool IoUring::init(unsigned entries, bool sqpoll) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    if (sqpoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = kSqThreadIdleMs;
+    }
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) return false;
+    fd_ = fd;
+    sqpoll_ = sqpoll;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) sqRingSize_ = cqRingSize_ = sqRingSize_ > cqRingSize_ ? sqRingSize_ : cqRingSize_;
+
+    void* sq = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) return false;
+    sqRing_ = sq;
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        void* cq = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) return false;
+        cqRing_ = cq;
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                        IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    uint8_t* sqBase = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+    sqFlags_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.flags);
+    sqMask_ = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    // Submission slot i always holds entry i, so submitting is just moving
+    // the tail.
+    unsigned* array = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; ++i) array[i] = i;
+    sqeTail_ = sqeSubmitted_ = *sqTail_;
+
+    uint8_t* cqBase = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cqBase + params.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::registerBuffers(const struct iovec* buffers, unsigned count) {
+    countSyscalls();
+    return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+bool IoUring::registerFiles(const int* fds, unsigned count) {
+    countSyscalls();
+    return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES, fds, count) == 0;
+}
+
+bool IoUring::updateFile(unsigned slot, int fd) {
+    struct io_uring_files_update update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds = reinterpret_cast<uint64_t>(&fd);
+    countSyscalls();
+    return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+struct io_uring_sqe* IoUring::prepare(uint8_t opcode, int fd, const void* addr, uint32_t len, uint64_t offset,
+                                      uint64_t userData) {
+    while (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        // Full: hand the queue to the kernel, and with SQPOLL wait for its
+        // thread to make room.
+        if (submit() < 0) return nullptr;
+        if (sqpoll_ && sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_ &&
+            enter(0, 0, IORING_ENTER_SQ_WAIT) < 0) {
+            return nullptr;
+        }
+        if (!sqpoll_ && sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) return nullptr;
+    }
+    struct io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    ++sqeTail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(addr);
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = userData;
+    return sqe;
+}
+
+int IoUring::submit(unsigned waitFor) {
+    bool published = sqeTail_ != sqeSubmitted_;
+    if (published) {
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+        sqeSubmitted_ = sqeTail_;
+    }
+    unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+    if (sqpoll_) {
+        // The kernel thread picks the entries up by itself unless it slept.
+        if (published && (__atomic_load_n(sqFlags_, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        if (flags == 0) return 0;
+        int ret = enter(0, waitFor, flags);
+        return ret < 0 ? ret : 0;
+    }
+    // Counted from the kernel's head, so entries an interrupted enter left
+    // behind go along with this one.
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0 && waitFor == 0) return 0;
+    return enter(toSubmit, waitFor, flags);
+}
+
+int IoUring::enter(unsigned toSubmit, unsigned waitFor, unsigned flags) {
+    countSyscalls();
+    int ret = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, toSubmit, waitFor, flags, nullptr, 0));
+    return ret < 0 ? -errno : ret;
+}
+
+}  // namespace common
+}  // namespace dfs
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+namespace dfs {
+namespace common {
+
+// How the servers and chunk stores issue their I/O: one system call per
+// operation, or batched through an io_uring.
+enum class IoBackend { POSIX, URING };
+
+// Minimal io_uring driven through the raw system calls, so no liburing is
+// needed. Only one thread at a time may prepare, submit or reap.
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // With sqpoll, a kernel thread polls the submission queue and most
+    // submits need no system call at all.
+    bool init(unsigned entries, bool sqpoll = false);
+    bool isOpen() const { return fd_ >= 0; }
+    bool sqpoll() const { return sqpoll_; }
+    // Whether this kernel lets the process create a ring; probed once.
+    static bool supported();
+
+    bool registerBuffers(const struct iovec* buffers, unsigned count);
+    // Entries of -1 leave a slot empty for updateFile() to fill later.
+    bool registerFiles(const int* fds, unsigned count);
+    bool updateFile(unsigned slot, int fd);
+
+    // Next submission entry with the common fields filled in, or nullptr if
+    // the queue is full even after submitting what it holds. Callers set
+    // any op-specific fields (flags, buf_index, msg_flags...) themselves.
+    struct io_uring_sqe* prepare(uint8_t opcode, int fd, const void* addr, uint32_t len, uint64_t offset,
+                                 uint64_t userData);
+    // Hands prepared entries to the kernel and, with waitFor > 0, blocks
+    // until that many completions are ready. Returns the number submitted
+    // (0 under SQPOLL, where the kernel thread submits) or -errno.
+    int submit(unsigned waitFor = 0);
+    // Whether completions are waiting to be reaped.
+    bool ready() const { return *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE); }
+
+    // Calls fn(userData, res, flags) for every completion ready, including
+    // ones that arrive while it runs, and returns how many there were.
+    template <typename F>
+    unsigned reap(F&& fn) {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        while (head != tail) {
+            const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+            fn(cqe.user_data, cqe.res, cqe.flags);
+            ++head;
+            ++count;
+            // Published per entry so the slot is free before fn's own submits.
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+            tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        }
+        return count;
+    }
+
+private:
+    int enter(unsigned toSubmit, unsigned waitFor, unsigned flags);
+
+    int fd_{-1};
+    bool sqpoll_{false};
+    void* sqRing_{nullptr};
+    size_t sqRingSize_{0};
+    void* cqRing_{nullptr};
+    size_t cqRingSize_{0};
+    struct io_uring_sqe* sqes_{nullptr};
+    size_t sqesSize_{0};
+
+    unsigned* sqHead_{nullptr};
+    unsigned* sqTail_{nullptr};
+    unsigned* sqFlags_{nullptr};
+    unsigned sqMask_{0};
+    unsigned sqEntries_{0};
+    unsigned sqeTail_{0};       // entries handed out by prepare()
+    unsigned sqeSubmitted_{0};  // entries published to the kernel
+
+    unsigned* cqHead_{nullptr};
+    unsigned* cqTail_{nullptr};
+    unsigned cqMask_{0};
+    struct io_uring_cqe* cqes_{nullptr};
+};
+
+}  // namespace common
+}  // namespace dfs
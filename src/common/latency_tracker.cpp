@@ -0,0 +1,40 @@
+#include "common/latency_tracker.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace dfs {
+namespace common {
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    p = std::min(100.0, std::max(0.0, p));
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    size_t index = rank == 0 ? 0 : rank - 1;
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+LatencyTracker::LatencyTracker(size_t capacity) : capacity_(capacity == 0 ? 1 : capacity) {}
+
+void LatencyTracker::record(double ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.size() == capacity_) samples_.pop_front();
+    samples_.push_back(ms);
+}
+
+size_t LatencyTracker::count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.size();
+}
+
+double LatencyTracker::percentile(double p) const {
+    std::vector<double> copy;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        copy.assign(samples_.begin(), samples_.end());
+    }
+    return common::percentile(std::move(copy), p);
+}
+
+}  // namespace common
+}  // namespace dfs
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace dfs {
+namespace common {
+
+// Nearest-rank percentile (p in [0, 100]) of a set of samples; 0 when empty.
+double percentile(std::vector<double> samples, double p);
+
+// Rolling window of the most recent latency samples, in milliseconds.
+// Safe to record from and query on any thread.
+class LatencyTracker {
+public:
+    explicit LatencyTracker(size_t capacity = 512);
+
+    void record(double ms);
+    size_t count() const;
+    double percentile(double p) const;
+
+private:
+    const size_t capacity_;
+    std::deque<double> samples_;
+    mutable std::mutex mutex_;
+};
+
+}  // namespace common
+}  // namespace dfs
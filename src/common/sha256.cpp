@@ -1,13 +1,15 @@
 // Minimal SHA-256 implementation (public domain style). No external crypto lib required.
+// The portable kernel lives here; SIMD and SHA-extension kernels are in
+// sha256_x86.cpp and sha256_arm.cpp and are picked at runtime.
 #include "common/sha256.hpp"
-#include <sstream>
-#include <iomanip>
+#include "common/sha256_kernels.hpp"
+#include <algorithm>
 #include <cstring>
 
 namespace dfs {
 namespace common {
 
-static const uint32_t k[64] = {
+const uint32_t kSha256RoundConstants[64] = {
     0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
     0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
     0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
@@ -26,21 +28,11 @@ static inline uint32_t sig1(uint32_t x) { return rotr(x, 6) ^ rotr(x, 11) ^ rotr
 static inline uint32_t gam0(uint32_t x) { return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3); }
 static inline uint32_t gam1(uint32_t x) { return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10); }
 
-static void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
-    uint32_t w[64];
-    for (int i = 0; i < 16; ++i) {
-        w[i] = (static_cast<uint32_t>(block[i*4]) << 24) |
-               (static_cast<uint32_t>(block[i*4+1]) << 16) |
-               (static_cast<uint32_t>(block[i*4+2]) << 8) |
-               static_cast<uint32_t>(block[i*4+3]);
-    }
-    for (int i = 16; i < 64; ++i) {
-        w[i] = gam1(w[i-2]) + w[i-7] + gam0(w[i-15]) + w[i-16];
-    }
+void sha256Rounds(uint32_t state[8], const uint32_t wk[64]) {
     uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
              e = state[4], f = state[5], g = state[6], h = state[7];
     for (int i = 0; i < 64; ++i) {
-        uint32_t t1 = h + sig1(e) + ch(e, f, g) + k[i] + w[i];
+        uint32_t t1 = h + sig1(e) + ch(e, f, g) + wk[i];
         uint32_t t2 = sig0(a) + maj(a, b, c);
         h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
     }
@@ -48,47 +40,236 @@ static void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
     state[4] += e; state[5] += f; state[6] += g; state[7] += h;
 }
 
-std::string sha256(const uint8_t* data, size_t len) {
-    uint32_t state[8] = {
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-    };
-    uint8_t block[64];
-    size_t i = 0;
-    while (i + 64 <= len) {
-        memcpy(block, data + i, 64);
-        sha256_transform(state, block);
-        i += 64;
+void sha256BlocksScalar(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32_t w[64];
+    for (; blocks > 0; --blocks, data += 64) {
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (static_cast<uint32_t>(data[i*4]) << 24) |
+                   (static_cast<uint32_t>(data[i*4+1]) << 16) |
+                   (static_cast<uint32_t>(data[i*4+2]) << 8) |
+                   static_cast<uint32_t>(data[i*4+3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            w[i] = gam1(w[i-2]) + w[i-7] + gam0(w[i-15]) + w[i-16];
+        }
+        for (int i = 0; i < 64; ++i) w[i] += kSha256RoundConstants[i];
+        sha256Rounds(state, w);
     }
-    size_t rem = len - i;
-    memcpy(block, data + i, rem);
-    block[rem++] = 0x80;
-    if (rem > 56) {
-        while (rem < 64) block[rem++] = 0;
-        sha256_transform(state, block);
-        rem = 0;
+}
+
+static Sha256BlockFn kernelFunction(Sha256Kernel kernel) {
+    switch (kernel) {
+        case Sha256Kernel::SCALAR: return sha256BlocksScalar;
+#if defined(__x86_64__) || defined(__i386__)
+        case Sha256Kernel::SSSE3: return cpuHasSsse3() ? sha256BlocksSsse3 : nullptr;
+        case Sha256Kernel::AVX2: return cpuHasAvx2() ? sha256BlocksAvx2 : nullptr;
+        case Sha256Kernel::SHA_NI: return cpuHasShaNi() ? sha256BlocksShaNi : nullptr;
+#endif
+#if defined(__aarch64__)
+        case Sha256Kernel::ARMV8_CE: return cpuHasArmv8Sha2() ? sha256BlocksArmv8 : nullptr;
+#endif
+        default: return nullptr;
     }
-    while (rem < 56) block[rem++] = 0;
-    uint64_t bitLen = len * 8ULL;
-    for (int j = 7; j >= 0; --j) {
-        block[56 + j] = static_cast<uint8_t>(bitLen);
-        bitLen >>= 8;
+}
+
+std::vector<Sha256Kernel> supportedSha256Kernels() {
+    std::vector<Sha256Kernel> kernels;
+    for (Sha256Kernel kernel : {Sha256Kernel::SCALAR, Sha256Kernel::SSSE3, Sha256Kernel::AVX2,
+                                Sha256Kernel::SHA_NI, Sha256Kernel::ARMV8_CE}) {
+        if (kernelFunction(kernel)) kernels.push_back(kernel);
+    }
+    return kernels;
+}
+
+Sha256Kernel activeSha256Kernel() {
+    static const Sha256Kernel active = supportedSha256Kernels().back();
+    return active;
+}
+
+const char* sha256KernelName(Sha256Kernel kernel) {
+    switch (kernel) {
+        case Sha256Kernel::SCALAR: return "scalar";
+        case Sha256Kernel::SSSE3: return "ssse3";
+        case Sha256Kernel::AVX2: return "avx2";
+        case Sha256Kernel::SHA_NI: return "sha-ni";
+        case Sha256Kernel::ARMV8_CE: return "armv8-ce";
     }
-    sha256_transform(state, block);
+    return "unknown";
+}
 
-    std::ostringstream oss;
+static const uint32_t kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// Copies the `rem` (< 64) message bytes left after the last whole block into
+// `tail`, followed by the padding and the bit length of the whole `len`-byte
+// message; returns how many 64-byte blocks (1 or 2) that takes.
+static size_t padTail(const uint8_t* rest, size_t rem, uint64_t len, uint8_t tail[128]) {
+    memset(tail, 0, 128);
+    if (rem > 0) memcpy(tail, rest, rem);
+    tail[rem] = 0x80;
+    size_t tailBlocks = rem + 1 > 56 ? 2 : 1;
+    uint64_t bitLen = len * 8ULL;
     for (int j = 0; j < 8; ++j) {
-        uint32_t v = state[j];
-        for (int k = 3; k >= 0; --k) {
-            oss << std::hex << std::setw(2) << std::setfill('0') << ((v >> (k*8)) & 0xff);
-        }
+        tail[tailBlocks * 64 - 1 - j] = static_cast<uint8_t>(bitLen >> (j * 8));
     }
-    return oss.str();
+    return tailBlocks;
+}
+
+static Digest toDigest(const uint32_t state[8]) {
+    Digest digest;
+    for (size_t j = 0; j < Digest::kSize; ++j) {
+        digest.bytes[j] = static_cast<uint8_t>(state[j / 4] >> (24 - (j % 4) * 8));
+    }
+    return digest;
+}
+
+static Sha256BlockFn activeKernelFunction() {
+    static const Sha256BlockFn compress = kernelFunction(activeSha256Kernel());
+    return compress;
+}
+
+Sha256::Sha256() : compress_(activeKernelFunction()) {
+    reset();
+}
+
+Sha256::Sha256(Sha256Kernel kernel) : compress_(kernelFunction(kernel)) {
+    reset();
+}
+
+void Sha256::reset() {
+    memcpy(state_, kInitialState, sizeof(state_));
+    buffered_ = 0;
+    length_ = 0;
 }
 
-std::string sha256(const std::vector<uint8_t>& data) {
+void Sha256::update(const uint8_t* data, size_t len) {
+    if (!compress_) return;
+    length_ += len;
+    if (buffered_ > 0) {
+        size_t take = std::min(len, sizeof(buffer_) - buffered_);
+        memcpy(buffer_ + buffered_, data, take);
+        buffered_ += take;
+        data += take;
+        len -= take;
+        if (buffered_ < sizeof(buffer_)) return;
+        compress_(state_, buffer_, 1);
+        buffered_ = 0;
+    }
+    size_t blocks = len / 64;
+    if (blocks > 0) compress_(state_, data, blocks);
+    buffered_ = len % 64;
+    if (buffered_ > 0) memcpy(buffer_, data + blocks * 64, buffered_);
+}
+
+void Sha256::update(const std::string& data) {
+    update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+void Sha256::update(const Digest& digest) {
+    update(digest.bytes.data(), digest.bytes.size());
+}
+
+Digest Sha256::final() {
+    if (!compress_) return Digest();
+    uint8_t tail[128];
+    size_t tailBlocks = padTail(buffer_, buffered_, length_, tail);
+    compress_(state_, tail, tailBlocks);
+    Digest digest = toDigest(state_);
+    reset();
+    return digest;
+}
+
+Digest sha256(const uint8_t* data, size_t len, Sha256Kernel kernel) {
+    Sha256 hasher(kernel);
+    hasher.update(data, len);
+    return hasher.final();
+}
+
+Digest sha256(const uint8_t* data, size_t len) {
+    Sha256 hasher;
+    hasher.update(data, len);
+    return hasher.final();
+}
+
+Digest sha256(const std::vector<uint8_t>& data) {
     return sha256(data.data(), data.size());
 }
 
+static Sha256MultiBlockFn batchFunction(Sha256BatchKernel kernel) {
+    switch (kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+        case Sha256BatchKernel::AVX2_X8: return cpuHasAvx2() ? sha256BlocksAvx2x8 : nullptr;
+        case Sha256BatchKernel::AVX512_X16: return cpuHasAvx512() ? sha256BlocksAvx512x16 : nullptr;
+#endif
+        default: return nullptr;
+    }
+}
+
+std::vector<Sha256BatchKernel> supportedSha256BatchKernels() {
+    std::vector<Sha256BatchKernel> kernels = {Sha256BatchKernel::NONE};
+    for (Sha256BatchKernel kernel : {Sha256BatchKernel::AVX2_X8, Sha256BatchKernel::AVX512_X16}) {
+        if (batchFunction(kernel)) kernels.push_back(kernel);
+    }
+    return kernels;
+}
+
+Sha256BatchKernel activeSha256BatchKernel() {
+    static const Sha256BatchKernel active = supportedSha256BatchKernels().back();
+    return active;
+}
+
+const char* sha256BatchKernelName(Sha256BatchKernel kernel) {
+    switch (kernel) {
+        case Sha256BatchKernel::NONE: return "none";
+        case Sha256BatchKernel::AVX2_X8: return "avx2-x8";
+        case Sha256BatchKernel::AVX512_X16: return "avx512-x16";
+    }
+    return "unknown";
+}
+
+size_t sha256BatchLanes(Sha256BatchKernel kernel) {
+    switch (kernel) {
+        case Sha256BatchKernel::AVX2_X8: return 8;
+        case Sha256BatchKernel::AVX512_X16: return 16;
+        default: return 1;
+    }
+}
+
+std::vector<Digest> sha256Batch(const std::vector<const uint8_t*>& buffers, size_t len, Sha256BatchKernel kernel) {
+    std::vector<Digest> hashes(buffers.size());
+    Sha256MultiBlockFn compress = batchFunction(kernel);
+    const size_t lanes = sha256BatchLanes(kernel);
+    size_t next = 0;
+    // A group must fill at least half the lanes to beat hashing one by one;
+    // unused lanes repeat the group's first buffer and are discarded.
+    while (compress && buffers.size() - next >= (lanes + 1) / 2) {
+        size_t group = std::min(lanes, buffers.size() - next);
+        std::vector<const uint8_t*> data(lanes);
+        std::vector<uint8_t> tails(lanes * 128);
+        std::vector<const uint8_t*> tailData(lanes);
+        std::vector<uint32_t> stateWords(lanes * 8);
+        auto* state = reinterpret_cast<uint32_t(*)[8]>(stateWords.data());
+        size_t tailBlocks = 0;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            data[lane] = buffers[next + (lane < group ? lane : 0)];
+            memcpy(state[lane], kInitialState, sizeof(kInitialState));
+            tailBlocks = padTail(data[lane] + len / 64 * 64, len % 64, len, &tails[lane * 128]);
+            tailData[lane] = &tails[lane * 128];
+        }
+        if (len / 64 > 0) compress(state, data.data(), len / 64);
+        compress(state, tailData.data(), tailBlocks);
+        for (size_t lane = 0; lane < group; ++lane) hashes[next + lane] = toDigest(state[lane]);
+        next += group;
+    }
+    for (; next < buffers.size(); ++next) hashes[next] = sha256(buffers[next], len);
+    return hashes;
+}
+
+std::vector<Digest> sha256Batch(const std::vector<const uint8_t*>& buffers, size_t len) {
+    return sha256Batch(buffers, len, activeSha256BatchKernel());
+}
+
 }  // namespace common
 }  // namespace dfs
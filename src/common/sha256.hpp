@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common/digest.hpp"
 #include <cstdint>
 #include <cstddef>
 #include <string>
@@ -8,9 +9,62 @@
 namespace dfs {
 namespace common {
 
-// Self-contained SHA-256 (no OpenSSL). Returns 64-char hex string.
-std::string sha256(const uint8_t* data, size_t len);
-std::string sha256(const std::vector<uint8_t>& data);
+// Self-contained SHA-256 (no OpenSSL).
+Digest sha256(const uint8_t* data, size_t len);
+Digest sha256(const std::vector<uint8_t>& data);
+
+// Block compression kernels. sha256() uses the fastest one the CPU supports,
+// chosen once on first use.
+enum class Sha256Kernel { SCALAR, SSSE3, AVX2, SHA_NI, ARMV8_CE };
+
+// Kernels this CPU can run, slowest first; the last one is the active kernel.
+std::vector<Sha256Kernel> supportedSha256Kernels();
+Sha256Kernel activeSha256Kernel();
+const char* sha256KernelName(Sha256Kernel kernel);
+// Hashes with a specific kernel, for cross-checks and benchmarks. Returns an
+// all-zero digest if the kernel is not supported here.
+Digest sha256(const uint8_t* data, size_t len, Sha256Kernel kernel);
+
+// Incremental SHA-256 for data that arrives in pieces (socket reads, file
+// slices): update() takes fragments of any size, and whole blocks are
+// compressed straight from the caller's buffer. final() returns the digest
+// and resets the context for the next message.
+class Sha256 {
+public:
+    Sha256();
+    // A kernel this CPU lacks leaves the context unusable; final() returns an
+    // all-zero digest.
+    explicit Sha256(Sha256Kernel kernel);
+
+    void reset();
+    void update(const uint8_t* data, size_t len);
+    void update(const std::string& data);
+    void update(const Digest& digest);
+    Digest final();
+
+private:
+    void (*compress_)(uint32_t state[8], const uint8_t* data, size_t blocks);
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    size_t buffered_{0};
+    uint64_t length_{0};
+};
+
+// Multi-buffer kernels hash several independent messages in lockstep, one
+// per SIMD lane. NONE means buffers are hashed one at a time with sha256().
+enum class Sha256BatchKernel { NONE, AVX2_X8, AVX512_X16 };
+
+std::vector<Sha256BatchKernel> supportedSha256BatchKernels();
+// The batch kernel sha256Batch() uses: the widest one available. Even with
+// SHA extensions, eight or sixteen lanes give more aggregate throughput.
+Sha256BatchKernel activeSha256BatchKernel();
+const char* sha256BatchKernelName(Sha256BatchKernel kernel);
+// Messages hashed per batch kernel call (1 for NONE).
+size_t sha256BatchLanes(Sha256BatchKernel kernel = activeSha256BatchKernel());
+// Hashes buffers.size() buffers that are all `len` bytes long. Full groups of
+// lanes go through the batch kernel; a small remainder is hashed one by one.
+std::vector<Digest> sha256Batch(const std::vector<const uint8_t*>& buffers, size_t len);
+std::vector<Digest> sha256Batch(const std::vector<const uint8_t*>& buffers, size_t len, Sha256BatchKernel kernel);
 
 }  // namespace common
 }  // namespace dfs
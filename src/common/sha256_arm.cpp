@@ -0,0 +1,66 @@
+// ARMv8 SHA-256 kernel using the cryptography extension (SHA256H/H2/SU0/SU1).
+#include "common/sha256_kernels.hpp"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#if defined(__clang__)
+#define ARMV8_CRYPTO_FN __attribute__((target("crypto")))
+#else
+#define ARMV8_CRYPTO_FN __attribute__((target("+crypto")))
+#endif
+
+namespace dfs {
+namespace common {
+
+bool cpuHasArmv8Sha2() {
+#if defined(__APPLE__)
+    return true;  // every Apple arm64 core implements the SHA-2 instructions
+#elif defined(__linux__) && defined(HWCAP_SHA2)
+    static const bool hasSha2 = (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+    return hasSha2;
+#else
+    return false;
+#endif
+}
+
+// Each group g runs four rounds; while it does, the schedule for group g + 4
+// is produced in place (su0 then su1) from the three following groups.
+ARMV8_CRYPTO_FN void sha256BlocksArmv8(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const uint32x4_t abcdSave = state0;
+        const uint32x4_t efghSave = state1;
+        uint32x4_t msgs[4];
+        for (int i = 0; i < 4; ++i) {
+            msgs[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+        for (int g = 0; g < 16; ++g) {
+            uint32x4_t& cur = msgs[g % 4];
+            uint32x4_t wk = vaddq_u32(cur, vld1q_u32(&kSha256RoundConstants[4 * g]));
+            if (g < 12) cur = vsha256su0q_u32(cur, msgs[(g + 1) % 4]);
+            uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, abcd, wk);
+            if (g < 12) cur = vsha256su1q_u32(cur, msgs[(g + 2) % 4], msgs[(g + 3) % 4]);
+        }
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+}  // namespace common
+}  // namespace dfs
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dfs {
+namespace common {
+
+// Internal to the SHA-256 implementation. Every kernel compresses `blocks`
+// consecutive 64-byte blocks into `state`; each is only built for the
+// architecture it targets and may only be called when its cpuHas*() is true.
+using Sha256BlockFn = void (*)(uint32_t state[8], const uint8_t* data, size_t blocks);
+// Multi-buffer kernels compress `blocks` blocks of each of several messages,
+// one per SIMD lane: state[lane] and data[lane] for every lane of the kernel.
+using Sha256MultiBlockFn = void (*)(uint32_t state[][8], const uint8_t* const data[], size_t blocks);
+
+extern const uint32_t kSha256RoundConstants[64];
+
+// The 64 scalar rounds over a message schedule with the round constants
+// already added (wk[i] = W[i] + K[i]); shared by the SIMD schedule kernels.
+void sha256Rounds(uint32_t state[8], const uint32_t wk[64]);
+void sha256BlocksScalar(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+#if defined(__x86_64__) || defined(__i386__)
+bool cpuHasSsse3();
+bool cpuHasAvx2();
+bool cpuHasShaNi();
+bool cpuHasAvx512();
+void sha256BlocksSsse3(uint32_t state[8], const uint8_t* data, size_t blocks);
+void sha256BlocksAvx2(uint32_t state[8], const uint8_t* data, size_t blocks);
+void sha256BlocksShaNi(uint32_t state[8], const uint8_t* data, size_t blocks);
+void sha256BlocksAvx2x8(uint32_t state[][8], const uint8_t* const data[], size_t blocks);
+void sha256BlocksAvx512x16(uint32_t state[][8], const uint8_t* const data[], size_t blocks);
+#endif
+
+#if defined(__aarch64__)
+bool cpuHasArmv8Sha2();
+void sha256BlocksArmv8(uint32_t state[8], const uint8_t* data, size_t blocks);
+#endif
+
+}  // namespace common
+}  // namespace dfs
@@ -0,0 +1,441 @@
+// x86 SHA-256 kernels: SHA extensions, SSSE3 and AVX2 versions of the message
+// schedule feeding the scalar rounds, and multi-buffer AVX2 / AVX-512 kernels
+// that run 8 / 16 independent messages in SIMD lanes. Each function carries
+// its own target attribute so the rest of the build needs no extra flags.
+#include "common/sha256_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+namespace dfs {
+namespace common {
+
+namespace {
+
+struct CpuFeatures {
+    bool ssse3{false};
+    bool sse41{false};
+    bool avx2{false};
+    bool avx512{false};
+    bool sha{false};
+};
+
+CpuFeatures detectCpuFeatures() {
+    CpuFeatures f;
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return f;
+    f.ssse3 = (ecx & bit_SSSE3) != 0;
+    f.sse41 = (ecx & bit_SSE4_1) != 0;
+    // AVX state must also be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2).
+    // AVX-512 additionally needs the opmask and ZMM state (XCR0 bits 5-7).
+    bool osAvx = false;
+    bool osAvx512 = false;
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+        unsigned xcrLow, xcrHigh;
+        __asm__("xgetbv" : "=a"(xcrLow), "=d"(xcrHigh) : "c"(0));
+        osAvx = (xcrLow & 0x6) == 0x6;
+        osAvx512 = (xcrLow & 0xE6) == 0xE6;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        f.avx2 = osAvx && (ebx & bit_AVX2) != 0;
+        f.avx512 = osAvx512 && (ebx & bit_AVX512F) != 0;
+        f.sha = (ebx & bit_SHA) != 0;
+    }
+    return f;
+}
+
+const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+// ---- SSSE3 message schedule: four words of W per step ----
+
+#define SSSE3_FN __attribute__((target("ssse3"))) inline
+
+SSSE3_FN __m128i rotr128(__m128i x, int n) {
+    return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n));
+}
+
+SSSE3_FN __m128i gam0x4(__m128i x) {
+    return _mm_xor_si128(_mm_xor_si128(rotr128(x, 7), rotr128(x, 18)), _mm_srli_epi32(x, 3));
+}
+
+SSSE3_FN __m128i gam1x4(__m128i x) {
+    return _mm_xor_si128(_mm_xor_si128(rotr128(x, 17), rotr128(x, 19)), _mm_srli_epi32(x, 10));
+}
+
+// W[t..t+3] from x0 = W[t-16..t-13] ... x3 = W[t-4..t-1]. W[t+2] and W[t+3]
+// depend on W[t] and W[t+1], so the sigma1 term is done in two halves.
+SSSE3_FN __m128i scheduleStep(__m128i x0, __m128i x1, __m128i x2, __m128i x3) {
+    __m128i w15 = _mm_alignr_epi8(x1, x0, 4);
+    __m128i w7 = _mm_alignr_epi8(x3, x2, 4);
+    __m128i s = _mm_add_epi32(_mm_add_epi32(x0, gam0x4(w15)), w7);
+    __m128i lo = _mm_add_epi32(s, gam1x4(_mm_shuffle_epi32(x3, _MM_SHUFFLE(3, 3, 3, 2))));
+    __m128i hi = _mm_add_epi32(s, gam1x4(_mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 0, 0))));
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 2, 1, 0)));
+}
+
+SSSE3_FN void scheduleSsse3(const uint8_t* block, uint32_t wk[64]) {
+    const __m128i byteSwap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const __m128i* k = reinterpret_cast<const __m128i*>(kSha256RoundConstants);
+    __m128i x[4];
+    for (int i = 0; i < 4; ++i) {
+        x[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i)), byteSwap);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wk + 4 * i), _mm_add_epi32(x[i], _mm_loadu_si128(k + i)));
+    }
+    for (int t = 4; t < 16; ++t) {
+        __m128i next = scheduleStep(x[0], x[1], x[2], x[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wk + 4 * t), _mm_add_epi32(next, _mm_loadu_si128(k + t)));
+        x[0] = x[1];
+        x[1] = x[2];
+        x[2] = x[3];
+        x[3] = next;
+    }
+}
+
+// ---- AVX2 message schedule: two blocks at once, one per 128-bit lane ----
+
+#define AVX2_FN __attribute__((target("avx2"))) inline
+
+AVX2_FN __m256i rotr256(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+AVX2_FN __m256i gam0x8(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(rotr256(x, 7), rotr256(x, 18)), _mm256_srli_epi32(x, 3));
+}
+
+AVX2_FN __m256i gam1x8(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(rotr256(x, 17), rotr256(x, 19)), _mm256_srli_epi32(x, 10));
+}
+
+// Same as scheduleStep(); alignr and the shuffles work within each lane.
+AVX2_FN __m256i scheduleStep2(__m256i x0, __m256i x1, __m256i x2, __m256i x3) {
+    __m256i w15 = _mm256_alignr_epi8(x1, x0, 4);
+    __m256i w7 = _mm256_alignr_epi8(x3, x2, 4);
+    __m256i s = _mm256_add_epi32(_mm256_add_epi32(x0, gam0x8(w15)), w7);
+    __m256i lo = _mm256_add_epi32(s, gam1x8(_mm256_shuffle_epi32(x3, _MM_SHUFFLE(3, 3, 3, 2))));
+    __m256i hi = _mm256_add_epi32(s, gam1x8(_mm256_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 0, 0))));
+    return _mm256_castps_si256(
+        _mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 2, 1, 0)));
+}
+
+AVX2_FN void storeLanes(uint32_t* first, uint32_t* second, __m256i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(first), _mm256_castsi256_si128(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(second), _mm256_extracti128_si256(v, 1));
+}
+
+AVX2_FN void scheduleAvx2(const uint8_t* blocks, uint32_t wk0[64], uint32_t wk1[64]) {
+    const __m256i byteSwap = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+    const __m128i* k = reinterpret_cast<const __m128i*>(kSha256RoundConstants);
+    __m256i x[4];
+    for (int i = 0; i < 4; ++i) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 64 + 16 * i));
+        x[i] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1), byteSwap);
+        __m256i kv = _mm256_broadcastsi128_si256(_mm_loadu_si128(k + i));
+        storeLanes(wk0 + 4 * i, wk1 + 4 * i, _mm256_add_epi32(x[i], kv));
+    }
+    for (int t = 4; t < 16; ++t) {
+        __m256i next = scheduleStep2(x[0], x[1], x[2], x[3]);
+        __m256i kv = _mm256_broadcastsi128_si256(_mm_loadu_si128(k + t));
+        storeLanes(wk0 + 4 * t, wk1 + 4 * t, _mm256_add_epi32(next, kv));
+        x[0] = x[1];
+        x[1] = x[2];
+        x[2] = x[3];
+        x[3] = next;
+    }
+}
+
+// ---- Multi-buffer AVX2: eight messages, one per 32-bit lane ----
+
+AVX2_FN __m256i ror8x(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// rows[l] holds eight consecutive words of lane l; afterwards rows[i] holds
+// word i of every lane.
+AVX2_FN void transpose8x8(__m256i rows[8]) {
+    __m256i t[8];
+    __m256i u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_epi32(rows[i], rows[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(rows[i], rows[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        rows[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+// ---- Multi-buffer AVX-512: sixteen messages, one per 32-bit lane ----
+
+#define AVX512_FN __attribute__((target("avx512f"))) inline
+
+// Zero-masked forms with every lane kept: GCC 12 builds the plain shifts,
+// rotates and shuffles on an uninitialized vector and warns about it
+// (-Wmaybe-uninitialized).
+constexpr __mmask16 kAllWords = 0xFFFF;
+constexpr __mmask8 kAllQwords = 0xFF;
+
+template <int N>
+AVX512_FN __m512i rotr16x(__m512i x) {
+    return _mm512_maskz_ror_epi32(kAllWords, x, N);
+}
+
+template <int N>
+AVX512_FN __m512i shr16x(__m512i x) {
+    return _mm512_maskz_srli_epi32(kAllWords, x, N);
+}
+
+// Byte swap within each word using only AVX512F (no vpshufb, which is BW).
+AVX512_FN __m512i byteSwap16x(__m512i x) {
+    return _mm512_ternarylogic_epi32(rotr16x<8>(x), rotr16x<24>(x), _mm512_set1_epi32(0xFF00FF00), 0xE4);
+}
+
+AVX512_FN void transpose16x16(__m512i rows[16]) {
+    __m512i t[16];
+    __m512i u[16];
+    for (int i = 0; i < 16; i += 2) {
+        t[i] = _mm512_maskz_unpacklo_epi32(kAllWords, rows[i], rows[i + 1]);
+        t[i + 1] = _mm512_maskz_unpackhi_epi32(kAllWords, rows[i], rows[i + 1]);
+    }
+    for (int i = 0; i < 16; i += 4) {
+        u[i] = _mm512_maskz_unpacklo_epi64(kAllQwords, t[i], t[i + 2]);
+        u[i + 1] = _mm512_maskz_unpackhi_epi64(kAllQwords, t[i], t[i + 2]);
+        u[i + 2] = _mm512_maskz_unpacklo_epi64(kAllQwords, t[i + 1], t[i + 3]);
+        u[i + 3] = _mm512_maskz_unpackhi_epi64(kAllQwords, t[i + 1], t[i + 3]);
+    }
+    // u[4k + j] now holds, in 128-bit lane q, word 4q + j of rows 4k..4k+3.
+    for (int j = 0; j < 4; ++j) {
+        __m512i lo01 = _mm512_maskz_shuffle_i32x4(kAllWords, u[j], u[4 + j], _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i hi01 = _mm512_maskz_shuffle_i32x4(kAllWords, u[j], u[4 + j], _MM_SHUFFLE(3, 2, 3, 2));
+        __m512i lo23 = _mm512_maskz_shuffle_i32x4(kAllWords, u[8 + j], u[12 + j], _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i hi23 = _mm512_maskz_shuffle_i32x4(kAllWords, u[8 + j], u[12 + j], _MM_SHUFFLE(3, 2, 3, 2));
+        rows[j] = _mm512_maskz_shuffle_i32x4(kAllWords, lo01, lo23, _MM_SHUFFLE(2, 0, 2, 0));
+        rows[4 + j] = _mm512_maskz_shuffle_i32x4(kAllWords, lo01, lo23, _MM_SHUFFLE(3, 1, 3, 1));
+        rows[8 + j] = _mm512_maskz_shuffle_i32x4(kAllWords, hi01, hi23, _MM_SHUFFLE(2, 0, 2, 0));
+        rows[12 + j] = _mm512_maskz_shuffle_i32x4(kAllWords, hi01, hi23, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+}
+
+}  // namespace
+
+bool cpuHasSsse3() {
+    return cpuFeatures().ssse3;
+}
+
+bool cpuHasAvx2() {
+    return cpuFeatures().avx2;
+}
+
+bool cpuHasShaNi() {
+    return cpuFeatures().sha && cpuFeatures().sse41;
+}
+
+bool cpuHasAvx512() {
+    return cpuFeatures().avx512;
+}
+
+__attribute__((target("ssse3"))) void sha256BlocksSsse3(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    alignas(16) uint32_t wk[64];
+    for (; blocks > 0; --blocks, data += 64) {
+        scheduleSsse3(data, wk);
+        sha256Rounds(state, wk);
+    }
+}
+
+__attribute__((target("avx2"))) void sha256BlocksAvx2(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    alignas(32) uint32_t wk0[64];
+    alignas(32) uint32_t wk1[64];
+    for (; blocks >= 2; blocks -= 2, data += 128) {
+        scheduleAvx2(data, wk0, wk1);
+        sha256Rounds(state, wk0);
+        sha256Rounds(state, wk1);
+    }
+    if (blocks == 1) {
+        scheduleSsse3(data, wk0);
+        sha256Rounds(state, wk0);
+    }
+}
+
+// Follows the layout of Intel's reference code: the state is kept as ABEF /
+// CDGH, and each sha256rnds2 does two rounds. Message words for group g + 1
+// are finished (msg2) while group g runs; msg1 starts group g + 3.
+__attribute__((target("sha,sse4.1"))) void sha256BlocksShaNi(uint32_t state[8], const uint8_t* data,
+                                                              size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    const __m128i* k = reinterpret_cast<const __m128i*>(kSha256RoundConstants);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);         // CDGH
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i msgs[4];
+        for (int g = 0; g < 16; ++g) {
+            __m128i& cur = msgs[g % 4];
+            if (g < 4) {
+                cur = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * g)), byteSwap);
+            }
+            __m128i msg = _mm_add_epi32(cur, _mm_loadu_si128(k + g));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g < 15) {
+                __m128i& next = msgs[(g + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(cur, msgs[(g + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, cur);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+            if (g >= 1 && g < 13) {
+                __m128i& prev = msgs[(g + 3) % 4];
+                prev = _mm_sha256msg1_epu32(prev, cur);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);                // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);             // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);          // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);             // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+// Same rounds as sha256Rounds(), with every variable holding one word of each
+// of the eight messages.
+__attribute__((target("avx2"))) void sha256BlocksAvx2x8(uint32_t state[][8], const uint8_t* const data[],
+                                                         size_t blocks) {
+    const __m256i byteSwap = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+    __m256i h[8];
+    for (int i = 0; i < 8; ++i) {
+        h[i] = _mm256_setr_epi32(state[0][i], state[1][i], state[2][i], state[3][i],
+                                 state[4][i], state[5][i], state[6][i], state[7][i]);
+    }
+
+    for (size_t block = 0; block < blocks; ++block) {
+        __m256i w[16];
+        for (int half = 0; half < 2; ++half) {
+            __m256i* rows = w + 8 * half;
+            for (int lane = 0; lane < 8; ++lane) {
+                rows[lane] = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(data[lane] + block * 64 + 32 * half));
+            }
+            transpose8x8(rows);
+            for (int i = 0; i < 8; ++i) rows[i] = _mm256_shuffle_epi8(rows[i], byteSwap);
+        }
+
+        __m256i a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int t = 0; t < 64; ++t) {
+            __m256i wt;
+            if (t < 16) {
+                wt = w[t];
+            } else {
+                __m256i w15 = w[(t - 15) & 15];
+                __m256i w2 = w[(t - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ror8x(w15, 7), ror8x(w15, 18)),
+                                              _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ror8x(w2, 17), ror8x(w2, 19)),
+                                              _mm256_srli_epi32(w2, 10));
+                wt = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+                w[t & 15] = wt;
+            }
+            __m256i sig1 = _mm256_xor_si256(_mm256_xor_si256(ror8x(e, 6), ror8x(e, 11)), ror8x(e, 25));
+            __m256i chv = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(hh, sig1),
+                                          _mm256_add_epi32(chv, _mm256_add_epi32(
+                                              wt, _mm256_set1_epi32(static_cast<int>(kSha256RoundConstants[t])))));
+            __m256i sig0 = _mm256_xor_si256(_mm256_xor_si256(ror8x(a, 2), ror8x(a, 13)), ror8x(a, 22));
+            __m256i majv = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(sig0, majv);
+            hh = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+        }
+        h[0] = _mm256_add_epi32(h[0], a); h[1] = _mm256_add_epi32(h[1], b);
+        h[2] = _mm256_add_epi32(h[2], c); h[3] = _mm256_add_epi32(h[3], d);
+        h[4] = _mm256_add_epi32(h[4], e); h[5] = _mm256_add_epi32(h[5], f);
+        h[6] = _mm256_add_epi32(h[6], g); h[7] = _mm256_add_epi32(h[7], hh);
+    }
+
+    alignas(32) uint32_t words[8];
+    for (int i = 0; i < 8; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words), h[i]);
+        for (int lane = 0; lane < 8; ++lane) state[lane][i] = words[lane];
+    }
+}
+
+// Sixteen-lane version; AVX-512 adds native rotates and three-input logic
+// (ternarylogic 0xCA is Ch, 0xE8 is Maj, 0x96 is a three-way XOR).
+__attribute__((target("avx512f"))) void sha256BlocksAvx512x16(uint32_t state[][8], const uint8_t* const data[],
+                                                               size_t blocks) {
+    __m512i h[8];
+    for (int i = 0; i < 8; ++i) {
+        alignas(64) uint32_t words[16];
+        for (int lane = 0; lane < 16; ++lane) words[lane] = state[lane][i];
+        h[i] = _mm512_load_si512(words);
+    }
+
+    for (size_t block = 0; block < blocks; ++block) {
+        __m512i w[16];
+        for (int lane = 0; lane < 16; ++lane) {
+            w[lane] = _mm512_loadu_si512(data[lane] + block * 64);
+        }
+        transpose16x16(w);
+        for (int i = 0; i < 16; ++i) w[i] = byteSwap16x(w[i]);
+
+        __m512i a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int t = 0; t < 64; ++t) {
+            __m512i wt;
+            if (t < 16) {
+                wt = w[t];
+            } else {
+                __m512i w15 = w[(t - 15) & 15];
+                __m512i w2 = w[(t - 2) & 15];
+                __m512i s0 = _mm512_ternarylogic_epi32(rotr16x<7>(w15), rotr16x<18>(w15), shr16x<3>(w15), 0x96);
+                __m512i s1 = _mm512_ternarylogic_epi32(rotr16x<17>(w2), rotr16x<19>(w2), shr16x<10>(w2), 0x96);
+                wt = _mm512_add_epi32(_mm512_add_epi32(w[t & 15], s0), _mm512_add_epi32(w[(t - 7) & 15], s1));
+                w[t & 15] = wt;
+            }
+            __m512i sig1 = _mm512_ternarylogic_epi32(rotr16x<6>(e), rotr16x<11>(e), rotr16x<25>(e), 0x96);
+            __m512i chv = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+            __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(hh, sig1),
+                                          _mm512_add_epi32(chv, _mm512_add_epi32(
+                                              wt, _mm512_set1_epi32(static_cast<int>(kSha256RoundConstants[t])))));
+            __m512i sig0 = _mm512_ternarylogic_epi32(rotr16x<2>(a), rotr16x<13>(a), rotr16x<22>(a), 0x96);
+            __m512i majv = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+            __m512i t2 = _mm512_add_epi32(sig0, majv);
+            hh = g; g = f; f = e; e = _mm512_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm512_add_epi32(t1, t2);
+        }
+        h[0] = _mm512_add_epi32(h[0], a); h[1] = _mm512_add_epi32(h[1], b);
+        h[2] = _mm512_add_epi32(h[2], c); h[3] = _mm512_add_epi32(h[3], d);
+        h[4] = _mm512_add_epi32(h[4], e); h[5] = _mm512_add_epi32(h[5], f);
+        h[6] = _mm512_add_epi32(h[6], g); h[7] = _mm512_add_epi32(h[7], hh);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        alignas(64) uint32_t words[16];
+        _mm512_store_si512(words, h[i]);
+        for (int lane = 0; lane < 16; ++lane) state[lane][i] = words[lane];
+    }
+}
+
+}  // namespace common
+}  // namespace dfs
+
+#endif
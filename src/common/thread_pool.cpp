@@ -0,0 +1,131 @@
+#include "common/thread_pool.hpp"
+
+namespace dfs {
+namespace common {
+
+namespace {
+// Identifies the pool and queue of the worker running on this thread.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+}  // namespace
+
+size_t ThreadPool::defaultThreadCount() {
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 4 : static_cast<size_t>(hw);
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(defaultThreadCount());
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) threadCount = defaultThreadCount();
+    local_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) local_.emplace_back(new WorkQueue());
+    workers_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+bool ThreadPool::submit(std::function<void()> task) {
+    {
+        // queued_ is raised before the task is visible so it never underflows;
+        // a worker that wakes a moment early just looks again.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return false;
+        queued_++;
+    }
+    WorkQueue& queue = currentPool == this ? *local_[currentWorker] : injected_;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn, size_t maxParallelism) {
+    if (count == 0) return;
+    struct Progress {
+        std::atomic<size_t> next{0};
+        size_t done{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto progress = std::make_shared<Progress>();
+    // Helpers that start after every index is claimed touch only `progress`.
+    auto run = [progress, count, &fn]() {
+        size_t i;
+        while ((i = progress->next++) < count) {
+            fn(i);
+            std::lock_guard<std::mutex> lock(progress->mutex);
+            if (++progress->done == count) progress->cv.notify_all();
+        }
+    };
+
+    size_t threads = maxParallelism == 0 ? size() + 1 : maxParallelism;
+    size_t helpers = std::min(count, threads) - 1;
+    for (size_t h = 0; h < helpers; ++h) {
+        if (!submit(run)) break;
+    }
+    run();
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->cv.wait(lock, [&]() { return progress->done == count; });
+}
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+bool ThreadPool::popTask(size_t index, std::function<void()>& task) {
+    auto take = [&](WorkQueue& queue, bool newest) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        if (newest) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        queued_--;
+        return true;
+    };
+    if (take(*local_[index], true) || take(injected_, false)) return true;
+    for (size_t i = 1; i < local_.size(); ++i) {
+        if (take(*local_[(index + i) % local_.size()], false)) return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+    while (true) {
+        std::function<void()> task;
+        if (popTask(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) return;
+    }
+}
+
+}  // namespace common
+}  // namespace dfs
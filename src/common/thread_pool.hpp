@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dfs {
+namespace common {
+
+// Work-stealing pool of worker threads. Tasks submitted from outside go to a
+// shared FIFO queue; tasks a worker submits go to its own deque, which it
+// drains newest-first while idle workers steal oldest-first. shutdown()
+// drains all queues before joining the workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    bool submit(std::function<void()> task);
+    // Runs fn(0) .. fn(count - 1) on at most maxParallelism threads (0 = all
+    // workers), the calling thread included, and returns when all are done.
+    // Safe to call from inside a task.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn, size_t maxParallelism = 0);
+    void shutdown();
+    size_t size() const { return workers_.size(); }
+
+    static size_t defaultThreadCount();
+    // Process-wide pool for CPU-bound work, defaultThreadCount() workers.
+    static ThreadPool& shared();
+
+private:
+    struct WorkQueue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    void workerLoop(size_t index);
+    bool popTask(size_t index, std::function<void()>& task);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkQueue>> local_;
+    WorkQueue injected_;
+    std::atomic<long> queued_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_{false};
+};
+
+}  // namespace common
+}  // namespace dfs
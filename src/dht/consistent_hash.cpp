@@ -29,10 +29,28 @@ std::string ConsistentHash::getNodeForKey(const std::string& key) const {
     return it->second;
 }
 
+int ConsistentHash::ringPosition(const common::Digest& key) {
+    uint32_t pos = 0;
+    for (int i = 0; i < 4; ++i) pos = pos << 8 | key.bytes[i];
+    return static_cast<int>(pos);
+}
+
+std::string ConsistentHash::getNodeForKey(const common::Digest& key) const {
+    std::vector<std::string> nodes = nodesFrom(ringPosition(key), 1);
+    return nodes.empty() ? "" : nodes.front();
+}
+
 std::vector<std::string> ConsistentHash::getNodesForKey(const std::string& key, int k) const {
+    return nodesFrom(hashKey(key), k);
+}
+
+std::vector<std::string> ConsistentHash::getNodesForKey(const common::Digest& key, int k) const {
+    return nodesFrom(ringPosition(key), k);
+}
+
+std::vector<std::string> ConsistentHash::nodesFrom(int pos, int k) const {
     std::vector<std::string> nodes;
     if (ring_.empty()) return nodes;
-    int pos = hashKey(key);
     auto it = ring_.lower_bound(pos);
     if (it == ring_.end()) it = ring_.begin();
     std::vector<int> keys;
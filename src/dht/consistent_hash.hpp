@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common/digest.hpp"
 #include <map>
 #include <string>
 #include <vector>
@@ -13,6 +14,10 @@ public:
     void removeNode(const std::string& nodeAddress);
     std::string getNodeForKey(const std::string& key) const;
     std::vector<std::string> getNodesForKey(const std::string& key, int k) const;
+    // Content keys are already uniform, so their ring position is read
+    // straight from the digest instead of hashing its hex form.
+    std::string getNodeForKey(const common::Digest& key) const;
+    std::vector<std::string> getNodesForKey(const common::Digest& key, int k) const;
     std::vector<std::string> getAllNodes() const;
     int getNodeCount() const;
     bool hasNode(const std::string& nodeAddress) const;
@@ -20,6 +25,8 @@ public:
 
 private:
     static int hashKey(const std::string& key);
+    static int ringPosition(const common::Digest& key);
+    std::vector<std::string> nodesFrom(int pos, int k) const;
     std::map<int, std::string> ring_;
 };
 
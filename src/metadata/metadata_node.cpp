@@ -14,7 +14,7 @@ MetadataNode::MetadataNode(const std::string& nextNodeIp, int nextNodePort)
     }
 }
 
-void MetadataNode::start(int port) {
+void MetadataNode::start(int port, dfs::network::ServerMode mode) {
     myPort_ = port;
     if (!server_.start(port)) {
         std::cerr << "Failed to start metadata node on port " << port << std::endl;
@@ -24,8 +24,18 @@ void MetadataNode::start(int port) {
     std::cout << "Metadata Node started on port " << port << " Role: " << (role_ == Role::TAIL ? "TAIL" : "HEAD")
               << " Next: " << nextNodePort_ << std::endl;
 
+    // Joined before start() returns so the loop never outlives this node.
     std::thread healthThread([this]() { healthCheckLoop(); });
-    healthThread.detach();
+
+    if (mode != dfs::network::ServerMode::THREADED) {
+        server_.runEventLoop(
+            [this](dfs::network::Connection& conn, std::vector<uint8_t> frame) {
+                if (frame.empty() || !handleFrame(conn, frame)) server_.closeClient(conn.id());
+            },
+            nullptr, 0, mode);
+        stopHealthCheck(healthThread);
+        return;
+    }
 
     while (running_) {
         int clientId = server_.acceptClient();
@@ -40,11 +50,25 @@ void MetadataNode::start(int port) {
     }
     std::unique_lock<std::mutex> lock(handlersMutex_);
     handlersCv_.wait(lock, [this]() { return activeHandlers_.load() == 0; });
+    lock.unlock();
+    stopHealthCheck(healthThread);
+}
+
+void MetadataNode::stopHealthCheck(std::thread& healthThread) {
+    {
+        std::lock_guard<std::mutex> lock(healthMutex_);
+        running_ = false;
+    }
+    healthCv_.notify_all();
+    if (healthThread.joinable()) healthThread.join();
 }
 
 void MetadataNode::healthCheckLoop() {
     while (running_) {
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+        {
+            std::unique_lock<std::mutex> lock(healthMutex_);
+            if (healthCv_.wait_for(lock, std::chrono::seconds(3), [this]() { return !running_; })) break;
+        }
         if (nextNodePort_ != -1) {
             if (!pingNext()) {
                 std::cout << "Port " << myPort_ << ": Next node " << nextNodePort_ << " failed!" << std::endl;
@@ -92,128 +116,203 @@ void MetadataNode::notifyNextOfPredecessor() {
 }
 
 void MetadataNode::handleClient(int clientId) {
+    auto conn = server_.connection(clientId);
+    if (!conn) return;
     while (running_) {
-        std::string command = server_.recvMessage(clientId);
-        if (command.empty()) break;
-
-        std::istringstream iss(command);
-        std::string op;
-        iss >> op;
-
-        if (op == "PUT") {
-            handlePut(clientId, command);
-        } else if (op == "GET") {
-            std::string filename;
-            if (iss >> filename) handleGet(clientId, filename);
-        } else if (op == "PING") {
-            server_.sendMessage(clientId, "PONG");
-        } else if (op == "UPDATE_PREV") {
-            std::string ip;
-            int port;
-            if (iss >> ip >> port) {
-                std::lock_guard<std::mutex> lock(chainMutex_);
-                prevNodeIp_ = ip;
-                prevNodePort_ = port;
-                if (role_ == Role::HEAD) role_ = Role::MIDDLE;
-                if (role_ == Role::SINGLE) role_ = Role::TAIL;
-                std::cout << "Port " << myPort_ << ": Updated prev to " << prevNodePort_ << ". New Role: MIDDLE/TAIL" << std::endl;
-                server_.sendMessage(clientId, "ACK");
-            }
-        } else if (op == "UPDATE_NEXT") {
-            std::string ip;
-            int port;
-            if (iss >> ip >> port) {
-                std::lock_guard<std::mutex> lock(chainMutex_);
-                nextNodeIp_ = ip;
-                nextNodePort_ = port;
-                if (role_ == Role::TAIL) role_ = Role::MIDDLE;
-                if (role_ == Role::SINGLE) role_ = Role::HEAD;
-                std::cout << "Port " << myPort_ << ": Updated next to " << nextNodePort_ << std::endl;
-                server_.sendMessage(clientId, "ACK");
-            }
-        } else if (op == "SET_SKIP") {
-            std::string ip;
-            int port;
-            if (iss >> ip >> port) {
-                std::lock_guard<std::mutex> lock(chainMutex_);
-                skipToIp_ = ip;
-                skipToPort_ = port;
-                std::cout << "Port " << myPort_ << ": Set skip node to " << skipToPort_ << std::endl;
-                server_.sendMessage(clientId, "ACK");
+        std::vector<uint8_t> frame = conn->recvData();
+        if (frame.empty()) break;
+        if (!handleFrame(*conn, frame)) break;
+    }
+    server_.closeClient(clientId);
+}
+
+bool MetadataNode::handleFrame(dfs::network::Connection& conn, const std::vector<uint8_t>& frame) {
+    return dfs::network::isBinaryFrame(frame) ? handleBinary(conn, frame) : handleCommand(conn, frame);
+}
+
+void MetadataNode::stop() {
+    std::cout << "Port " << myPort_ << ": Received DIE command. Stopping..." << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(healthMutex_);
+        running_ = false;
+    }
+    healthCv_.notify_all();
+    server_.stop();
+}
+
+bool MetadataNode::handleCommand(dfs::network::Connection& conn, const std::vector<uint8_t>& frame) {
+    std::istringstream iss(std::string(frame.begin(), frame.end()));
+    std::string op;
+    iss >> op;
+
+    if (op == "PUT") {
+        handlePut(conn, frame);
+    } else if (op == "GET") {
+        std::string filename;
+        if (iss >> filename) handleGet(conn, filename);
+    } else if (op == "PING") {
+        conn.sendMessage("PONG");
+    } else if (op == "UPDATE_PREV") {
+        std::string ip;
+        int port;
+        if (iss >> ip >> port) {
+            std::lock_guard<std::mutex> lock(chainMutex_);
+            prevNodeIp_ = ip;
+            prevNodePort_ = port;
+            if (role_ == Role::HEAD) role_ = Role::MIDDLE;
+            if (role_ == Role::SINGLE) role_ = Role::TAIL;
+            std::cout << "Port " << myPort_ << ": Updated prev to " << prevNodePort_ << ". New Role: MIDDLE/TAIL" << std::endl;
+            conn.sendMessage("ACK");
+        }
+    } else if (op == "UPDATE_NEXT") {
+        std::string ip;
+        int port;
+        if (iss >> ip >> port) {
+            std::lock_guard<std::mutex> lock(chainMutex_);
+            nextNodeIp_ = ip;
+            nextNodePort_ = port;
+            if (role_ == Role::TAIL) role_ = Role::MIDDLE;
+            if (role_ == Role::SINGLE) role_ = Role::HEAD;
+            std::cout << "Port " << myPort_ << ": Updated next to " << nextNodePort_ << std::endl;
+            conn.sendMessage("ACK");
+        }
+    } else if (op == "SET_SKIP") {
+        std::string ip;
+        int port;
+        if (iss >> ip >> port) {
+            std::lock_guard<std::mutex> lock(chainMutex_);
+            skipToIp_ = ip;
+            skipToPort_ = port;
+            std::cout << "Port " << myPort_ << ": Set skip node to " << skipToPort_ << std::endl;
+            conn.sendMessage("ACK");
+        }
+    } else if (op == "GET_STATUS") {
+        std::string roleStr = (role_ == Role::HEAD) ? "HEAD" : (role_ == Role::MIDDLE) ? "MIDDLE" : (role_ == Role::TAIL) ? "TAIL" : "SINGLE";
+        conn.sendMessage("ROLE=" + roleStr + " NEXT=" + std::to_string(nextNodePort_) + " PREV=" + std::to_string(prevNodePort_));
+    } else if (op == "DIE") {
+        stop();
+        return false;
+    } else {
+        conn.sendMessage("ERROR");
+    }
+    return true;
+}
+
+// The chain's control messages (PING, UPDATE_PREV, SET_SKIP, ...) stay text;
+// the binary format covers the client-facing PUT and GET.
+bool MetadataNode::handleBinary(dfs::network::Connection& conn, const std::vector<uint8_t>& frame) {
+    using dfs::network::MessageWriter;
+    using dfs::network::Opcode;
+    using dfs::network::Status;
+    dfs::network::MessageHeader header;
+    dfs::network::MessageReader payload;
+    if (!dfs::network::parseMessage(frame, header, payload)) {
+        conn.sendData(MessageWriter::response(header, Status::BAD_REQUEST).finish());
+        return true;
+    }
+
+    switch (header.opcode) {
+    case Opcode::PUT_META: {
+        common::FileMetadata meta;
+        if (!dfs::network::readFileMetadata(payload, meta)) {
+            conn.sendData(MessageWriter::response(header, Status::BAD_REQUEST).finish());
+            break;
+        }
+        Status status = commitPut(meta, frame, true) ? Status::OK : Status::FORWARD_FAILED;
+        conn.sendData(MessageWriter::response(header, status).finish());
+        break;
+    }
+    case Opcode::GET_META: {
+        std::string filename;
+        if (!payload.string(filename)) {
+            conn.sendData(MessageWriter::response(header, Status::BAD_REQUEST).finish());
+            break;
+        }
+        if (role_ != Role::TAIL && role_ != Role::SINGLE) {
+            conn.sendData(MessageWriter::response(header, Status::REDIRECT).finish());
+            break;
+        }
+        common::FileMetadata meta;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(storeMutex_);
+            auto it = metadataStore_.find(filename);
+            if (it != metadataStore_.end()) {
+                meta = it->second;
+                found = true;
             }
-        } else if (op == "GET_STATUS") {
-            std::string roleStr = (role_ == Role::HEAD) ? "HEAD" : (role_ == Role::MIDDLE) ? "MIDDLE" : (role_ == Role::TAIL) ? "TAIL" : "SINGLE";
-            server_.sendMessage(clientId, "ROLE=" + roleStr + " NEXT=" + std::to_string(nextNodePort_) + " PREV=" + std::to_string(prevNodePort_));
-        } else if (op == "DIE") {
-            std::cout << "Port " << myPort_ << ": Received DIE command. Stopping..." << std::endl;
-            running_ = false;
-            server_.stop();
+        }
+        if (!found) {
+            conn.sendData(MessageWriter::response(header, Status::NOT_FOUND).finish());
             break;
-        } else {
-            server_.sendMessage(clientId, "ERROR");
         }
+        MessageWriter writer = MessageWriter::response(header, Status::OK);
+        dfs::network::writeFileMetadata(writer, meta);
+        conn.sendData(writer.finish());
+        break;
     }
-    server_.closeClient(clientId);
+    case Opcode::PING:
+        conn.sendData(MessageWriter::response(header, Status::OK).finish());
+        break;
+    case Opcode::DIE:
+        stop();
+        return false;
+    default:
+        conn.sendData(MessageWriter::response(header, Status::BAD_REQUEST).finish());
+        break;
+    }
+    return true;
 }
 
-void MetadataNode::handlePut(int clientId, const std::string& command) {
-    std::istringstream iss(command);
-    std::string op, filename, rootHash, hashesStr;
-    int64_t fileSize;
-    int chunkSize, totalChunks;
-    if (!(iss >> op >> filename >> fileSize >> chunkSize >> totalChunks >> rootHash >> hashesStr)) {
-        server_.sendMessage(clientId, "ERROR_ARGS");
-        return;
-    }
+void MetadataNode::handlePut(dfs::network::Connection& conn, const std::vector<uint8_t>& frame) {
+    std::istringstream iss(std::string(frame.begin(), frame.end()));
+    std::string op, rest;
     common::FileMetadata meta;
-    meta.filename = filename;
-    meta.fileSize = fileSize;
-    meta.chunkSize = chunkSize;
-    meta.totalChunks = totalChunks;
-    meta.rootHash = rootHash;
-    meta.chunkHashes.clear();
-    std::string h;
-    std::istringstream hs(hashesStr);
-    while (std::getline(hs, h, ',')) {
-        if (!h.empty()) meta.chunkHashes.push_back(h);
+    if (!(iss >> op >> meta.filename) || !std::getline(iss, rest) ||
+        !dfs::network::parseTextMetadata(rest, meta)) {
+        conn.sendMessage("ERROR_ARGS");
+        return;
     }
+    conn.sendMessage(commitPut(meta, frame, false) ? "ACK" : "ERROR_FORWARD");
+}
 
+bool MetadataNode::commitPut(const common::FileMetadata& meta, const std::vector<uint8_t>& frame, bool binary) {
     {
         std::lock_guard<std::mutex> lock(storeMutex_);
-        metadataStore_[filename] = meta;
+        metadataStore_[meta.filename] = meta;
     }
-    std::cout << "Port " << myPort_ << ": Stored metadata for " << filename << std::endl;
+    std::cout << "Port " << myPort_ << ": Stored metadata for " << meta.filename << std::endl;
 
-    bool success = true;
     if (role_ != Role::TAIL && role_ != Role::SINGLE && nextNodePort_ != -1) {
-        success = forwardPut(command);
-    }
-
-    if (success) {
-        server_.sendMessage(clientId, "ACK");
-    } else {
-        server_.sendMessage(clientId, "ERROR_FORWARD");
+        return forwardPut(frame, binary);
     }
+    return true;
 }
 
-bool MetadataNode::forwardPut(const std::string& command) {
+bool MetadataNode::forwardPut(const std::vector<uint8_t>& frame, bool binary) {
     dfs::network::TCPClient client;
     if (!client.connect(nextNodeIp_, nextNodePort_)) {
         std::cerr << "Port " << myPort_ << ": Failed to forward to " << nextNodePort_ << std::endl;
         return false;
     }
-    if (!client.sendMessage(command)) {
+    if (!client.sendData(frame)) {
         client.close();
         return false;
     }
-    std::string response = client.recvMessage();
+    std::vector<uint8_t> response = client.recvData();
     client.close();
-    return response == "ACK";
+    if (!binary) return std::string(response.begin(), response.end()) == "ACK";
+    dfs::network::MessageHeader header;
+    dfs::network::MessageReader payload;
+    dfs::network::parseMessage(frame, header, payload);
+    dfs::network::Status status;
+    return dfs::network::parseResponse(response, dfs::network::Opcode::PUT_META, header.requestId, status, payload) &&
+           status == dfs::network::Status::OK;
 }
 
-void MetadataNode::handleGet(int clientId, const std::string& filename) {
+void MetadataNode::handleGet(dfs::network::Connection& conn, const std::string& filename) {
     if (role_ != Role::TAIL && role_ != Role::SINGLE) {
-        server_.sendMessage(clientId, "REDIRECT_TO_TAIL");
+        conn.sendMessage("REDIRECT_TO_TAIL");
         return;
     }
     common::FileMetadata meta;
@@ -221,19 +320,12 @@ void MetadataNode::handleGet(int clientId, const std::string& filename) {
         std::lock_guard<std::mutex> lock(storeMutex_);
         auto it = metadataStore_.find(filename);
         if (it == metadataStore_.end()) {
-            server_.sendMessage(clientId, "NOT_FOUND");
+            conn.sendMessage("NOT_FOUND");
             return;
         }
         meta = it->second;
     }
-    std::string hashesStr;
-    for (size_t i = 0; i < meta.chunkHashes.size(); ++i) {
-        if (i > 0) hashesStr += ",";
-        hashesStr += meta.chunkHashes[i];
-    }
-    std::string msg = "FOUND " + std::to_string(meta.fileSize) + " " + std::to_string(meta.chunkSize) + " " +
-                      std::to_string(meta.totalChunks) + " " + meta.rootHash + " " + hashesStr;
-    server_.sendMessage(clientId, msg);
+    conn.sendMessage("FOUND " + dfs::network::formatTextMetadata(meta));
 }
 
 }  // namespace metadata
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/file_metadata.hpp"
+#include "network/protocol.hpp"
 #include "network/tcp_client.hpp"
 #include "network/tcp_server.hpp"
 #include <atomic>
@@ -18,17 +19,25 @@ enum class Role { HEAD, MIDDLE, TAIL, SINGLE };
 class MetadataNode {
 public:
     MetadataNode(const std::string& nextNodeIp, int nextNodePort);
-    void start(int port);
+    void start(int port, dfs::network::ServerMode mode = dfs::network::ServerMode::THREADED);
 
 private:
     void handleClient(int clientId);
+    // Dispatches one request frame in either wire format; false closes the connection.
+    bool handleFrame(dfs::network::Connection& conn, const std::vector<uint8_t>& frame);
+    bool handleCommand(dfs::network::Connection& conn, const std::vector<uint8_t>& frame);
+    bool handleBinary(dfs::network::Connection& conn, const std::vector<uint8_t>& frame);
     void healthCheckLoop();
+    void stopHealthCheck(std::thread& healthThread);
     bool pingNext();
     void handleNextNodeFailure();
     void notifyNextOfPredecessor();
-    void handlePut(int clientId, const std::string& command);
-    bool forwardPut(const std::string& command);
-    void handleGet(int clientId, const std::string& filename);
+    void handlePut(dfs::network::Connection& conn, const std::vector<uint8_t>& frame);
+    // Stores `meta` and forwards the request frame, unchanged, down the chain.
+    bool commitPut(const common::FileMetadata& meta, const std::vector<uint8_t>& frame, bool binary);
+    bool forwardPut(const std::vector<uint8_t>& frame, bool binary);
+    void handleGet(dfs::network::Connection& conn, const std::string& filename);
+    void stop();
 
     dfs::network::TCPServer server_;
     std::map<std::string, common::FileMetadata> metadataStore_;
@@ -47,6 +56,8 @@ private:
     std::atomic<int> activeHandlers_{0};
     std::condition_variable handlersCv_;
     std::mutex handlersMutex_;
+    std::condition_variable healthCv_;
+    std::mutex healthMutex_;
 };
 
 }  // namespace metadata
@@ -0,0 +1,139 @@
+#include "network/framing.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/io_stats.hpp"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace dfs {
+namespace network {
+
+bool sendFrame(int fd, const IoSlice* parts, size_t count, int flags) {
+    constexpr size_t kMaxParts = 7;
+    if (count > kMaxParts) return false;
+    size_t body = 0;
+    for (size_t i = 0; i < count; ++i) body += parts[i].len;
+    uint32_t len32 = htonl(static_cast<uint32_t>(body));
+
+    struct iovec iov[kMaxParts + 1];
+    iov[0].iov_base = &len32;
+    iov[0].iov_len = sizeof(len32);
+    size_t iovcnt = 1;
+    for (size_t i = 0; i < count; ++i) {
+        if (parts[i].len == 0) continue;
+        iov[iovcnt].iov_base = const_cast<uint8_t*>(parts[i].data);
+        iov[iovcnt].iov_len = parts[i].len;
+        ++iovcnt;
+    }
+    // Advance past what each call sent until the whole frame is out.
+    struct iovec* next = iov;
+    while (iovcnt > 0) {
+        struct msghdr msg {};
+        msg.msg_iov = next;
+        msg.msg_iovlen = iovcnt;
+        common::countSyscalls();
+        ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL | flags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        size_t sent = static_cast<size_t>(n);
+        while (iovcnt > 0 && sent >= next->iov_len) {
+            sent -= next->iov_len;
+            ++next;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            next->iov_base = static_cast<uint8_t*>(next->iov_base) + sent;
+            next->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+bool FrameReader::fill(int fd) {
+    if (buffer_.empty()) buffer_.resize(kBufferSize);
+    if (begin_ == end_) {
+        begin_ = end_ = 0;
+    } else if (end_ == buffer_.size()) {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    while (true) {
+        common::countSyscalls();
+        ssize_t n = ::recv(fd, buffer_.data() + end_, buffer_.size() - end_, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        end_ += static_cast<size_t>(n);
+        return true;
+    }
+}
+
+bool FrameReader::read(int fd, std::vector<uint8_t>& frame, common::Sha256* hasher) {
+    while (buffered() < sizeof(uint32_t)) {
+        if (!fill(fd)) return false;
+    }
+    uint32_t len32;
+    std::memcpy(&len32, buffer_.data() + begin_, sizeof(len32));
+    begin_ += sizeof(len32);
+    size_t len = ntohl(len32);
+    common::BufferPool::shared().resize(frame, len);
+
+    size_t got = std::min(len, buffered());
+    if (got > 0) {
+        std::memcpy(frame.data(), buffer_.data() + begin_, got);
+        begin_ += got;
+        if (hasher) hasher->update(frame.data(), got);
+    }
+    // The rest goes straight into the frame; a short remainder through the
+    // buffer, so the start of the next frame comes with it.
+    while (got < len) {
+        size_t want = len - got;
+        if (want < kBufferSize / 2) {
+            if (!fill(fd)) return false;
+            size_t take = std::min(want, buffered());
+            std::memcpy(frame.data() + got, buffer_.data() + begin_, take);
+            begin_ += take;
+            if (hasher) hasher->update(frame.data() + got, take);
+            got += take;
+            continue;
+        }
+        common::countSyscalls();
+        ssize_t n = ::recv(fd, frame.data() + got, want, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (hasher) hasher->update(frame.data() + got, static_cast<size_t>(n));
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+namespace {
+std::atomic<int> bufferBytes{0};
+}
+
+void setSocketBufferBytes(int bytes) {
+    bufferBytes = bytes > 0 ? bytes : 0;
+}
+
+int socketBufferBytes() {
+    return bufferBytes;
+}
+
+void configureSocket(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int bytes = bufferBytes;
+    if (bytes > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    }
+}
+
+}  // namespace network
+}  // namespace dfs
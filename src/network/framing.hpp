@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common/sha256.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dfs {
+namespace network {
+
+// One piece of a frame's body. A frame can be sent from several without
+// joining them first, such as a request header and the chunk it carries.
+struct IoSlice {
+    const uint8_t* data;
+    size_t len;
+};
+
+// Sends the 4-byte big-endian length prefix and `parts` as one frame on a
+// blocking socket: one sendmsg(2) unless the socket takes less. `flags` is
+// added to MSG_NOSIGNAL, e.g. MSG_MORE when a sendfile(2) follows.
+bool sendFrame(int fd, const IoSlice* parts, size_t count, int flags = 0);
+
+// Reads length-prefixed frames from a blocking socket through a buffer kept
+// across calls. A small frame costs one recv(2) for prefix and body
+// together, and frames that arrived back to back cost none; bodies larger
+// than the buffer are read straight into the caller's vector.
+class FrameReader {
+public:
+    // Reads the next frame into `frame`, reusing its capacity. `hasher`, if
+    // given, sees the body as it arrives. False on EOF or error.
+    bool read(int fd, std::vector<uint8_t>& frame, common::Sha256* hasher = nullptr);
+    // Bytes received but not yet returned in a frame.
+    size_t buffered() const { return end_ - begin_; }
+
+private:
+    static constexpr size_t kBufferSize = 64 * 1024;
+
+    // Receives at least one more byte into the buffer.
+    bool fill(int fd);
+
+    std::vector<uint8_t> buffer_;
+    size_t begin_{0};
+    size_t end_{0};
+};
+
+// Send and receive buffer size for sockets configureSocket() sets up from
+// now on. 0, the default, leaves them to the kernel's autotuning, which
+// does as well on loopback and LANs; a fixed size helps on links whose
+// bandwidth-delay product exceeds the autotuning limits. The kernel caps it
+// at net.core.wmem_max / rmem_max.
+void setSocketBufferBytes(int bytes);
+int socketBufferBytes();
+
+// TCP_NODELAY, and the socket buffer size if one is set. Call before
+// connect(2) or listen(2), so the window scale covers the buffer; accepted
+// sockets inherit the buffer sizes.
+void configureSocket(int fd);
+
+}  // namespace network
+}  // namespace dfs
@@ -0,0 +1,109 @@
+#include "network/multiplexed_client.hpp"
+#include "network/protocol.hpp"
+#include <condition_variable>
+#include <memory>
+
+namespace dfs {
+namespace network {
+
+MultiplexedClient::~MultiplexedClient() {
+    close();
+}
+
+bool MultiplexedClient::connect(const std::string& ip, int port) {
+    close();
+    if (!conn_.connect(ip, port)) return false;
+    connected_ = true;
+    reader_ = std::thread([this]() { readLoop(); });
+    return true;
+}
+
+void MultiplexedClient::close() {
+    conn_.abort();
+    if (reader_.joinable()) reader_.join();
+    conn_.close();
+}
+
+bool MultiplexedClient::send(const std::vector<uint8_t>& request, Callback done, const uint8_t* body, size_t len) {
+    MessageHeader header;
+    if (!parseHeader(request, header) || header.payloadLength != request.size() - kHeaderSize + len) return false;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        if (!connected_ || !pending_.emplace(header.requestId, std::move(done)).second) return false;
+    }
+    bool sent;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        sent = len > 0 ? conn_.sendData(request, body, len) : conn_.sendData(request);
+    }
+    if (sent) return true;
+    // A partial frame leaves the stream unusable: fail everything. If the
+    // reader got there first, `done` has already been told.
+    size_t erased;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        erased = pending_.erase(header.requestId);
+    }
+    conn_.abort();
+    return erased == 0;
+}
+
+std::vector<uint8_t> MultiplexedClient::call(const std::vector<uint8_t>& request, const uint8_t* body, size_t len) {
+    struct Result {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done{false};
+        std::vector<uint8_t> response;
+    };
+    auto result = std::make_shared<Result>();
+    bool sent = send(
+        request,
+        [result](bool, std::vector<uint8_t> response) {
+            std::lock_guard<std::mutex> lock(result->mutex);
+            result->response = std::move(response);
+            result->done = true;
+            result->cv.notify_one();
+        },
+        body, len);
+    if (!sent) return {};
+    std::unique_lock<std::mutex> lock(result->mutex);
+    result->cv.wait(lock, [&]() { return result->done; });
+    return std::move(result->response);
+}
+
+size_t MultiplexedClient::inFlight() {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    return pending_.size();
+}
+
+void MultiplexedClient::readLoop() {
+    while (true) {
+        std::vector<uint8_t> frame = conn_.recvData();
+        MessageHeader header;
+        MessageReader payload;
+        if (!parseMessage(frame, header, payload) || !(header.flags & kFlagResponse)) break;
+        Callback done;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            auto it = pending_.find(header.requestId);
+            if (it == pending_.end()) continue;
+            done = std::move(it->second);
+            pending_.erase(it);
+        }
+        done(true, std::move(frame));
+    }
+    failAll();
+}
+
+void MultiplexedClient::failAll() {
+    std::unordered_map<uint64_t, Callback> failed;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        connected_ = false;
+        failed.swap(pending_);
+    }
+    for (auto& entry : failed) entry.second(false, {});
+}
+
+}  // namespace network
+}  // namespace dfs
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "network/tcp_client.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace dfs {
+namespace network {
+
+// One connection carrying any number of binary requests at once. Callers on
+// any thread send requests flagged kFlagMultiplexed; a reader thread matches
+// each response to its request by id, so responses may arrive in any order.
+// When the connection fails every outstanding request fails with it.
+class MultiplexedClient {
+public:
+    // Receives the response frame, or ok == false and an empty frame if the
+    // connection failed first. Runs on the reader thread, so it must not
+    // block on other requests of this connection.
+    using Callback = std::function<void(bool ok, std::vector<uint8_t> response)>;
+
+    MultiplexedClient() = default;
+    ~MultiplexedClient();
+    MultiplexedClient(const MultiplexedClient&) = delete;
+    MultiplexedClient& operator=(const MultiplexedClient&) = delete;
+
+    bool connect(const std::string& ip, int port);
+    // Fails what is still in flight; not to be called from a Callback.
+    void close();
+    bool isConnected() const { return connected_; }
+    // An id not used by any other request on this connection.
+    uint64_t nextRequestId() { return nextId_++; }
+    // Sends `request` (finished with `len` trailing bytes), followed by len
+    // bytes of `body` in the same frame, and calls `done` with its response.
+    // False if it could not be sent; `done` is then not called.
+    bool send(const std::vector<uint8_t>& request, Callback done, const uint8_t* body = nullptr, size_t len = 0);
+    // send() and wait: the response frame, empty on failure.
+    std::vector<uint8_t> call(const std::vector<uint8_t>& request, const uint8_t* body = nullptr, size_t len = 0);
+    size_t inFlight();
+
+private:
+    void readLoop();
+    // Marks the connection failed and fails every outstanding request.
+    void failAll();
+
+    TCPClient conn_;
+    std::mutex sendMutex_;
+    std::mutex pendingMutex_;
+    std::unordered_map<uint64_t, Callback> pending_;
+    std::atomic<bool> connected_{false};
+    std::atomic<uint64_t> nextId_{1};
+    std::thread reader_;
+};
+
+}  // namespace network
+}  // namespace dfs
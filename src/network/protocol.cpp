@@ -0,0 +1,238 @@
+#include "network/protocol.hpp"
+#include <cstring>
+#include <sstream>
+
+namespace dfs {
+namespace network {
+
+MessageWriter::MessageWriter(Opcode opcode, uint64_t requestId, uint16_t flags) {
+    buffer_.reserve(64);
+    u32(kProtocolMagic);
+    u8(kProtocolVersion);
+    u8(static_cast<uint8_t>(opcode));
+    u16(flags);
+    u64(requestId);
+    u32(0);
+}
+
+MessageWriter MessageWriter::response(const MessageHeader& request, Status status) {
+    MessageWriter writer(request.opcode, request.requestId, kFlagResponse);
+    writer.u8(static_cast<uint8_t>(status));
+    return writer;
+}
+
+MessageWriter& MessageWriter::u8(uint8_t value) {
+    buffer_.push_back(value);
+    return *this;
+}
+
+MessageWriter& MessageWriter::u16(uint16_t value) {
+    return u8(static_cast<uint8_t>(value >> 8)).u8(static_cast<uint8_t>(value));
+}
+
+MessageWriter& MessageWriter::u32(uint32_t value) {
+    return u16(static_cast<uint16_t>(value >> 16)).u16(static_cast<uint16_t>(value));
+}
+
+MessageWriter& MessageWriter::u64(uint64_t value) {
+    return u32(static_cast<uint32_t>(value >> 32)).u32(static_cast<uint32_t>(value));
+}
+
+MessageWriter& MessageWriter::digest(const common::Digest& value) {
+    return bytes(value.bytes.data(), common::Digest::kSize);
+}
+
+MessageWriter& MessageWriter::bytes(const uint8_t* data, size_t len) {
+    buffer_.insert(buffer_.end(), data, data + len);
+    return *this;
+}
+
+MessageWriter& MessageWriter::string(const std::string& value) {
+    // Longer strings are cut off rather than corrupting the framing.
+    uint16_t len = static_cast<uint16_t>(value.size() < 0xffff ? value.size() : 0xffff);
+    u16(len);
+    return bytes(reinterpret_cast<const uint8_t*>(value.data()), len);
+}
+
+std::vector<uint8_t> MessageWriter::finish(size_t trailing) {
+    uint32_t payload = static_cast<uint32_t>(buffer_.size() - kHeaderSize + trailing);
+    for (int i = 0; i < 4; ++i) buffer_[kHeaderSize - 4 + i] = static_cast<uint8_t>(payload >> (24 - 8 * i));
+    return std::move(buffer_);
+}
+
+bool MessageReader::take(size_t len, const uint8_t*& at) {
+    if (!ok_ || left_ < len) {
+        ok_ = false;
+        return false;
+    }
+    at = data_;
+    data_ += len;
+    left_ -= len;
+    return true;
+}
+
+bool MessageReader::u8(uint8_t& value) {
+    const uint8_t* at;
+    if (!take(1, at)) return false;
+    value = at[0];
+    return true;
+}
+
+bool MessageReader::u16(uint16_t& value) {
+    const uint8_t* at;
+    if (!take(2, at)) return false;
+    value = static_cast<uint16_t>(at[0] << 8 | at[1]);
+    return true;
+}
+
+bool MessageReader::u32(uint32_t& value) {
+    const uint8_t* at;
+    if (!take(4, at)) return false;
+    value = static_cast<uint32_t>(at[0]) << 24 | static_cast<uint32_t>(at[1]) << 16 |
+            static_cast<uint32_t>(at[2]) << 8 | at[3];
+    return true;
+}
+
+bool MessageReader::u64(uint64_t& value) {
+    uint32_t high, low;
+    if (!u32(high) || !u32(low)) return false;
+    value = static_cast<uint64_t>(high) << 32 | low;
+    return true;
+}
+
+bool MessageReader::digest(common::Digest& value) {
+    const uint8_t* at;
+    if (!take(common::Digest::kSize, at)) return false;
+    std::memcpy(value.bytes.data(), at, common::Digest::kSize);
+    return true;
+}
+
+bool MessageReader::bytes(const uint8_t*& data, size_t len) {
+    return take(len, data);
+}
+
+bool MessageReader::string(std::string& value) {
+    uint16_t len;
+    const uint8_t* at;
+    if (!u16(len) || !take(len, at)) return false;
+    value.assign(reinterpret_cast<const char*>(at), len);
+    return true;
+}
+
+bool isBinaryFrame(const std::vector<uint8_t>& frame) {
+    return frame.size() >= kHeaderSize && frame[0] == 'D' && frame[1] == 'F' && frame[2] == 'S' && frame[3] == 'B';
+}
+
+bool parseHeader(const std::vector<uint8_t>& frame, MessageHeader& header) {
+    if (!isBinaryFrame(frame)) return false;
+    MessageReader reader(frame.data() + 4, kHeaderSize - 4);
+    uint8_t opcode;
+    reader.u8(header.version);
+    reader.u8(opcode);
+    reader.u16(header.flags);
+    reader.u64(header.requestId);
+    reader.u32(header.payloadLength);
+    header.opcode = static_cast<Opcode>(opcode);
+    return reader.ok() && header.version == kProtocolVersion;
+}
+
+bool parseMessage(const std::vector<uint8_t>& frame, MessageHeader& header, MessageReader& payload) {
+    if (!parseHeader(frame, header) || header.payloadLength != frame.size() - kHeaderSize) return false;
+    payload = MessageReader(frame.data() + kHeaderSize, header.payloadLength);
+    return true;
+}
+
+bool parseResponse(const std::vector<uint8_t>& frame, Opcode opcode, uint64_t requestId, Status& status,
+                   MessageReader& payload) {
+    MessageHeader header;
+    uint8_t code;
+    if (!parseMessage(frame, header, payload) || !(header.flags & kFlagResponse) || header.opcode != opcode ||
+        header.requestId != requestId || !payload.u8(code)) {
+        return false;
+    }
+    status = static_cast<Status>(code);
+    return true;
+}
+
+void writeFileMetadata(MessageWriter& writer, const common::FileMetadata& meta) {
+    writer.string(meta.filename)
+        .u64(static_cast<uint64_t>(meta.fileSize))
+        .u32(static_cast<uint32_t>(meta.chunkSize))
+        .u32(static_cast<uint32_t>(meta.chunkHashes.size()))
+        .digest(meta.rootHash);
+    for (const auto& hash : meta.chunkHashes) writer.digest(hash);
+    if (meta.chunkSize == 0) {
+        for (uint32_t size : meta.chunkSizes) writer.u32(size);
+    }
+}
+
+bool readFileMetadata(MessageReader& reader, common::FileMetadata& meta) {
+    uint64_t fileSize;
+    uint32_t chunkSize, count;
+    if (!reader.string(meta.filename) || !reader.u64(fileSize) || !reader.u32(chunkSize) || !reader.u32(count) ||
+        !reader.digest(meta.rootHash)) {
+        return false;
+    }
+    // Each chunk needs at least its digest; reject counts the payload cannot hold.
+    if (count > reader.remaining() / common::Digest::kSize) return false;
+    meta.fileSize = static_cast<int64_t>(fileSize);
+    meta.chunkSize = static_cast<int>(chunkSize);
+    meta.totalChunks = static_cast<int>(count);
+    meta.chunkHashes.resize(count);
+    for (auto& hash : meta.chunkHashes) reader.digest(hash);
+    meta.chunkSizes.clear();
+    if (chunkSize == 0) {
+        meta.chunkSizes.resize(count);
+        for (auto& size : meta.chunkSizes) reader.u32(size);
+    }
+    return reader.ok() && reader.remaining() == 0;
+}
+
+std::string formatTextMetadata(const common::FileMetadata& meta) {
+    std::string text = std::to_string(meta.fileSize) + " " + std::to_string(meta.chunkSize) + " " +
+                       std::to_string(meta.totalChunks) + " " + meta.rootHash.toHex() + " ";
+    text.reserve(text.size() + meta.chunkHashes.size() * (common::Digest::kSize * 2 + 1) +
+                 meta.chunkSizes.size() * 8);
+    for (size_t i = 0; i < meta.chunkHashes.size(); ++i) {
+        if (i > 0) text += ",";
+        text += meta.chunkHashes[i].toHex();
+    }
+    for (size_t i = 0; i < meta.chunkSizes.size(); ++i) {
+        text += (i == 0 ? " " : ",") + std::to_string(meta.chunkSizes[i]);
+    }
+    return text;
+}
+
+bool parseTextMetadata(const std::string& text, common::FileMetadata& meta) {
+    std::istringstream iss(text);
+    std::string rootHex, hashesStr, item;
+    if (!(iss >> meta.fileSize >> meta.chunkSize >> meta.totalChunks >> rootHex >> hashesStr) ||
+        !common::Digest::fromHex(rootHex, meta.rootHash)) {
+        return false;
+    }
+    meta.chunkHashes.clear();
+    std::istringstream hs(hashesStr);
+    while (std::getline(hs, item, ',')) {
+        if (item.empty()) continue;
+        common::Digest digest;
+        if (!common::Digest::fromHex(item, digest)) return false;
+        meta.chunkHashes.push_back(digest);
+    }
+    // Content-defined chunking (chunk size 0) appends the chunk lengths.
+    meta.chunkSizes.clear();
+    std::string sizesStr;
+    if (meta.chunkSize == 0) {
+        if (!(iss >> sizesStr)) return false;
+        std::istringstream ss(sizesStr);
+        while (std::getline(ss, item, ',')) {
+            if (item.empty()) continue;
+            if (item.size() > 9 || item.find_first_not_of("0123456789") != std::string::npos) return false;
+            meta.chunkSizes.push_back(static_cast<uint32_t>(std::stoul(item)));
+        }
+        if (meta.chunkSizes.size() != meta.chunkHashes.size()) return false;
+    }
+    return true;
+}
+
+}  // namespace network
+}  // namespace dfs
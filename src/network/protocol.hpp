@@ -0,0 +1,149 @@
+#pragma once
+
+#include "common/digest.hpp"
+#include "common/file_metadata.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dfs {
+namespace network {
+
+// Formats a client can speak. Nodes accept both on any connection and
+// answer in the format of the request: a frame that starts with
+// kProtocolMagic is binary, anything else is a text command.
+enum class WireFormat { TEXT, BINARY };
+
+// A binary message is one length-prefixed frame holding a fixed header and
+// the opcode's payload. Integers are big-endian, digests raw 32 bytes:
+//   magic u32 | version u8 | opcode u8 | flags u16 | request id u64 | payload length u32
+constexpr uint32_t kProtocolMagic = 0x44465342;  // "DFSB"
+constexpr uint8_t kProtocolVersion = 1;
+constexpr size_t kHeaderSize = 20;
+// Responses echo the request's opcode and id, set this flag, and start
+// their payload with a Status byte.
+constexpr uint16_t kFlagResponse = 0x1;
+// A multiplexed request is self-contained and may be answered out of order,
+// matched to its caller by request id: STORE carries the chunk after the
+// digest instead of waiting for READY, and a GET response carries the chunk
+// after the status instead of in a frame of its own. Requests in flight
+// together are not ordered against each other.
+constexpr uint16_t kFlagMultiplexed = 0x2;
+
+// Payloads (request -> response after the status byte):
+enum class Opcode : uint8_t {
+    STORE = 1,       // digest -> READY, then the chunk as a raw frame -> OK
+    GET = 2,         // digest -> OK, then the chunk as a raw frame; or NOT_FOUND
+    DELETE = 3,      // digest -> OK or NOT_FOUND
+    HAS = 4,         // digest -> OK or NOT_FOUND
+    HAS_MULTI = 5,   // u32 count, digests -> bitmap, digest i at bit 7 - i % 8 of byte i / 8
+    STATS = 6,       // -> "key=value ..." text
+    DIE = 7,
+    // u32 count, then per chunk: digest, u32 length, bytes -> one Status per chunk
+    STORE_MULTI = 8,
+    // u32 count, digests -> per digest a Status, and after OK a u32 length and the chunk
+    GET_MULTI = 9,
+    // digest, u64 offset, u32 length -> as GET, with the chunk's bytes from offset on, at most
+    // length of them; BAD_REQUEST for an offset at or past the chunk's end
+    GET_RANGE = 10,
+    PUT_META = 16,   // file metadata -> OK or FORWARD_FAILED
+    GET_META = 17,   // string filename -> file metadata; NOT_FOUND; or REDIRECT to the tail
+    PING = 18,
+};
+
+enum class Status : uint8_t {
+    OK = 0,
+    READY = 1,
+    NOT_FOUND = 2,
+    ERROR = 3,
+    BAD_REQUEST = 4,
+    REDIRECT = 5,
+    FORWARD_FAILED = 6,
+};
+
+// Chunk bytes one STORE_MULTI may carry, and one GET_MULTI response returns;
+// a GET_MULTI answers ERROR for chunks past it, to be fetched on their own.
+constexpr size_t kMaxBatchBytes = 16 * 1024 * 1024;
+
+struct MessageHeader {
+    uint8_t version{kProtocolVersion};
+    Opcode opcode{Opcode::PING};
+    uint16_t flags{0};
+    uint64_t requestId{0};
+    uint32_t payloadLength{0};
+};
+
+// Builds one binary message; finish() fills in the payload length, which
+// also counts `trailing` bytes the caller sends in the same frame after the
+// message, such as a chunk. Strings are u16 length-prefixed.
+class MessageWriter {
+public:
+    explicit MessageWriter(Opcode opcode, uint64_t requestId = 0, uint16_t flags = 0);
+    // A response to `request`, its payload starting with `status`.
+    static MessageWriter response(const MessageHeader& request, Status status);
+
+    MessageWriter& u8(uint8_t value);
+    MessageWriter& u16(uint16_t value);
+    MessageWriter& u32(uint32_t value);
+    MessageWriter& u64(uint64_t value);
+    MessageWriter& digest(const common::Digest& value);
+    MessageWriter& bytes(const uint8_t* data, size_t len);
+    MessageWriter& string(const std::string& value);
+    std::vector<uint8_t> finish(size_t trailing = 0);
+
+private:
+    std::vector<uint8_t> buffer_;
+};
+
+// Reads a payload front to back. A read past the end fails, and every read
+// after it fails too, so a decoder can check ok() once at the end.
+class MessageReader {
+public:
+    MessageReader() = default;
+    MessageReader(const uint8_t* data, size_t len) : data_(data), left_(len) {}
+
+    bool u8(uint8_t& value);
+    bool u16(uint16_t& value);
+    bool u32(uint32_t& value);
+    bool u64(uint64_t& value);
+    bool digest(common::Digest& value);
+    // Points `data` at the next len bytes of the payload without copying.
+    bool bytes(const uint8_t*& data, size_t len);
+    bool string(std::string& value);
+    size_t remaining() const { return left_; }
+    bool ok() const { return ok_; }
+
+private:
+    bool take(size_t len, const uint8_t*& at);
+
+    const uint8_t* data_{nullptr};
+    size_t left_{0};
+    bool ok_{true};
+};
+
+// True if the frame starts with the binary magic.
+bool isBinaryFrame(const std::vector<uint8_t>& frame);
+// Decodes the header of a binary message without checking that the payload
+// follows; false for text frames and other versions.
+bool parseHeader(const std::vector<uint8_t>& frame, MessageHeader& header);
+// Decodes a binary frame's header and points `payload` at its payload;
+// false for text frames, other versions and inconsistent lengths.
+bool parseMessage(const std::vector<uint8_t>& frame, MessageHeader& header, MessageReader& payload);
+// parseMessage() for a response to `opcode` / `requestId`, reading the status.
+bool parseResponse(const std::vector<uint8_t>& frame, Opcode opcode, uint64_t requestId, Status& status,
+                   MessageReader& payload);
+
+// File metadata in the binary format: string filename, u64 size, u32 chunk
+// size, u32 chunk count, root digest, chunk digests, and when chunk size is
+// 0 (content-defined) one u32 length per chunk.
+void writeFileMetadata(MessageWriter& writer, const common::FileMetadata& meta);
+bool readFileMetadata(MessageReader& reader, common::FileMetadata& meta);
+
+// The text format's "<size> <chunkSize> <totalChunks> <root> <h1>,<h2>,...
+// [<len1>,<len2>,...]" that follows "PUT <filename>" and "FOUND".
+std::string formatTextMetadata(const common::FileMetadata& meta);
+bool parseTextMetadata(const std::string& text, common::FileMetadata& meta);
+
+}  // namespace network
+}  // namespace dfs
@@ -26,6 +26,9 @@ bool TCPClient::connect(const std::string& ip, int port) {
     struct sockaddr_in addr {};
     addr.sin_family = AF_INET;
     addr.sin_port = htons(static_cast<uint16_t>(port));
+    // Pooled connections carry many small request/response frames, which
+    // must not wait on Nagle's algorithm.
+    configureSocket(sock_);
     if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0) {
         std::cerr << "Error: invalid address " << ip << std::endl;
         ::close(sock_);
@@ -39,39 +42,41 @@ bool TCPClient::connect(const std::string& ip, int port) {
         return false;
     }
     connected_ = true;
+    reader_ = FrameReader();
     return true;
 }
 
 bool TCPClient::sendData(const uint8_t* data, size_t len) {
     if (!connected_ || sock_ < 0) return false;
-    uint32_t len32 = htonl(static_cast<uint32_t>(len));
-    if (::send(sock_, &len32, 4, 0) != 4) return false;
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = ::send(sock_, data + sent, len - sent, 0);
-        if (n <= 0) return false;
-        sent += static_cast<size_t>(n);
-    }
-    return true;
+    IoSlice part{data, len};
+    return sendFrame(sock_, &part, 1);
 }
 
 bool TCPClient::sendData(const std::vector<uint8_t>& data) {
     return sendData(data.data(), data.size());
 }
 
+bool TCPClient::sendData(const std::vector<uint8_t>& head, const uint8_t* body, size_t len) {
+    if (!connected_ || sock_ < 0) return false;
+    IoSlice parts[2] = {{head.data(), head.size()}, {body, len}};
+    return sendFrame(sock_, parts, 2);
+}
+
 std::vector<uint8_t> TCPClient::recvData() {
+    return recvData(nullptr);
+}
+
+std::vector<uint8_t> TCPClient::recvData(common::Sha256& hasher) {
+    return recvData(&hasher);
+}
+
+bool TCPClient::recvData(std::vector<uint8_t>& frame) {
+    return connected_ && sock_ >= 0 && reader_.read(sock_, frame);
+}
+
+std::vector<uint8_t> TCPClient::recvData(common::Sha256* hasher) {
     std::vector<uint8_t> result;
-    if (!connected_ || sock_ < 0) return result;
-    uint32_t len32;
-    if (::recv(sock_, &len32, 4, MSG_WAITALL) != 4) return result;
-    size_t len = ntohl(len32);
-    result.resize(len);
-    size_t got = 0;
-    while (got < len) {
-        ssize_t n = ::recv(sock_, result.data() + got, len - got, 0);
-        if (n <= 0) return {};
-        got += static_cast<size_t>(n);
-    }
+    if (!connected_ || sock_ < 0 || !reader_.read(sock_, result, hasher)) return {};
     return result;
 }
 
@@ -80,9 +85,19 @@ bool TCPClient::sendMessage(const std::string& message) {
 }
 
 std::string TCPClient::recvMessage() {
-    auto data = recvData();
-    if (data.empty()) return "";
-    return std::string(data.begin(), data.end());
+    if (!recvData(scratch_)) return "";
+    return std::string(scratch_.begin(), scratch_.end());
+}
+
+bool TCPClient::isHealthy() const {
+    if (!connected_ || sock_ < 0 || reader_.buffered() > 0) return false;
+    uint8_t probe;
+    ssize_t n = ::recv(sock_, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void TCPClient::abort() {
+    if (connected_ && sock_ >= 0) ::shutdown(sock_, SHUT_RDWR);
 }
 
 void TCPClient::close() {
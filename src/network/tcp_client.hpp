@@ -1,5 +1,7 @@
 #pragma once
 
+#include "common/sha256.hpp"
+#include "network/framing.hpp"
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -17,15 +19,31 @@ public:
     bool connect(const std::string& ip, int port);
     bool sendData(const uint8_t* data, size_t len);
     bool sendData(const std::vector<uint8_t>& data);
+    // Sends `head` followed by len bytes of `body` as one frame.
+    bool sendData(const std::vector<uint8_t>& head, const uint8_t* body, size_t len);
     std::vector<uint8_t> recvData();
+    // Receives one frame, feeding each fragment to `hasher` as recv() returns
+    // it, so the caller gets the digest without another pass over the data.
+    std::vector<uint8_t> recvData(common::Sha256& hasher);
+    // Receives one frame into `frame`, reusing its capacity.
+    bool recvData(std::vector<uint8_t>& frame);
     bool sendMessage(const std::string& message);
     std::string recvMessage();
     void close();
+    // Shuts the socket down so an exchange blocked on it in another thread
+    // fails promptly; the owner still closes it.
+    void abort();
     bool isConnected() const { return connected_; }
+    // False if the peer closed the connection or left unread bytes on it.
+    bool isHealthy() const;
 
 private:
+    std::vector<uint8_t> recvData(common::Sha256* hasher);
+
     int sock_{-1};
     bool connected_{false};
+    FrameReader reader_;
+    std::vector<uint8_t> scratch_;  // recvMessage()'s frame
 };
 
 }  // namespace network
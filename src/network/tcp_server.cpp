@@ -1,14 +1,389 @@
 #include "network/tcp_server.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/io_stats.hpp"
+#include "common/io_uring.hpp"
+#include "common/thread_pool.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
 #include <iostream>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace dfs {
 namespace network {
 
-TCPServer::TCPServer() = default;
+namespace {
+
+constexpr size_t kMaxFrameSize = 64 * 1024 * 1024;
+constexpr size_t kMaxQueuedFrames = 8;
+constexpr size_t kMaxPendingWriteBytes = 8 * 1024 * 1024;
+constexpr size_t kReadBufferSize = 64 * 1024;
+constexpr int kMaxEvents = 256;
+constexpr uint64_t kListenTag = 0;
+constexpr uint64_t kWakeTag = ~0ULL;
+
+// io_uring loop: registered file slots 0 and 1 hold the listening socket and
+// the wake eventfd; accepted sockets take the rest. Reads of up to
+// kReadBufferSize land in one of kUringBuffers registered buffers.
+constexpr unsigned kUringEntries = 256;
+constexpr int kUringFiles = 1024;
+constexpr int kListenSlot = 0;
+constexpr int kWakeSlot = 1;
+constexpr int kUringBuffers = 64;
+
+// A completion's user data: the operation in the high half, the connection
+// id in the low half.
+enum UringOp : uint64_t { kAcceptOp = 1, kWakeOp, kReadOp, kPollOp, kCancelOp };
+
+uint64_t uringTag(UringOp op, int id) {
+    return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(id);
+}
+
+void setNoDelay(int fd) {
+    int one = 1;
+    common::countSyscalls();
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// sendfile(2) has no MSG_NOSIGNAL, so a peer reset would raise SIGPIPE and
+// kill the process. Keeps SIGPIPE blocked on this thread while in scope and
+// swallows one that the guarded calls raised.
+class SigpipeGuard {
+public:
+    SigpipeGuard() {
+        sigemptyset(&pipeSet_);
+        sigaddset(&pipeSet_, SIGPIPE);
+        sigset_t pending;
+        sigpending(&pending);
+        wasPending_ = sigismember(&pending, SIGPIPE) == 1;
+        pthread_sigmask(SIG_BLOCK, &pipeSet_, &oldMask_);
+    }
+    ~SigpipeGuard() {
+        if (!wasPending_) {
+            sigset_t pending;
+            sigpending(&pending);
+            if (sigismember(&pending, SIGPIPE) == 1) {
+                struct timespec zero {};
+                sigtimedwait(&pipeSet_, nullptr, &zero);
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &oldMask_, nullptr);
+    }
+    SigpipeGuard(const SigpipeGuard&) = delete;
+    SigpipeGuard& operator=(const SigpipeGuard&) = delete;
+
+private:
+    sigset_t pipeSet_;
+    sigset_t oldMask_;
+    bool wasPending_{false};
+};
+
+}  // namespace
+
+Connection::Outbound::Outbound(Outbound&& other) noexcept
+    : bytes(std::move(other.bytes)),
+      fileFd(other.fileFd),
+      fileOffset(other.fileOffset),
+      fileLength(other.fileLength) {
+    other.fileFd = -1;
+}
+
+Connection::Outbound::~Outbound() {
+    if (fileFd >= 0) ::close(fileFd);
+}
+
+Connection::Connection(int id, int fd, bool queued) : id_(id), fd_(fd), queued_(queued) {}
+
+Connection::~Connection() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool Connection::sendData(const uint8_t* data, size_t len) {
+    return queued_ ? sendQueued(nullptr, data, len) : sendBlocking(nullptr, data, len);
+}
+
+bool Connection::sendData(const std::vector<uint8_t>& data) {
+    return sendData(data.data(), data.size());
+}
+
+bool Connection::sendData(const std::vector<uint8_t>& head, const uint8_t* body, size_t len) {
+    return queued_ ? sendQueued(&head, body, len) : sendBlocking(&head, body, len);
+}
+
+bool Connection::sendMessage(const std::string& message) {
+    return sendData(reinterpret_cast<const uint8_t*>(message.data()), message.size());
+}
+
+bool Connection::sendFile(int fd, uint64_t offset, size_t len, const std::vector<uint8_t>& head) {
+    return queued_ ? sendFileQueued(head, fd, offset, len) : sendFileBlocking(head, fd, offset, len);
+}
+
+bool Connection::sendBlocking(const std::vector<uint8_t>* head, const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (broken_) return false;
+    IoSlice parts[2] = {{head ? head->data() : nullptr, head ? head->size() : 0}, {data, len}};
+    return sendFrame(fd_, parts, 2);
+}
+
+bool Connection::sendQueued(const std::vector<uint8_t>* head, const uint8_t* data, size_t len) {
+    std::unique_lock<std::mutex> lock(sendMutex_);
+    sendCv_.wait(lock, [&]() { return broken_ || outBytes_ < kMaxPendingWriteBytes; });
+    if (broken_) return false;
+
+    size_t headLen = head ? head->size() : 0;
+    uint32_t len32 = htonl(static_cast<uint32_t>(headLen + len));
+    // Length prefix, head, payload: sent and queued as one frame.
+    struct Part {
+        const uint8_t* bytes;
+        size_t len;
+    };
+    const Part parts[3] = {{reinterpret_cast<const uint8_t*>(&len32), sizeof(len32)},
+                           {head ? head->data() : nullptr, headLen},
+                           {data, len}};
+    size_t total = sizeof(len32) + headLen + len;
+    size_t sent = 0;
+    if (outbox_.empty()) {
+        // Fast path: hand all parts to the kernel in one call.
+        while (sent < total) {
+            struct iovec iov[3];
+            int iovcnt = 0;
+            size_t skip = sent;
+            for (const Part& part : parts) {
+                if (skip >= part.len) {
+                    skip -= part.len;
+                    continue;
+                }
+                iov[iovcnt].iov_base = const_cast<uint8_t*>(part.bytes) + skip;
+                iov[iovcnt].iov_len = part.len - skip;
+                ++iovcnt;
+                skip = 0;
+            }
+            struct msghdr msg {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = static_cast<size_t>(iovcnt);
+            common::countSyscalls();
+            ssize_t n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                broken_ = true;
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        if (sent == total) return true;
+    }
+
+    // The socket buffer is full: keep the rest until the socket is writable.
+    bool wasEmpty = outbox_.empty();
+    std::vector<uint8_t> rest;
+    rest.reserve(total - sent);
+    size_t skip = sent;
+    for (const Part& part : parts) {
+        if (skip >= part.len) {
+            skip -= part.len;
+            continue;
+        }
+        rest.insert(rest.end(), part.bytes + skip, part.bytes + part.len);
+        skip = 0;
+    }
+    Outbound entry;
+    entry.bytes = std::move(rest);
+    outBytes_ += entry.size();
+    outbox_.push_back(std::move(entry));
+    if (wasEmpty && onOutboxBlocked_) onOutboxBlocked_();
+    return true;
+}
+
+// The length prefix and head go out with the file bytes in one frame.
+static std::vector<uint8_t> framePrefix(const std::vector<uint8_t>& head, size_t fileLen) {
+    uint32_t len32 = htonl(static_cast<uint32_t>(head.size() + fileLen));
+    std::vector<uint8_t> prefix(sizeof(len32) + head.size());
+    std::memcpy(prefix.data(), &len32, sizeof(len32));
+    if (!head.empty()) std::memcpy(prefix.data() + sizeof(len32), head.data(), head.size());
+    return prefix;
+}
+
+bool Connection::sendFileBlocking(const std::vector<uint8_t>& head, int fd, uint64_t offset, size_t len) {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (broken_) return false;
+    // MSG_MORE holds the prefix back so it leaves in the first data segment.
+    std::vector<uint8_t> prefix = framePrefix(head, len);
+    size_t prefixSent = 0;
+    while (prefixSent < prefix.size()) {
+        common::countSyscalls();
+        ssize_t n = ::send(fd_, prefix.data() + prefixSent, prefix.size() - prefixSent, MSG_NOSIGNAL | MSG_MORE);
+        if (n <= 0) return false;
+        prefixSent += static_cast<size_t>(n);
+    }
+    SigpipeGuard guard;
+    off_t pos = static_cast<off_t>(offset);
+    size_t sent = 0;
+    while (sent < len) {
+        common::countSyscalls();
+        ssize_t n = ::sendfile(fd_, fd, &pos, len - sent);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool Connection::sendFileQueued(const std::vector<uint8_t>& head, int fd, uint64_t offset, size_t len) {
+    std::unique_lock<std::mutex> lock(sendMutex_);
+    sendCv_.wait(lock, [&]() { return broken_ || outBytes_ < kMaxPendingWriteBytes; });
+    if (broken_) return false;
+
+    std::vector<uint8_t> prefix = framePrefix(head, len);
+    size_t headerSent = 0;
+    size_t bodySent = 0;
+    if (outbox_.empty()) {
+        while (headerSent < prefix.size()) {
+            common::countSyscalls();
+            ssize_t n = ::send(fd_, prefix.data() + headerSent, prefix.size() - headerSent, MSG_NOSIGNAL | MSG_MORE);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                broken_ = true;
+                return false;
+            }
+            headerSent += static_cast<size_t>(n);
+        }
+        if (headerSent == prefix.size()) {
+            SigpipeGuard guard;
+            off_t pos = static_cast<off_t>(offset);
+            while (bodySent < len) {
+                common::countSyscalls();
+                ssize_t n = ::sendfile(fd_, fd, &pos, len - bodySent);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                    broken_ = true;
+                    return false;
+                }
+                if (n == 0) {
+                    // The file is shorter than the frame promised.
+                    broken_ = true;
+                    return false;
+                }
+                bodySent += static_cast<size_t>(n);
+            }
+            if (bodySent == len) return true;
+        }
+    }
+
+    // Queue the rest with a descriptor of its own, since the caller's may be
+    // closed before the socket becomes writable.
+    bool wasEmpty = outbox_.empty();
+    int owned = ::dup(fd);
+    if (owned < 0) {
+        broken_ = true;
+        return false;
+    }
+    if (headerSent < prefix.size()) {
+        Outbound header;
+        header.bytes.assign(prefix.begin() + static_cast<std::ptrdiff_t>(headerSent), prefix.end());
+        outBytes_ += header.size();
+        outbox_.push_back(std::move(header));
+    }
+    Outbound body;
+    body.fileFd = owned;
+    body.fileOffset = offset + bodySent;
+    body.fileLength = len - bodySent;
+    outBytes_ += body.size();
+    outbox_.push_back(std::move(body));
+    if (wasEmpty && onOutboxBlocked_) onOutboxBlocked_();
+    return true;
+}
+
+bool Connection::flushQueued() {
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    while (!outbox_.empty() && !broken_) {
+        Outbound& front = outbox_.front();
+        ssize_t n;
+        common::countSyscalls();
+        if (front.fileFd >= 0) {
+            SigpipeGuard guard;
+            off_t pos = static_cast<off_t>(front.fileOffset + outOffset_);
+            n = ::sendfile(fd_, front.fileFd, &pos, front.fileLength - outOffset_);
+        } else {
+            n = ::send(fd_, front.bytes.data() + outOffset_, front.bytes.size() - outOffset_, MSG_NOSIGNAL);
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            broken_ = true;
+            break;
+        }
+        if (n == 0) {
+            broken_ = true;
+            break;
+        }
+        outOffset_ += static_cast<size_t>(n);
+        outBytes_ -= static_cast<size_t>(n);
+        if (outOffset_ == front.size()) {
+            outbox_.pop_front();
+            outOffset_ = 0;
+        }
+    }
+    if (broken_) {
+        outbox_.clear();
+        outBytes_ = 0;
+    }
+    sendCv_.notify_all();
+    return !outbox_.empty();
+}
+
+void Connection::markBroken() {
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        broken_ = true;
+        outbox_.clear();
+        outBytes_ = 0;
+    }
+    sendCv_.notify_all();
+}
+
+std::vector<uint8_t> Connection::recvData() {
+    std::vector<uint8_t> frame;
+    if (!recvData(frame)) return {};
+    return frame;
+}
+
+bool Connection::recvData(std::vector<uint8_t>& frame) {
+    frameDigest_ = common::Digest();
+    if (queued_) return false;
+    bool hashing = hashNext_.exchange(false);
+    common::Sha256 hasher;
+    if (!reader_.read(fd_, frame, hashing ? &hasher : nullptr)) return false;
+    if (hashing) frameDigest_ = hasher.final();
+    return true;
+}
+
+std::string Connection::recvMessage() {
+    auto data = recvData();
+    if (data.empty()) return "";
+    return std::string(data.begin(), data.end());
+}
+
+TCPServer::TCPServer() : table_(std::make_shared<const ConnectionTable>()) {}
 
 TCPServer::~TCPServer() {
     stop();
@@ -36,7 +411,9 @@ bool TCPServer::start(int port) {
         serverSock_ = -1;
         return false;
     }
-    if (listen(serverSock_, 50) < 0) {
+    // Accepted sockets inherit the buffer sizes.
+    configureSocket(serverSock_);
+    if (listen(serverSock_, SOMAXCONN) < 0) {
         ::close(serverSock_);
         serverSock_ = -1;
         return false;
@@ -45,58 +422,637 @@ bool TCPServer::start(int port) {
     return true;
 }
 
+std::shared_ptr<const TCPServer::ConnectionTable> TCPServer::snapshot() const {
+    return std::atomic_load(&table_);
+}
+
+void TCPServer::publish(const std::shared_ptr<Connection>& added, int removedId) {
+    std::lock_guard<std::mutex> lock(tableMutex_);
+    auto next = std::make_shared<ConnectionTable>(*std::atomic_load(&table_));
+    if (added) (*next)[added->id()] = added;
+    if (removedId > 0) next->erase(removedId);
+    std::atomic_store(&table_, std::shared_ptr<const ConnectionTable>(std::move(next)));
+}
+
+std::shared_ptr<Connection> TCPServer::connection(int clientId) const {
+    auto table = snapshot();
+    auto it = table->find(clientId);
+    if (it == table->end()) return nullptr;
+    return it->second;
+}
+
 int TCPServer::acceptClient() {
     if (!running_ || serverSock_ < 0) return -1;
     int clientSock = accept(serverSock_, nullptr, nullptr);
     if (clientSock < 0) {
-        std::cerr << "Error: accept failed" << std::endl;
+        if (running_) std::cerr << "Error: accept failed" << std::endl;
         return -1;
     }
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    int id = nextClientId_++;
-    clients_[id] = SocketContext{clientSock, true};
-    return id;
+    setNoDelay(clientSock);
+    std::shared_ptr<Connection> conn(new Connection(nextClientId_++, clientSock, false));
+    publish(conn, 0);
+    return conn->id();
 }
 
-bool TCPServer::sendData(int clientId, const uint8_t* data, size_t len) {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    auto it = clients_.find(clientId);
-    if (it == clients_.end() || !it->second.valid) return false;
-    int sock = it->second.socket;
-    uint32_t len32 = htonl(static_cast<uint32_t>(len));
-    if (::send(sock, &len32, 4, 0) != 4) return false;
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = ::send(sock, data + sent, len - sent, 0);
-        if (n <= 0) return false;
-        sent += static_cast<size_t>(n);
+bool TCPServer::runEventLoop(const FrameHandler& onFrame, const CloseHandler& onClose, size_t workerThreads,
+                             ServerMode mode) {
+    if (!running_ || serverSock_ < 0) return false;
+    if (!setNonBlocking(serverSock_)) return false;
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        std::cerr << "Error: failed to create event loop" << std::endl;
+        shutdownReactor();
+        return false;
+    }
+    bool uring = mode == ServerMode::URING && initUring();
+    if (mode == ServerMode::URING && !uring) std::cerr << "io_uring unavailable, falling back to epoll" << std::endl;
+    if (!uring) {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd_ < 0) {
+            std::cerr << "Error: failed to create event loop" << std::endl;
+            shutdownReactor();
+            return false;
+        }
+        struct epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = kListenTag;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverSock_, &ev);
+        ev.events = EPOLLIN;
+        ev.data.u64 = kWakeTag;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+    }
+
+    onFrame_ = onFrame;
+    onClose_ = onClose;
+    readBuffer_.resize(kReadBufferSize);
+    workers_.reset(new common::ThreadPool(workerThreads));
+    reactorActive_ = true;
+    if (uring) {
+        runUringLoop();
+        shutdownReactor();
+        uringConns_.clear();
+        ring_.reset();
+        return true;
+    }
+
+    struct epoll_event events[kMaxEvents];
+    while (running_) {
+        common::countSyscalls();
+        int n = epoll_wait(epollFd_, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: epoll_wait failed" << std::endl;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == kListenTag) {
+                acceptPending();
+                continue;
+            }
+            if (tag == kWakeTag) {
+                uint64_t count;
+                do {
+                    common::countSyscalls();
+                } while (::read(wakeFd_, &count, sizeof(count)) > 0);
+                std::deque<int> resumed;
+                {
+                    std::lock_guard<std::mutex> lock(resumeMutex_);
+                    resumed.swap(resumeQueue_);
+                }
+                for (int id : resumed) {
+                    auto conn = connection(id);
+                    if (conn) readFrames(conn);
+                }
+                continue;
+            }
+            auto conn = connection(static_cast<int>(tag));
+            if (!conn) continue;
+            if (events[i].events & EPOLLOUT) conn->flushQueued();
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readFrames(conn);
+        }
     }
+    shutdownReactor();
     return true;
 }
 
-bool TCPServer::sendData(int clientId, const std::vector<uint8_t>& data) {
-    return sendData(clientId, data.data(), data.size());
+void TCPServer::acceptPending() {
+    while (running_) {
+        common::countSyscalls();
+        int clientSock = accept4(serverSock_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) std::cerr << "Error: accept failed" << std::endl;
+            return;
+        }
+        setNoDelay(clientSock);
+        std::shared_ptr<Connection> conn(new Connection(nextClientId_++, clientSock, true));
+        publish(conn, 0);
+        struct epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = static_cast<uint64_t>(conn->id());
+        common::countSyscalls();
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, clientSock, &ev) < 0) {
+            releaseConnection(conn);
+        }
+    }
 }
 
-std::vector<uint8_t> TCPServer::recvData(int clientId) {
-    int sock = -1;
+bool TCPServer::initUring() {
+    std::unique_ptr<common::IoUring> ring(new common::IoUring());
+    if (!ring->init(kUringEntries, sqpoll_)) return false;
+
+    // Without registered files or buffers the loop still works, by
+    // descriptor and through per-connection buffers.
+    std::vector<int> files(kUringFiles, -1);
+    files[kListenSlot] = serverSock_;
+    files[kWakeSlot] = wakeFd_;
+    fixedFiles_ = ring->registerFiles(files.data(), kUringFiles);
+    freeSlots_.clear();
+    if (fixedFiles_) {
+        for (int slot = kUringFiles - 1; slot > kWakeSlot; --slot) freeSlots_.push_back(slot);
+    }
+    fixedBuffers_.assign(kUringBuffers * kReadBufferSize, 0);
+    std::vector<struct iovec> buffers(kUringBuffers);
+    for (int i = 0; i < kUringBuffers; ++i) {
+        buffers[i].iov_base = fixedBuffers_.data() + i * kReadBufferSize;
+        buffers[i].iov_len = kReadBufferSize;
+    }
+    freeBuffers_.clear();
+    if (ring->registerBuffers(buffers.data(), kUringBuffers)) {
+        for (int i = kUringBuffers - 1; i >= 0; --i) freeBuffers_.push_back(i);
+    }
+    ring_ = std::move(ring);
+    uringInFlight_ = 0;
+    uringDraining_ = false;
+    return true;
+}
+
+void TCPServer::runUringLoop() {
+    postAccept();
+    postWakeRead();
+    while (running_) {
+        // One io_uring_enter both submits everything queued since the last
+        // pass and waits; none at all under SQPOLL while completions flow.
+        int ret = ring_->submit(ring_->ready() ? 0 : 1);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+            std::cerr << "Error: io_uring_enter failed" << std::endl;
+            break;
+        }
+        ring_->reap([this](uint64_t userData, int res, uint32_t) { uringCompleted(userData, res); });
+    }
+    drainUring();
+}
+
+void TCPServer::uringCompleted(uint64_t userData, int res) {
+    --uringInFlight_;
+    UringOp op = static_cast<UringOp>(userData >> 32);
+    int id = static_cast<int>(userData & 0xffffffffu);
+    if (op == kAcceptOp) {
+        if (res >= 0) {
+            if (uringDraining_) {
+                ::close(res);
+                return;
+            }
+            uringAccepted(res);
+        } else if (res != -EAGAIN && res != -EINTR && res != -ECONNABORTED) {
+            if (running_ && !uringDraining_) std::cerr << "Error: accept failed" << std::endl;
+            return;
+        }
+        if (running_ && !uringDraining_) postAccept();
+        return;
+    }
+    if (op == kWakeOp) {
+        if (uringDraining_) return;
+        std::deque<int> resumed;
+        std::deque<int> writable;
+        std::deque<int> retired;
+        {
+            std::lock_guard<std::mutex> lock(resumeMutex_);
+            resumed.swap(resumeQueue_);
+            writable.swap(writeQueue_);
+            retired.swap(retireQueue_);
+        }
+        for (int connId : resumed) {
+            auto it = uringConns_.find(connId);
+            if (it == uringConns_.end()) continue;
+            std::shared_ptr<Connection> conn = it->second;
+            postRead(conn);
+        }
+        for (int connId : writable) {
+            auto it = uringConns_.find(connId);
+            if (it == uringConns_.end()) continue;
+            std::shared_ptr<Connection> conn = it->second;
+            postWritePoll(conn);
+        }
+        for (int connId : retired) {
+            auto it = uringConns_.find(connId);
+            if (it == uringConns_.end()) continue;
+            std::shared_ptr<Connection> conn = it->second;
+            // Completes a read still waiting on a socket nobody reads anymore.
+            if (conn->readInFlight_) ::shutdown(conn->fd_, SHUT_RDWR);
+            retireIfIdle(conn);
+        }
+        if (running_) postWakeRead();
+        return;
+    }
+    if (op != kReadOp && op != kPollOp) return;
+
+    auto it = uringConns_.find(id);
+    if (it == uringConns_.end()) return;
+    std::shared_ptr<Connection> conn = it->second;
+    if (op == kPollOp) {
+        conn->pollInFlight_ = false;
+        if (!uringDraining_ && conn->flushQueued()) postWritePoll(conn);
+        retireIfIdle(conn);
+        return;
+    }
+
+    conn->readInFlight_ = false;
+    int buffer = conn->uringBuffer_;
+    const uint8_t* data =
+        buffer >= 0 ? fixedBuffers_.data() + static_cast<size_t>(buffer) * kReadBufferSize : conn->spill_.data();
+    bool oversized = false;
+    if (!uringDraining_ && res > 0) {
+        if (buffer == Connection::kInPlace) {
+            bodyReceived(conn, static_cast<size_t>(res));
+        } else {
+            oversized = !consumeBytes(conn, data, static_cast<size_t>(res));
+        }
+    }
+    if (buffer >= 0) freeBuffers_.push_back(buffer);
+    if (uringDraining_) {
+        retireIfIdle(conn);
+        return;
+    }
+    if (oversized) {
+        std::cerr << "Error: oversized frame from client " << conn->id() << std::endl;
+        closeClient(conn->id());
+    } else if (res > 0 || res == -EINTR || res == -EAGAIN) {
+        postRead(conn);
+    } else {
+        // Orderly shutdown or error: finish queued frames, then release.
+        bool release;
+        {
+            std::lock_guard<std::mutex> lock(conn->stateMutex_);
+            conn->peerClosed_ = true;
+            release = !conn->scheduled_;
+        }
+        if (release) releaseConnection(conn);
+    }
+    retireIfIdle(conn);
+}
+
+void TCPServer::uringAccepted(int clientSock) {
+    setNoDelay(clientSock);
+    std::shared_ptr<Connection> conn(new Connection(nextClientId_++, clientSock, true));
+    if (fixedFiles_ && !freeSlots_.empty() && ring_->updateFile(static_cast<unsigned>(freeSlots_.back()), clientSock)) {
+        conn->uringSlot_ = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    int id = conn->id();
+    conn->onOutboxBlocked_ = [this, id]() {
+        {
+            std::lock_guard<std::mutex> lock(resumeMutex_);
+            writeQueue_.push_back(id);
+        }
+        wakeLoop();
+    };
+    publish(conn, 0);
+    uringConns_[id] = conn;
+    postRead(conn);
+}
+
+void TCPServer::postAccept() {
+    struct io_uring_sqe* sqe =
+        ring_->prepare(IORING_OP_ACCEPT, fixedFiles_ ? kListenSlot : serverSock_, nullptr, 0, 0, uringTag(kAcceptOp, 0));
+    if (!sqe) {
+        std::cerr << "Error: io_uring submission failed" << std::endl;
+        return;
+    }
+    if (fixedFiles_) sqe->flags |= IOSQE_FIXED_FILE;
+    // Non-blocking, so workers can send directly and only fall back to the
+    // ring when the socket buffer is full.
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    ++uringInFlight_;
+}
+
+void TCPServer::postWakeRead() {
+    struct io_uring_sqe* sqe = ring_->prepare(IORING_OP_READ, fixedFiles_ ? kWakeSlot : wakeFd_, &wakeCount_,
+                                              sizeof(wakeCount_), 0, uringTag(kWakeOp, 0));
+    if (!sqe) {
+        std::cerr << "Error: io_uring submission failed" << std::endl;
+        return;
+    }
+    if (fixedFiles_) sqe->flags |= IOSQE_FIXED_FILE;
+    ++uringInFlight_;
+}
+
+void TCPServer::postRead(const std::shared_ptr<Connection>& conn) {
+    if (conn->readInFlight_ || uringDraining_) return;
+    {
+        std::lock_guard<std::mutex> lock(conn->stateMutex_);
+        if (conn->readPaused_ || conn->peerClosed_ || conn->closed_) return;
+    }
+    bool fixedFile = conn->uringSlot_ >= 0;
+    int fd = fixedFile ? conn->uringSlot_ : conn->fd_;
+    uint64_t tag = uringTag(kReadOp, conn->id());
+    size_t bodyLeft = conn->body_.size() - conn->bodyGot_;
+    struct io_uring_sqe* sqe;
+    if (conn->readingBody_ && bodyLeft >= kReadBufferSize) {
+        // Large bodies are received in place, as in readFrames().
+        conn->uringBuffer_ = Connection::kInPlace;
+        sqe = ring_->prepare(IORING_OP_RECV, fd, conn->body_.data() + conn->bodyGot_,
+                             static_cast<uint32_t>(std::min<size_t>(bodyLeft, kMaxFrameSize)), 0, tag);
+    } else if (!freeBuffers_.empty()) {
+        int buffer = freeBuffers_.back();
+        freeBuffers_.pop_back();
+        conn->uringBuffer_ = buffer;
+        sqe = ring_->prepare(IORING_OP_READ_FIXED, fd, fixedBuffers_.data() + static_cast<size_t>(buffer) * kReadBufferSize,
+                             kReadBufferSize, 0, tag);
+        if (sqe) sqe->buf_index = static_cast<uint16_t>(buffer);
+    } else {
+        // Every registered buffer is waiting on some idle connection.
+        conn->uringBuffer_ = Connection::kSpillBuffer;
+        conn->spill_.resize(kReadBufferSize);
+        sqe = ring_->prepare(IORING_OP_RECV, fd, conn->spill_.data(), kReadBufferSize, 0, tag);
+    }
+    if (!sqe) {
+        if (conn->uringBuffer_ >= 0) freeBuffers_.push_back(conn->uringBuffer_);
+        std::cerr << "Error: io_uring submission failed" << std::endl;
+        closeClient(conn->id());
+        return;
+    }
+    if (fixedFile) sqe->flags |= IOSQE_FIXED_FILE;
+    conn->readInFlight_ = true;
+    ++uringInFlight_;
+}
+
+void TCPServer::postWritePoll(const std::shared_ptr<Connection>& conn) {
+    if (conn->pollInFlight_ || uringDraining_) return;
+    {
+        std::lock_guard<std::mutex> lock(conn->stateMutex_);
+        if (conn->closed_) return;
+    }
+    bool fixedFile = conn->uringSlot_ >= 0;
+    struct io_uring_sqe* sqe = ring_->prepare(IORING_OP_POLL_ADD, fixedFile ? conn->uringSlot_ : conn->fd_, nullptr, 0,
+                                              0, uringTag(kPollOp, conn->id()));
+    if (!sqe) {
+        std::cerr << "Error: io_uring submission failed" << std::endl;
+        closeClient(conn->id());
+        return;
+    }
+    if (fixedFile) sqe->flags |= IOSQE_FIXED_FILE;
+    sqe->poll32_events = POLLOUT;
+    conn->pollInFlight_ = true;
+    ++uringInFlight_;
+}
+
+void TCPServer::retireIfIdle(const std::shared_ptr<Connection>& conn) {
+    if (conn->readInFlight_ || conn->pollInFlight_) return;
     {
-        std::lock_guard<std::mutex> lock(clientsMutex_);
-        auto it = clients_.find(clientId);
-        if (it == clients_.end() || !it->second.valid) return {};
-        sock = it->second.socket;
+        std::lock_guard<std::mutex> lock(conn->stateMutex_);
+        if (!conn->closed_) return;
     }
-    uint32_t len32;
-    if (::recv(sock, &len32, 4, MSG_WAITALL) != 4) return {};
-    size_t len = ntohl(len32);
-    std::vector<uint8_t> result(len);
-    size_t got = 0;
-    while (got < len) {
-        ssize_t n = ::recv(sock, result.data() + got, len - got, 0);
-        if (n <= 0) return {};
-        got += static_cast<size_t>(n);
+    if (conn->uringSlot_ >= 0) {
+        // The slot holds its own reference to the socket; drop it.
+        ring_->updateFile(static_cast<unsigned>(conn->uringSlot_), -1);
+        freeSlots_.push_back(conn->uringSlot_);
+        conn->uringSlot_ = -1;
     }
-    return result;
+    uringConns_.erase(conn->id());
+}
+
+void TCPServer::drainUring() {
+    // Everything in flight must complete before the buffers it targets go
+    // away: shutting the sockets down ends the reads and polls, and a
+    // cancel-any catches whatever is left on kernels that have it.
+    uringDraining_ = true;
+    for (auto& p : uringConns_) {
+        p.second->markBroken();
+        ::shutdown(p.second->fd_, SHUT_RDWR);
+    }
+    ::shutdown(serverSock_, SHUT_RDWR);
+    wakeLoop();
+    struct io_uring_sqe* sqe = ring_->prepare(IORING_OP_ASYNC_CANCEL, -1, nullptr, 0, 0, uringTag(kCancelOp, 0));
+    if (sqe) {
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        ++uringInFlight_;
+    }
+    while (uringInFlight_ > 0) {
+        int ret = ring_->submit(1);
+        if (ret < 0 && ret != -EINTR) break;
+        ring_->reap([this](uint64_t userData, int res, uint32_t) { uringCompleted(userData, res); });
+    }
+}
+
+void TCPServer::readFrames(const std::shared_ptr<Connection>& conn) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(conn->stateMutex_);
+            if (conn->readPaused_ || conn->peerClosed_ || conn->closed_) return;
+        }
+        ssize_t n;
+        size_t bodyLeft = conn->body_.size() - conn->bodyGot_;
+        if (conn->readingBody_ && bodyLeft >= kReadBufferSize) {
+            // Large bodies are received in place rather than through readBuffer_.
+            common::countSyscalls();
+            n = ::recv(conn->fd_, conn->body_.data() + conn->bodyGot_, bodyLeft, 0);
+            if (n > 0) {
+                bodyReceived(conn, static_cast<size_t>(n));
+                continue;
+            }
+        } else {
+            common::countSyscalls();
+            n = ::recv(conn->fd_, readBuffer_.data(), readBuffer_.size(), 0);
+            if (n > 0) {
+                if (!consumeBytes(conn, readBuffer_.data(), static_cast<size_t>(n))) {
+                    std::cerr << "Error: oversized frame from client " << conn->id() << std::endl;
+                    closeClient(conn->id());
+                    return;
+                }
+                continue;
+            }
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        // Orderly shutdown or error: finish queued frames, then release.
+        bool release;
+        {
+            std::lock_guard<std::mutex> lock(conn->stateMutex_);
+            conn->peerClosed_ = true;
+            release = !conn->scheduled_;
+        }
+        if (release) releaseConnection(conn);
+        return;
+    }
+}
+
+bool TCPServer::consumeBytes(const std::shared_ptr<Connection>& conn, const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        if (!conn->readingBody_) {
+            size_t take = std::min(len - pos, sizeof(conn->header_) - conn->headerGot_);
+            std::memcpy(conn->header_ + conn->headerGot_, data + pos, take);
+            conn->headerGot_ += take;
+            pos += take;
+            if (conn->headerGot_ < sizeof(conn->header_)) break;
+            uint32_t len32;
+            std::memcpy(&len32, conn->header_, sizeof(len32));
+            size_t frameLen = ntohl(len32);
+            if (frameLen > kMaxFrameSize) return false;
+            common::BufferPool::shared().resize(conn->body_, frameLen);
+            conn->bodyGot_ = 0;
+            conn->readingBody_ = true;
+            conn->hashingBody_ = conn->hashNext_.exchange(false);
+        }
+        size_t take = std::min(len - pos, conn->body_.size() - conn->bodyGot_);
+        std::memcpy(conn->body_.data() + conn->bodyGot_, data + pos, take);
+        pos += take;
+        bodyReceived(conn, take);
+    }
+    return true;
+}
+
+void TCPServer::bodyReceived(const std::shared_ptr<Connection>& conn, size_t n) {
+    // Hashing here, as each recv() lands, reads the bytes while they are
+    // still in cache instead of in a second pass over the finished frame.
+    if (conn->hashingBody_) conn->bodyHasher_.update(conn->body_.data() + conn->bodyGot_, n);
+    conn->bodyGot_ += n;
+    if (conn->bodyGot_ < conn->body_.size()) return;
+    common::Digest digest = conn->hashingBody_ ? conn->bodyHasher_.final() : common::Digest();
+    conn->hashingBody_ = false;
+    conn->readingBody_ = false;
+    conn->headerGot_ = 0;
+    queueFrame(conn, std::move(conn->body_), digest);
+    conn->body_.clear();
+    conn->bodyGot_ = 0;
+}
+
+void TCPServer::queueFrame(const std::shared_ptr<Connection>& conn, std::vector<uint8_t> frame,
+                           common::Digest digest) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->stateMutex_);
+        if (conn->closed_ || conn->closeRequested_) return;
+        conn->inbox_.push_back({std::move(frame), digest});
+        if (conn->inbox_.size() >= kMaxQueuedFrames) conn->readPaused_ = true;
+        if (!conn->scheduled_) {
+            conn->scheduled_ = true;
+            schedule = true;
+        }
+    }
+    if (schedule) workers_->submit([this, conn]() { drainFrames(conn); });
+}
+
+void TCPServer::drainFrames(const std::shared_ptr<Connection>& conn) {
+    while (true) {
+        Connection::InboundFrame frame;
+        bool resume = false;
+        bool drained = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->stateMutex_);
+            if (conn->closeRequested_) conn->inbox_.clear();
+            if (conn->inbox_.empty()) {
+                conn->scheduled_ = false;
+                if (!conn->peerClosed_ && !conn->closeRequested_) return;
+                drained = true;
+            } else {
+                frame = std::move(conn->inbox_.front());
+                conn->inbox_.pop_front();
+                if (conn->readPaused_ && conn->inbox_.size() <= kMaxQueuedFrames / 2) {
+                    conn->readPaused_ = false;
+                    resume = true;
+                }
+            }
+        }
+        if (drained) {
+            releaseConnection(conn);
+            return;
+        }
+        if (resume) {
+            {
+                std::lock_guard<std::mutex> lock(resumeMutex_);
+                resumeQueue_.push_back(conn->id());
+            }
+            wakeLoop();
+        }
+        conn->frameDigest_ = frame.digest;
+        onFrame_(*conn, std::move(frame.data));
+    }
+}
+
+void TCPServer::releaseConnection(const std::shared_ptr<Connection>& conn) {
+    {
+        std::lock_guard<std::mutex> lock(conn->stateMutex_);
+        if (conn->closed_) return;
+        conn->closed_ = true;
+        conn->inbox_.clear();
+    }
+    conn->markBroken();
+    if (epollFd_ >= 0) epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->fd_, nullptr);
+    if (ring_) {
+        // The loop frees its buffer and file slot once nothing is in flight.
+        {
+            std::lock_guard<std::mutex> lock(resumeMutex_);
+            retireQueue_.push_back(conn->id());
+        }
+        wakeLoop();
+    }
+    publish(nullptr, conn->id());
+    if (onClose_) onClose_(conn->id());
+}
+
+void TCPServer::wakeLoop() {
+    if (wakeFd_ < 0) return;
+    uint64_t one = 1;
+    common::countSyscalls();
+    ssize_t n = ::write(wakeFd_, &one, sizeof(one));
+    (void)n;
+}
+
+void TCPServer::shutdownReactor() {
+    reactorActive_ = false;
+    auto table = snapshot();
+    // Unblock workers waiting on full send buffers before draining the pool.
+    for (auto& p : *table) {
+        p.second->markBroken();
+        ::shutdown(p.second->fd_, SHUT_RDWR);
+    }
+    if (workers_) {
+        workers_->shutdown();
+        workers_.reset();
+    }
+    for (auto& p : *table) releaseConnection(p.second);
+    if (epollFd_ >= 0) {
+        ::close(epollFd_);
+        epollFd_ = -1;
+    }
+    if (wakeFd_ >= 0) {
+        ::close(wakeFd_);
+        wakeFd_ = -1;
+    }
+    if (serverSock_ >= 0) {
+        ::close(serverSock_);
+        serverSock_ = -1;
+    }
+    running_ = false;
+}
+
+bool TCPServer::sendData(int clientId, const uint8_t* data, size_t len) {
+    auto conn = connection(clientId);
+    return conn && conn->sendData(data, len);
+}
+
+bool TCPServer::sendData(int clientId, const std::vector<uint8_t>& data) {
+    return sendData(clientId, data.data(), data.size());
+}
+
+std::vector<uint8_t> TCPServer::recvData(int clientId) {
+    auto conn = connection(clientId);
+    if (!conn) return {};
+    return conn->recvData();
 }
 
 bool TCPServer::sendMessage(int clientId, const std::string& message) {
@@ -110,28 +1066,51 @@ std::string TCPServer::recvMessage(int clientId) {
 }
 
 void TCPServer::closeClient(int clientId) {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    auto it = clients_.find(clientId);
-    if (it != clients_.end()) {
-        if (it->second.socket >= 0) ::close(it->second.socket);
-        it->second.valid = false;
-        it->second.socket = -1;
-        clients_.erase(it);
+    auto conn = connection(clientId);
+    if (!conn) return;
+    if (!conn->queued_) {
+        // The descriptor is closed once the last handle goes away.
+        ::shutdown(conn->fd_, SHUT_RDWR);
+        conn->markBroken();
+        publish(nullptr, clientId);
+        return;
+    }
+    bool release;
+    {
+        std::lock_guard<std::mutex> lock(conn->stateMutex_);
+        conn->closeRequested_ = true;
+        conn->inbox_.clear();
+        release = !conn->scheduled_;
     }
+    ::shutdown(conn->fd_, SHUT_RDWR);
+    if (release) releaseConnection(conn);
 }
 
 void TCPServer::stop() {
+    if (reactorActive_) {
+        // The event loop thread tears everything down once it wakes up.
+        running_ = false;
+        wakeLoop();
+        return;
+    }
     if (running_) {
         running_ = false;
         if (serverSock_ >= 0) {
+            // shutdown() wakes a thread blocked in accept(); close() alone does not.
+            ::shutdown(serverSock_, SHUT_RDWR);
             ::close(serverSock_);
             serverSock_ = -1;
         }
-        std::lock_guard<std::mutex> lock(clientsMutex_);
-        for (auto& p : clients_) {
-            if (p.second.socket >= 0) ::close(p.second.socket);
+        std::shared_ptr<const ConnectionTable> table;
+        {
+            std::lock_guard<std::mutex> lock(tableMutex_);
+            table = std::atomic_load(&table_);
+            std::atomic_store(&table_, std::make_shared<const ConnectionTable>());
+        }
+        for (auto& p : *table) {
+            ::shutdown(p.second->fd_, SHUT_RDWR);
+            p.second->markBroken();
         }
-        clients_.clear();
     }
 }
 
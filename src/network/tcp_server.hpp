@@ -1,19 +1,165 @@
 #pragma once
 
+#include "common/sha256.hpp"
+#include "network/framing.hpp"
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
-#include <map>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace dfs {
+namespace common {
+class IoUring;
+class ThreadPool;
+}
+
 namespace network {
 
-struct SocketContext {
-    int socket{-1};
-    bool valid{false};
+// THREADED: caller accepts and drives each connection with blocking recv/send.
+// REACTOR: runEventLoop() owns all sockets and hands complete frames to workers.
+// URING: as REACTOR, but accepts, reads and write readiness go through an
+//        io_uring; falls back to REACTOR where io_uring is unavailable.
+enum class ServerMode { THREADED, REACTOR, URING };
+
+// One accepted socket. Handlers hold the shared_ptr for as long as they talk to
+// the peer, so sends only serialize with other sends on the same socket.
+class Connection {
+public:
+    ~Connection();
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    int id() const { return id_; }
+    bool sendData(const uint8_t* data, size_t len);
+    bool sendData(const std::vector<uint8_t>& data);
+    // Sends `head` followed by len bytes of `body` as one frame, such as a
+    // response header and the chunk it carries, without joining them first.
+    bool sendData(const std::vector<uint8_t>& head, const uint8_t* body, size_t len);
+    bool sendMessage(const std::string& message);
+    // Sends `head` and then len bytes of fd from offset as one frame, the
+    // file part with sendfile(2), so it goes from the page cache to the
+    // socket without a user-space copy. fd is only borrowed for the duration
+    // of the call.
+    bool sendFile(int fd, uint64_t offset, size_t len, const std::vector<uint8_t>& head = {});
+    // Blocking receive; only valid for THREADED connections.
+    std::vector<uint8_t> recvData();
+    // Receives one frame into `frame`, reusing its capacity.
+    bool recvData(std::vector<uint8_t>& frame);
+    std::string recvMessage();
+    // Hashes the next frame received on this connection while its bytes
+    // arrive; the handler of that frame reads the result from frameDigest().
+    void hashNextFrame() { hashNext_ = true; }
+    // SHA-256 of the frame being handled if hashNextFrame() armed it, else
+    // an all-zero digest.
+    const common::Digest& frameDigest() const { return frameDigest_; }
+    // Counts requests a handler runs away from the frame thread, so it can
+    // bound them per connection: false, and nothing counted, once `limit`
+    // are already running. Each true is matched by a finishRequest().
+    bool startRequest(size_t limit) {
+        size_t running = requests_.load();
+        while (running < limit) {
+            if (requests_.compare_exchange_weak(running, running + 1)) return true;
+        }
+        return false;
+    }
+    void finishRequest() { requests_--; }
+
+private:
+    friend class TCPServer;
+    Connection(int id, int fd, bool queued);
+
+    bool sendBlocking(const std::vector<uint8_t>* head, const uint8_t* data, size_t len);
+    bool sendQueued(const std::vector<uint8_t>* head, const uint8_t* data, size_t len);
+    bool sendFileBlocking(const std::vector<uint8_t>& head, int fd, uint64_t offset, size_t len);
+    bool sendFileQueued(const std::vector<uint8_t>& head, int fd, uint64_t offset, size_t len);
+    // True if output is still waiting for the socket to drain.
+    bool flushQueued();
+    void markBroken();
+
+    const int id_;
+    const int fd_;
+    const bool queued_;
+    std::mutex sendMutex_;
+
+    // THREADED read side.
+    FrameReader reader_;
+
+    // Reactor read side: 4-byte big-endian length, then body. Loop thread only.
+    bool readingBody_{false};
+    uint8_t header_[4]{};
+    size_t headerGot_{0};
+    std::vector<uint8_t> body_;
+    size_t bodyGot_{0};
+    bool hashingBody_{false};
+    common::Sha256 bodyHasher_;
+
+    // io_uring loop state, loop thread only: the registered file slot (-1
+    // if the socket is used by descriptor), where the in-flight read lands
+    // (a fixed buffer index, or kSpillBuffer / kInPlace) and what is pending.
+    static constexpr int kSpillBuffer = -1;
+    static constexpr int kInPlace = -2;
+    int uringSlot_{-1};
+    int uringBuffer_{kSpillBuffer};
+    std::vector<uint8_t> spill_;
+    bool readInFlight_{false};
+    bool pollInFlight_{false};
+
+    std::atomic<bool> hashNext_{false};
+    std::atomic<size_t> requests_{0};
+    // Written before each frame is handed to its handler.
+    common::Digest frameDigest_;
+
+    struct InboundFrame {
+        std::vector<uint8_t> data;
+        common::Digest digest;
+    };
+
+    // Frames waiting for a worker, guarded by stateMutex_.
+    std::mutex stateMutex_;
+    std::deque<InboundFrame> inbox_;
+    bool scheduled_{false};
+    bool readPaused_{false};
+    bool peerClosed_{false};
+    bool closeRequested_{false};
+    bool closed_{false};
+
+    // Either bytes held in memory or a range of a file this entry owns a
+    // descriptor for.
+    struct Outbound {
+        std::vector<uint8_t> bytes;
+        int fileFd{-1};
+        uint64_t fileOffset{0};
+        size_t fileLength{0};
+
+        Outbound() = default;
+        Outbound(Outbound&& other) noexcept;
+        Outbound& operator=(Outbound&& other) = delete;
+        ~Outbound();
+        size_t size() const { return fileFd >= 0 ? fileLength : bytes.size(); }
+    };
+
+    // Bytes the kernel has not accepted yet, guarded by sendMutex_.
+    std::condition_variable sendCv_;
+    std::deque<Outbound> outbox_;
+    size_t outOffset_{0};  // into outbox_.front()
+    size_t outBytes_{0};
+    bool broken_{false};
+    // Called under sendMutex_ when output starts queueing, for loops that
+    // must ask to be told when the socket is writable again.
+    std::function<void()> onOutboxBlocked_;
 };
 
+// Called on a worker thread for every complete length-prefixed frame. Frames of
+// one connection are delivered in order and never concurrently.
+using FrameHandler = std::function<void(Connection& conn, std::vector<uint8_t> frame)>;
+using CloseHandler = std::function<void(int clientId)>;
+
 class TCPServer {
 public:
     TCPServer();
@@ -23,6 +169,13 @@ public:
 
     bool start(int port);
     int acceptClient();
+    // mode is REACTOR or URING.
+    bool runEventLoop(const FrameHandler& onFrame, const CloseHandler& onClose, size_t workerThreads = 0,
+                      ServerMode mode = ServerMode::REACTOR);
+    // URING only: a kernel thread polls the submission queue, trading a
+    // busy core for fewer system calls.
+    void setSqPoll(bool enabled) { sqpoll_ = enabled; }
+    std::shared_ptr<Connection> connection(int clientId) const;
     bool sendData(int clientId, const uint8_t* data, size_t len);
     bool sendData(int clientId, const std::vector<uint8_t>& data);
     std::vector<uint8_t> recvData(int clientId);
@@ -32,11 +185,66 @@ public:
     void stop();
 
 private:
+    using ConnectionTable = std::unordered_map<int, std::shared_ptr<Connection>>;
+
+    // Readers take a snapshot of the table without locking; accept and close
+    // copy it under tableMutex_ and publish the new version.
+    std::shared_ptr<const ConnectionTable> snapshot() const;
+    void publish(const std::shared_ptr<Connection>& added, int removedId);
+
+    void acceptPending();
+    bool initUring();
+    void runUringLoop();
+    void uringCompleted(uint64_t userData, int res);
+    void uringAccepted(int clientSock);
+    void postAccept();
+    void postWakeRead();
+    void postRead(const std::shared_ptr<Connection>& conn);
+    void postWritePoll(const std::shared_ptr<Connection>& conn);
+    void retireIfIdle(const std::shared_ptr<Connection>& conn);
+    void drainUring();
+    void readFrames(const std::shared_ptr<Connection>& conn);
+    bool consumeBytes(const std::shared_ptr<Connection>& conn, const uint8_t* data, size_t len);
+    // Accounts for n bytes just stored at body_[bodyGot_] and queues the frame
+    // once it is complete.
+    void bodyReceived(const std::shared_ptr<Connection>& conn, size_t n);
+    void queueFrame(const std::shared_ptr<Connection>& conn, std::vector<uint8_t> frame, common::Digest digest);
+    void drainFrames(const std::shared_ptr<Connection>& conn);
+    void releaseConnection(const std::shared_ptr<Connection>& conn);
+    void wakeLoop();
+    void shutdownReactor();
+
     int serverSock_{-1};
-    bool running_{false};
-    std::map<int, SocketContext> clients_;
-    int nextClientId_{1};
-    std::mutex clientsMutex_;
+    std::atomic<bool> running_{false};
+    std::shared_ptr<const ConnectionTable> table_;
+    std::mutex tableMutex_;
+    std::atomic<int> nextClientId_{1};
+
+    // Reactor state; only used while runEventLoop() is active.
+    std::atomic<bool> reactorActive_{false};
+    int epollFd_{-1};
+    int wakeFd_{-1};
+    std::deque<int> resumeQueue_;
+    std::deque<int> writeQueue_;   // URING: connections waiting to be writable
+    std::deque<int> retireQueue_;  // URING: released connections
+    std::mutex resumeMutex_;
+    std::vector<uint8_t> readBuffer_;
+    FrameHandler onFrame_;
+    CloseHandler onClose_;
+    std::unique_ptr<common::ThreadPool> workers_;
+
+    // URING state; loop thread only.
+    bool sqpoll_{false};
+    std::unique_ptr<common::IoUring> ring_;
+    bool fixedFiles_{false};
+    std::vector<int> freeSlots_;
+    std::vector<uint8_t> fixedBuffers_;
+    std::vector<int> freeBuffers_;
+    uint64_t wakeCount_{0};
+    size_t uringInFlight_{0};
+    bool uringDraining_{false};
+    // Connections the ring may still hold buffers or slots of.
+    std::unordered_map<int, std::shared_ptr<Connection>> uringConns_;
 };
 
 }  // namespace network
@@ -0,0 +1,130 @@
+#include "storage/chunk_cache.hpp"
+
+namespace dfs {
+namespace storage {
+
+// 2Q's recommended tuning: A1in holds 25% of the cache, and A1out
+// remembers as many keys as would fill half of it.
+ChunkCache::ChunkCache(size_t budgetBytes)
+    : budget_(budgetBytes), inBudget_(budgetBytes / 4), ghostBudget_(budgetBytes / 2) {}
+
+SharedChunk ChunkCache::lookup(const common::Digest& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    // Re-reads while in A1in are usually the same access pattern repeating
+    // within a short window, so only Am is reordered.
+    if (it->second.queue == Queue::AM) main_.splice(main_.begin(), main_, it->second.position);
+    return it->second.chunk;
+}
+
+void ChunkCache::insert(const common::Digest& key, SharedChunk chunk, ChunkStore* source) {
+    if (!chunk) return;
+    size_t size = chunk->size();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size > inBudget_ || entries_.count(key)) return;
+    if (source && !source->contains(key)) return;
+    Entry entry;
+    entry.chunk = std::move(chunk);
+    auto ghost = ghosts_.find(key);
+    if (ghost != ghosts_.end()) {
+        // Requested again after leaving A1in: a genuinely hot chunk.
+        ghostBytes_ -= ghost->second.size;
+        out_.erase(ghost->second.position);
+        ghosts_.erase(ghost);
+        entry.queue = Queue::AM;
+        entry.position = main_.insert(main_.begin(), key);
+        mainBytes_ += size;
+    } else {
+        entry.queue = Queue::A1IN;
+        entry.position = in_.insert(in_.begin(), key);
+        inBytes_ += size;
+    }
+    entries_.emplace(key, std::move(entry));
+    evictLocked();
+}
+
+void ChunkCache::evictLocked() {
+    while (inBytes_ + mainBytes_ > budget_) {
+        if (inBytes_ > inBudget_ || main_.empty()) {
+            common::Digest key = in_.back();
+            auto it = entries_.find(key);
+            size_t size = it->second.chunk->size();
+            removeLocked(it);
+            addGhostLocked(key, size);
+        } else {
+            removeLocked(entries_.find(main_.back()));
+        }
+        evictions_++;
+    }
+}
+
+bool ChunkCache::remembered(const common::Digest& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ghosts_.count(key) > 0;
+}
+
+void ChunkCache::remember(const common::Digest& key, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size > inBudget_ || entries_.count(key) || ghosts_.count(key)) return;
+    addGhostLocked(key, size);
+}
+
+void ChunkCache::addGhostLocked(const common::Digest& key, size_t size) {
+    Ghost ghost;
+    ghost.size = size;
+    ghost.position = out_.insert(out_.begin(), key);
+    ghosts_.emplace(key, ghost);
+    ghostBytes_ += size;
+    while (ghostBytes_ > ghostBudget_) forgetOldestGhostLocked();
+}
+
+void ChunkCache::forgetOldestGhostLocked() {
+    auto ghost = ghosts_.find(out_.back());
+    ghostBytes_ -= ghost->second.size;
+    ghosts_.erase(ghost);
+    out_.pop_back();
+}
+
+void ChunkCache::removeLocked(std::unordered_map<common::Digest, Entry>::iterator it) {
+    size_t size = it->second.chunk->size();
+    if (it->second.queue == Queue::A1IN) {
+        in_.erase(it->second.position);
+        inBytes_ -= size;
+    } else {
+        main_.erase(it->second.position);
+        mainBytes_ -= size;
+    }
+    entries_.erase(it);
+}
+
+void ChunkCache::erase(const common::Digest& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) removeLocked(it);
+    auto ghost = ghosts_.find(key);
+    if (ghost != ghosts_.end()) {
+        ghostBytes_ -= ghost->second.size;
+        out_.erase(ghost->second.position);
+        ghosts_.erase(ghost);
+    }
+}
+
+CacheStats ChunkCache::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.bytes = inBytes_ + mainBytes_;
+    stats.chunks = entries_.size();
+    stats.budget = budget_;
+    return stats;
+}
+
+}  // namespace storage
+}  // namespace dfs
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "storage/chunk_store.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dfs {
+namespace storage {
+
+struct CacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+    size_t bytes{0};
+    size_t chunks{0};
+    size_t budget{0};
+};
+
+// Byte-budgeted cache of chunk buffers with the 2Q replacement policy.
+// A chunk seen for the first time enters a FIFO (A1in) capped at a quarter
+// of the budget; when it falls out, only its key is remembered (A1out).
+// A chunk requested again while its key is remembered is admitted to the
+// LRU main queue (Am). A sequential scan of a large file therefore cycles
+// through A1in without displacing chunks that are read repeatedly.
+// All methods are safe to call from any thread.
+class ChunkCache {
+public:
+    explicit ChunkCache(size_t budgetBytes);
+    ChunkCache(const ChunkCache&) = delete;
+    ChunkCache& operator=(const ChunkCache&) = delete;
+
+    // Null on a miss. Counts a hit or a miss.
+    SharedChunk lookup(const common::Digest& key);
+    // Admits a chunk fetched after a miss, evicting as needed. Chunks larger
+    // than the A1in share of the budget are not cached. With a `source`,
+    // only if it still holds the key, checked under the cache's lock: a
+    // chunk read before a concurrent erase from the store and then the
+    // cache is not brought back.
+    void insert(const common::Digest& key, SharedChunk chunk, ChunkStore* source = nullptr);
+    // For a miss served without reading the chunk into memory (sendfile):
+    // whether the key is remembered from an earlier miss, so that the chunk
+    // should now be read and inserted into Am...
+    bool remembered(const common::Digest& key);
+    // ...and, if not, remembers it as if it had passed through A1in.
+    void remember(const common::Digest& key, size_t size);
+    void erase(const common::Digest& key);
+    CacheStats stats();
+
+private:
+    enum class Queue { A1IN, AM };
+    struct Entry {
+        SharedChunk chunk;
+        Queue queue;
+        std::list<common::Digest>::iterator position;
+    };
+    struct Ghost {
+        size_t size;
+        std::list<common::Digest>::iterator position;
+    };
+
+    void addGhostLocked(const common::Digest& key, size_t size);
+    void evictLocked();
+    void forgetOldestGhostLocked();
+    void removeLocked(std::unordered_map<common::Digest, Entry>::iterator it);
+
+    const size_t budget_;
+    const size_t inBudget_;     // A1in share of the budget
+    const size_t ghostBudget_;  // bytes the remembered A1out keys stood for
+
+    std::mutex mutex_;
+    std::unordered_map<common::Digest, Entry> entries_;
+    // Front is newest. A1in is FIFO; Am is kept in LRU order.
+    std::list<common::Digest> in_;
+    std::list<common::Digest> main_;
+    size_t inBytes_{0};
+    size_t mainBytes_{0};
+    std::unordered_map<common::Digest, Ghost> ghosts_;
+    std::list<common::Digest> out_;
+    size_t ghostBytes_{0};
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+    uint64_t evictions_{0};
+};
+
+}  // namespace storage
+}  // namespace dfs
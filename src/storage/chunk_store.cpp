@@ -0,0 +1,47 @@
+#include "storage/chunk_store.hpp"
+#include "common/io_stats.hpp"
+#include <unistd.h>
+
+namespace dfs {
+namespace storage {
+
+ChunkFile::ChunkFile(int fd, uint64_t offset, size_t length) : fd_(fd), offset_(offset), length_(length) {}
+
+ChunkFile::ChunkFile(ChunkFile&& other) noexcept
+    : fd_(other.fd_), offset_(other.offset_), length_(other.length_) {
+    other.fd_ = -1;
+}
+
+ChunkFile& ChunkFile::operator=(ChunkFile&& other) noexcept {
+    if (this != &other) {
+        if (fd_ >= 0) {
+            common::countSyscalls();
+            ::close(fd_);
+        }
+        fd_ = other.fd_;
+        offset_ = other.offset_;
+        length_ = other.length_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+bool ChunkStore::putBytes(const common::Digest& key, const uint8_t* data, size_t len) {
+    return put(key, std::vector<uint8_t>(data, data + len));
+}
+
+SharedChunk ChunkStore::getShared(const common::Digest& key) {
+    std::shared_ptr<std::vector<uint8_t>> chunk = std::make_shared<std::vector<uint8_t>>();
+    if (!get(key, *chunk)) return nullptr;
+    return chunk;
+}
+
+ChunkFile::~ChunkFile() {
+    if (fd_ >= 0) {
+        common::countSyscalls();
+        ::close(fd_);
+    }
+}
+
+}  // namespace storage
+}  // namespace dfs
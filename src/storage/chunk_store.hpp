@@ -0,0 +1,73 @@
+#pragma once
+
+#include "common/digest.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dfs {
+namespace storage {
+
+// Storage engines a StorageNode can keep its chunks in.
+enum class StoreEngine { MEMORY, LOG, FILES };
+
+// A stored chunk's bytes as a range of an open file, so they can be sent
+// with sendfile(2) instead of being copied through user space. Owns the
+// descriptor, which stays valid even if the chunk is erased meanwhile.
+class ChunkFile {
+public:
+    ChunkFile() = default;
+    ChunkFile(int fd, uint64_t offset, size_t length);
+    ChunkFile(ChunkFile&& other) noexcept;
+    ChunkFile& operator=(ChunkFile&& other) noexcept;
+    ~ChunkFile();
+
+    explicit operator bool() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+    uint64_t offset() const { return offset_; }
+    size_t length() const { return length_; }
+
+private:
+    int fd_{-1};
+    uint64_t offset_{0};
+    size_t length_{0};
+};
+
+// Immutable chunk bytes shared by a store and the requests reading them.
+using SharedChunk = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Where a StorageNode keeps chunk bytes, keyed by content digest. All
+// methods are safe to call from any thread.
+class ChunkStore {
+public:
+    virtual ~ChunkStore() = default;
+
+    // Chunks are immutable, so storing a key that is already present is a
+    // no-op that succeeds.
+    virtual bool put(const common::Digest& key, std::vector<uint8_t> data) = 0;
+    // Stores len bytes that sit inside a larger buffer, such as the request
+    // frame they arrived in. The default copies them out for put(); engines
+    // that write chunks to files write them from where they are.
+    virtual bool putBytes(const common::Digest& key, const uint8_t* data, size_t len);
+    // False if the key is absent or its bytes could not be read.
+    virtual bool get(const common::Digest& key, std::vector<uint8_t>& data) = 0;
+    // Null if the key is absent. Engines that keep chunks as shared buffers
+    // hand out a reference instead of copying; the default copies via get().
+    virtual SharedChunk getShared(const common::Digest& key);
+    // False if the key was absent.
+    virtual bool erase(const common::Digest& key) = 0;
+    virtual bool contains(const common::Digest& key) = 0;
+    // Engines that keep chunks in files hand out the chunk's file range;
+    // false means the key is absent or the engine has no files to offer.
+    virtual bool openChunk(const common::Digest& key, ChunkFile& file) {
+        (void)key;
+        (void)file;
+        return false;
+    }
+    virtual size_t chunkCount() = 0;
+    virtual const char* name() const = 0;
+};
+
+}  // namespace storage
+}  // namespace dfs
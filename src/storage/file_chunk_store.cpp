@@ -0,0 +1,302 @@
+#include "storage/file_chunk_store.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/io_stats.hpp"
+#include "storage/file_io.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dfs {
+namespace storage {
+
+namespace {
+
+constexpr unsigned kRingEntries = 8;
+// put() opens its temporary file straight into the ring's only file slot;
+// file_index counts slots from 1.
+constexpr unsigned kDirectSlot = 1;
+
+bool isHexName(const char* name, size_t len) {
+    if (std::strlen(name) != len) return false;
+    for (size_t i = 0; i < len; ++i) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+
+// One small ring per calling thread, so handler threads never contend for
+// it. Null if this kernel has no io_uring or the ring failed.
+std::unique_ptr<common::IoUring>& threadRingSlot() {
+    thread_local std::unique_ptr<common::IoUring> ring;
+    thread_local bool tried = false;
+    if (!tried) {
+        tried = true;
+        std::unique_ptr<common::IoUring> created(new common::IoUring());
+        int empty = -1;
+        if (created->init(kRingEntries) && created->registerFiles(&empty, 1)) ring = std::move(created);
+    }
+    return ring;
+}
+
+common::IoUring* threadRing() {
+    return threadRingSlot().get();
+}
+
+// Submits what is prepared and collects `count` completions into results,
+// indexed by user data. A ring that fails outright is dropped, which also
+// discards anything it still held, and the caller falls back to POSIX.
+bool runBatch(common::IoUring* ring, unsigned count, int* results) {
+    unsigned done = 0;
+    while (done < count) {
+        int ret = ring->submit(count - done);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+            std::cerr << "Error: io_uring_enter failed: " << std::strerror(-ret) << std::endl;
+            threadRingSlot().reset();
+            return false;
+        }
+        done += ring->reap([results](uint64_t userData, int res, uint32_t) { results[userData] = res; });
+    }
+    return true;
+}
+
+}  // namespace
+
+FileChunkStore::FileChunkStore(const std::string& directory, bool syncWrites, common::IoBackend backend)
+    : directory_(directory), syncWrites_(syncWrites), backend_(backend) {
+    if (backend_ == common::IoBackend::URING && !common::IoUring::supported()) {
+        std::cerr << "io_uring unavailable, chunk files use POSIX I/O" << std::endl;
+        backend_ = common::IoBackend::POSIX;
+    }
+    if (!makeDirectories(directory_) || !loadExisting()) {
+        std::cerr << "Error: could not open chunk directory " << directory_ << std::endl;
+        return;
+    }
+    open_ = true;
+}
+
+std::string FileChunkStore::directoryFor(const std::string& hex) const {
+    return directory_ + "/" + hex.substr(0, 2);
+}
+
+bool FileChunkStore::loadExisting() {
+    DIR* dir = ::opendir(directory_.c_str());
+    if (!dir) return false;
+    std::vector<std::string> shards;
+    while (struct dirent* entry = ::readdir(dir)) {
+        if (isHexName(entry->d_name, 2)) shards.push_back(entry->d_name);
+    }
+    ::closedir(dir);
+
+    for (const std::string& shard : shards) {
+        shardMade_[std::stoi(shard, nullptr, 16)] = true;
+        std::string path = directory_ + "/" + shard;
+        DIR* sub = ::opendir(path.c_str());
+        if (!sub) continue;
+        while (struct dirent* entry = ::readdir(sub)) {
+            common::Digest key;
+            if (isHexName(entry->d_name, 2 * common::Digest::kSize) &&
+                common::Digest::fromHex(entry->d_name, key)) {
+                keys_.insert(key);
+            } else if (std::strstr(entry->d_name, ".tmp.")) {
+                // Left by a put that crashed before its rename.
+                ::unlink((path + "/" + entry->d_name).c_str());
+            }
+        }
+        ::closedir(sub);
+    }
+    return true;
+}
+
+bool FileChunkStore::makeShard(const std::string& hex) {
+    std::atomic<bool>& made = shardMade_[std::stoi(hex.substr(0, 2), nullptr, 16)];
+    if (made.load(std::memory_order_acquire)) return true;
+    std::string dir = directoryFor(hex);
+    common::countSyscalls();
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    made.store(true, std::memory_order_release);
+    return true;
+}
+
+bool FileChunkStore::put(const common::Digest& key, std::vector<uint8_t> data) {
+    bool stored = putBytes(key, data.data(), data.size());
+    // Once written, the buffer can receive the next chunk.
+    common::BufferPool::shared().release(std::move(data));
+    return stored;
+}
+
+bool FileChunkStore::putBytes(const common::Digest& key, const uint8_t* data, size_t len) {
+    if (contains(key)) return true;
+    std::string hex = key.toHex();
+    std::string path = directoryFor(hex) + "/" + hex;
+    std::string temp = path + ".tmp." + std::to_string(tempSequence_.fetch_add(1));
+
+    if (!makeShard(hex)) {
+        std::cerr << "Error: could not create " << directoryFor(hex) << std::endl;
+        return false;
+    }
+    bool written = false;
+    if (backend_ == common::IoBackend::URING && threadRing()) {
+        written = writeUring(temp, path, data, len);
+        // A ring that failed outright was dropped; write the chunk without it.
+        if (!written && !threadRing()) written = writePosix(temp, path, data, len);
+    } else {
+        written = writePosix(temp, path, data, len);
+    }
+    if (!written) {
+        std::cerr << "Error: write of " << path << " failed" << std::endl;
+        common::countSyscalls();
+        ::unlink(temp.c_str());
+        return false;
+    }
+    if (syncWrites_) syncDirectory(directoryFor(hex));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys_.insert(key);
+    return true;
+}
+
+bool FileChunkStore::writePosix(const std::string& temp, const std::string& path, const uint8_t* data, size_t len) {
+    common::countSyscalls();
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeFully(fd, data, len, 0);
+    if (ok && syncWrites_) {
+        common::countSyscalls();
+        ok = ::fdatasync(fd) == 0;
+    }
+    common::countSyscalls();
+    ::close(fd);
+    if (!ok) return false;
+    common::countSyscalls();
+    return ::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+bool FileChunkStore::writeUring(const std::string& temp, const std::string& path, const uint8_t* data, size_t len) {
+    enum : uint64_t { kOpen, kWrite, kSync, kClose, kRename, kOps };
+    common::IoUring* ring = threadRing();
+    // Linked: each step only runs if the one before it succeeded, and a
+    // short write counts as a failure.
+    struct io_uring_sqe* sqe = ring->prepare(IORING_OP_OPENAT, AT_FDCWD, temp.c_str(), 0644, 0, kOpen);
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    sqe->file_index = kDirectSlot;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe = ring->prepare(IORING_OP_WRITE, kDirectSlot - 1, data, static_cast<uint32_t>(len), 0, kWrite);
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    if (syncWrites_) {
+        sqe = ring->prepare(IORING_OP_FSYNC, kDirectSlot - 1, nullptr, 0, 0, kSync);
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    }
+    sqe = ring->prepare(IORING_OP_CLOSE, 0, nullptr, 0, 0, kClose);
+    sqe->file_index = kDirectSlot;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe = ring->prepare(IORING_OP_RENAMEAT, AT_FDCWD, temp.c_str(), static_cast<uint32_t>(AT_FDCWD), 0, kRename);
+    sqe->addr2 = reinterpret_cast<uint64_t>(path.c_str());
+
+    int results[kOps] = {0, 0, 0, 0, 0};
+    if (!runBatch(ring, syncWrites_ ? 5 : 4, results)) return false;
+    bool ok = results[kOpen] >= 0 && results[kWrite] == static_cast<int>(len) && results[kSync] >= 0 &&
+              results[kClose] >= 0 && results[kRename] >= 0;
+    // A broken chain cancels the close; do not leave the file in the slot.
+    if (results[kOpen] >= 0 && results[kClose] < 0) ring->updateFile(kDirectSlot - 1, -1);
+    return ok;
+}
+
+int FileChunkStore::openLocked(const common::Digest& key, size_t& size) {
+    std::string hex = key.toHex();
+    std::string path = directoryFor(hex) + "/" + hex;
+    // Under the lock so a concurrent erase cannot unlink it in between;
+    // once open, the descriptor outlives any later unlink.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (keys_.count(key) == 0) return -1;
+    common::IoUring* ring = backend_ == common::IoBackend::URING ? threadRing() : nullptr;
+    if (ring) {
+        // Chunks are immutable, so the size of the path is the size of the
+        // file being opened; both go in one submission.
+        enum : uint64_t { kOpen, kStat, kOps };
+        struct statx st;
+        struct io_uring_sqe* sqe = ring->prepare(IORING_OP_OPENAT, AT_FDCWD, path.c_str(), 0, 0, kOpen);
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe = ring->prepare(IORING_OP_STATX, AT_FDCWD, path.c_str(), STATX_SIZE, 0, kStat);
+        sqe->addr2 = reinterpret_cast<uint64_t>(&st);
+        int results[kOps] = {-1, -1};
+        if (runBatch(ring, kOps, results)) {
+            if (results[kOpen] >= 0 && results[kStat] < 0) ::close(results[kOpen]);
+            if (results[kOpen] < 0 || results[kStat] < 0) return -1;
+            size = static_cast<size_t>(st.stx_size);
+            return results[kOpen];
+        }
+    }
+    common::countSyscalls(2);
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    size = static_cast<size_t>(st.st_size);
+    return fd;
+}
+
+bool FileChunkStore::get(const common::Digest& key, std::vector<uint8_t>& data) {
+    size_t size = 0;
+    int fd = openLocked(key, size);
+    if (fd < 0) return false;
+    data.resize(size);
+    common::IoUring* ring = backend_ == common::IoBackend::URING ? threadRing() : nullptr;
+    if (ring) {
+        // Hard-linked so the close runs even after a short read.
+        enum : uint64_t { kRead, kClose, kOps };
+        struct io_uring_sqe* sqe =
+            ring->prepare(IORING_OP_READ, fd, data.data(), static_cast<uint32_t>(size), 0, kRead);
+        sqe->flags = IOSQE_IO_HARDLINK;
+        ring->prepare(IORING_OP_CLOSE, fd, nullptr, 0, 0, kClose);
+        int results[kOps] = {-1, -1};
+        if (runBatch(ring, kOps, results)) {
+            if (results[kClose] < 0) ::close(fd);
+            return results[kRead] == static_cast<int>(size);
+        }
+    }
+    bool ok = readFully(fd, data.data(), size, 0);
+    common::countSyscalls();
+    ::close(fd);
+    return ok;
+}
+
+bool FileChunkStore::erase(const common::Digest& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (keys_.erase(key) == 0) return false;
+    std::string hex = key.toHex();
+    common::countSyscalls();
+    ::unlink((directoryFor(hex) + "/" + hex).c_str());
+    return true;
+}
+
+bool FileChunkStore::contains(const common::Digest& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return keys_.count(key) > 0;
+}
+
+bool FileChunkStore::openChunk(const common::Digest& key, ChunkFile& file) {
+    size_t size = 0;
+    int fd = openLocked(key, size);
+    if (fd < 0) return false;
+    file = ChunkFile(fd, 0, size);
+    return true;
+}
+
+size_t FileChunkStore::chunkCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return keys_.size();
+}
+
+}  // namespace storage
+}  // namespace dfs
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "common/io_uring.hpp"
+#include "storage/chunk_store.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace dfs {
+namespace storage {
+
+// One file per chunk at <directory>/<first two hex digits>/<hex digest>.
+// Chunks are written under a temporary name and renamed into place, so a
+// crash never leaves a partial chunk behind its real name. GETs can be
+// served straight from the page cache through openChunk(). With the URING
+// backend each put is one linked open/write/[fsync]/close/rename submission
+// and each open a single open/statx one, instead of a system call apiece.
+class FileChunkStore : public ChunkStore {
+public:
+    // With syncWrites, put() fsyncs each chunk and its directory before
+    // returning. URING falls back to POSIX where io_uring is unavailable.
+    explicit FileChunkStore(const std::string& directory, bool syncWrites = false,
+                            common::IoBackend backend = common::IoBackend::POSIX);
+
+    bool isOpen() const { return open_; }
+    common::IoBackend backend() const { return backend_; }
+    bool put(const common::Digest& key, std::vector<uint8_t> data) override;
+    bool putBytes(const common::Digest& key, const uint8_t* data, size_t len) override;
+    bool get(const common::Digest& key, std::vector<uint8_t>& data) override;
+    bool erase(const common::Digest& key) override;
+    bool contains(const common::Digest& key) override;
+    bool openChunk(const common::Digest& key, ChunkFile& file) override;
+    size_t chunkCount() override;
+    const char* name() const override { return "files"; }
+
+private:
+    std::string directoryFor(const std::string& hex) const;
+    bool loadExisting();
+    bool makeShard(const std::string& hex);
+    bool writePosix(const std::string& temp, const std::string& path, const uint8_t* data, size_t len);
+    bool writeUring(const std::string& temp, const std::string& path, const uint8_t* data, size_t len);
+    // Open, locked against erase, and size of a stored chunk file.
+    int openLocked(const common::Digest& key, size_t& size);
+
+    const std::string directory_;
+    const bool syncWrites_;
+    common::IoBackend backend_;
+    bool open_{false};
+    std::unordered_set<common::Digest> keys_;
+    std::mutex mutex_;
+    // Distinguishes the temporary files of concurrent puts of one chunk.
+    std::atomic<uint64_t> tempSequence_{0};
+    // Shard directories known to exist, by their first digest byte.
+    std::atomic<bool> shardMade_[256] = {};
+};
+
+}  // namespace storage
+}  // namespace dfs
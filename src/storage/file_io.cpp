@@ -0,0 +1,57 @@
+#include "storage/file_io.hpp"
+#include "common/io_stats.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dfs {
+namespace storage {
+
+bool readFully(int fd, uint8_t* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        common::countSyscalls();
+        ssize_t n = ::pread(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool writeFully(int fd, const uint8_t* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        common::countSyscalls();
+        ssize_t n = ::pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool makeDirectories(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos < path.size() && path[pos] != '/') continue;
+        std::string prefix = path.substr(0, pos);
+        common::countSyscalls();
+        if (::mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+void syncDirectory(const std::string& path) {
+    common::countSyscalls();
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return;
+    common::countSyscalls(2);
+    ::fsync(fd);
+    ::close(fd);
+}
+
+}  // namespace storage
+}  // namespace dfs
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dfs {
+namespace storage {
+
+// POSIX helpers shared by the on-disk chunk stores; all retry on EINTR.
+bool readFully(int fd, uint8_t* data, size_t len, uint64_t offset);
+bool writeFully(int fd, const uint8_t* data, size_t len, uint64_t offset);
+// mkdir -p; true if the directory exists afterwards.
+bool makeDirectories(const std::string& path);
+// Makes created, renamed or deleted directory entries durable.
+void syncDirectory(const std::string& path);
+
+}  // namespace storage
+}  // namespace dfs
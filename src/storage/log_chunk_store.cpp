@@ -0,0 +1,463 @@
+#include "storage/log_chunk_store.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/crc32c.hpp"
+#include "common/io_stats.hpp"
+#include "storage/file_io.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace dfs {
+namespace storage {
+
+namespace {
+
+// Record layout, little-endian:
+//   0  magic     u32
+//   4  type      u8 (+3 bytes zero)
+//   8  length    u32, payload bytes
+//   12 digest    32 bytes
+//   44 checksum  u32, CRC-32C of bytes 0-43 and the payload
+//   48 payload
+const uint32_t kRecordMagic = 0x4b4e4843;  // "CHNK"
+const size_t kHeaderSize = 48;
+const size_t kChecksumOffset = 44;
+const uint8_t kPutRecord = 1;
+const uint8_t kTombstoneRecord = 2;
+
+struct RecordHeader {
+    uint8_t type{0};
+    uint32_t length{0};
+    common::Digest key;
+    uint32_t checksum{0};
+};
+
+void encodeHeader(uint8_t out[kHeaderSize], uint8_t type, const common::Digest& key, const uint8_t* data,
+                  uint32_t len) {
+    memset(out, 0, kHeaderSize);
+    memcpy(out, &kRecordMagic, 4);
+    out[4] = type;
+    memcpy(out + 8, &len, 4);
+    memcpy(out + 12, key.bytes.data(), common::Digest::kSize);
+    uint32_t checksum = common::crc32c(data, len, common::crc32c(out, kChecksumOffset));
+    memcpy(out + kChecksumOffset, &checksum, 4);
+}
+
+bool decodeHeader(const uint8_t in[kHeaderSize], RecordHeader& header) {
+    uint32_t magic;
+    memcpy(&magic, in, 4);
+    if (magic != kRecordMagic) return false;
+    header.type = in[4];
+    memcpy(&header.length, in + 8, 4);
+    memcpy(header.key.bytes.data(), in + 12, common::Digest::kSize);
+    memcpy(&header.checksum, in + kChecksumOffset, 4);
+    if (header.type == kTombstoneRecord) return header.length == 0;
+    return header.type == kPutRecord;
+}
+
+bool checksumMatches(const uint8_t header[kHeaderSize], const RecordHeader& decoded, const uint8_t* payload) {
+    return common::crc32c(payload, decoded.length, common::crc32c(header, kChecksumOffset)) == decoded.checksum;
+}
+
+bool writeRecord(int fd, const uint8_t* header, const uint8_t* data, size_t len, uint64_t offset) {
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<uint8_t*>(header);
+    iov[0].iov_len = kHeaderSize;
+    iov[1].iov_base = const_cast<uint8_t*>(data);
+    iov[1].iov_len = len;
+    struct iovec* next = iov;
+    int count = len > 0 ? 2 : 1;
+    while (count > 0) {
+        common::countSyscalls();
+        ssize_t n = ::pwritev(fd, next, count, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        offset += static_cast<uint64_t>(n);
+        size_t written = static_cast<size_t>(n);
+        while (count > 0 && written >= next->iov_len) {
+            written -= next->iov_len;
+            ++next;
+            --count;
+        }
+        if (count > 0) {
+            next->iov_base = static_cast<uint8_t*>(next->iov_base) + written;
+            next->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+std::string segmentPath(const std::string& directory, uint32_t id) {
+    char name[32];
+    snprintf(name, sizeof(name), "segment-%08u.log", id);
+    return directory + "/" + name;
+}
+
+}  // namespace
+
+LogChunkStore::Segment::~Segment() {
+    if (fd >= 0) ::close(fd);
+}
+
+LogChunkStore::LogChunkStore(const std::string& directory, LogStoreOptions options)
+    : directory_(directory), options_(options) {
+    if (!openSegments()) {
+        std::cerr << "Error: could not open chunk log in " << directory_ << std::endl;
+        return;
+    }
+    open_ = true;
+    maintenance_ = std::thread([this]() { maintenanceLoop(); });
+}
+
+LogChunkStore::~LogChunkStore() {
+    {
+        std::lock_guard<std::mutex> lock(maintenanceMutex_);
+        stopping_ = true;
+    }
+    maintenanceCv_.notify_all();
+    if (maintenance_.joinable()) maintenance_.join();
+    if (active_ && options_.fsync != FsyncPolicy::NEVER) ::fdatasync(active_->fd);
+}
+
+bool LogChunkStore::openSegments() {
+    if (!makeDirectories(directory_)) return false;
+    DIR* dir = ::opendir(directory_.c_str());
+    if (!dir) return false;
+    std::vector<uint32_t> ids;
+    while (struct dirent* entry = ::readdir(dir)) {
+        unsigned id;
+        char suffix[8];
+        if (sscanf(entry->d_name, "segment-%8u.%7s", &id, suffix) == 2 && std::string(suffix) == "log") {
+            ids.push_back(id);
+        }
+    }
+    ::closedir(dir);
+    std::sort(ids.begin(), ids.end());
+
+    for (uint32_t id : ids) {
+        auto segment = std::make_shared<Segment>();
+        segment->id = id;
+        segment->path = segmentPath(directory_, id);
+        segment->fd = ::open(segment->path.c_str(), O_RDWR);
+        if (segment->fd < 0) return false;
+        segments_[id] = segment;
+    }
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        if (!replay(it->second, std::next(it) == segments_.end())) return false;
+    }
+    active_ = segments_.empty() ? createSegment(1) : segments_.rbegin()->second;
+    if (!active_) return false;
+    segments_[active_->id] = active_;
+    return true;
+}
+
+bool LogChunkStore::replay(const std::shared_ptr<Segment>& segment, bool newest) {
+    struct stat st {};
+    if (::fstat(segment->fd, &st) != 0) return false;
+    const uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = 0;
+    uint8_t raw[kHeaderSize];
+    std::vector<uint8_t> payload;
+    while (offset + kHeaderSize <= fileSize && readFully(segment->fd, raw, kHeaderSize, offset)) {
+        RecordHeader header;
+        if (!decodeHeader(raw, header) || offset + kHeaderSize + header.length > fileSize) break;
+        payload.resize(header.length);
+        if (!readFully(segment->fd, payload.data(), header.length, offset + kHeaderSize)) break;
+        if (!checksumMatches(raw, header, payload.data())) break;
+
+        // Segments are replayed oldest first, so a later record for the same
+        // key supersedes the earlier one.
+        auto it = index_.find(header.key);
+        if (it != index_.end()) {
+            dropLocked(it->second);
+            index_.erase(it);
+        }
+        if (header.type == kPutRecord) {
+            index_[header.key] = Location{segment, offset, header.length};
+            segment->liveBytes += kHeaderSize + header.length;
+        }
+        offset += kHeaderSize + header.length;
+    }
+
+    segment->size = fileSize;
+    if (offset < fileSize) {
+        if (newest) {
+            // A write that was cut short by a crash; later appends go after
+            // the last intact record.
+            std::cerr << "Truncating " << (fileSize - offset) << " torn bytes from " << segment->path << std::endl;
+            if (::ftruncate(segment->fd, static_cast<off_t>(offset)) != 0) return false;
+            segment->size = offset;
+        } else {
+            // Left in place and counted as dead, so compaction reclaims it.
+            std::cerr << "Skipping corrupt records after offset " << offset << " in " << segment->path << std::endl;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<LogChunkStore::Segment> LogChunkStore::createSegment(uint32_t id) {
+    auto segment = std::make_shared<Segment>();
+    segment->id = id;
+    segment->path = segmentPath(directory_, id);
+    segment->fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (segment->fd < 0) {
+        std::cerr << "Error: could not create " << segment->path << std::endl;
+        return nullptr;
+    }
+    if (options_.fsync != FsyncPolicy::NEVER) syncDirectory(directory_);
+    return segment;
+}
+
+bool LogChunkStore::appendLocked(uint8_t type, const common::Digest& key, const uint8_t* data, uint32_t len,
+                                 Location& location) {
+    const uint64_t recordBytes = kHeaderSize + len;
+    if (active_->size > 0 && active_->size + recordBytes > options_.segmentBytes) {
+        // Sealing the segment syncs it, so group commit only ever has to
+        // sync the active one.
+        if (options_.fsync != FsyncPolicy::NEVER) {
+            common::countSyscalls();
+            ::fdatasync(active_->fd);
+        }
+        std::shared_ptr<Segment> next = createSegment(active_->id + 1);
+        if (!next) return false;
+        segments_[next->id] = next;
+        active_ = next;
+    }
+    uint8_t header[kHeaderSize];
+    encodeHeader(header, type, key, data, len);
+    if (!writeRecord(active_->fd, header, data, len, active_->size)) {
+        std::cerr << "Error: append to " << active_->path << " failed" << std::endl;
+        // Drop whatever part of the record made it, so replay stays clean.
+        if (::ftruncate(active_->fd, static_cast<off_t>(active_->size)) != 0) open_ = false;
+        return false;
+    }
+    location = Location{active_, active_->size, len};
+    active_->size += recordBytes;
+    if (type == kPutRecord) active_->liveBytes += recordBytes;
+    appendSequence_++;
+    return true;
+}
+
+void LogChunkStore::dropLocked(const Location& location) {
+    location.segment->liveBytes -= kHeaderSize + location.length;
+}
+
+void LogChunkStore::syncAppended(uint64_t sequence) {
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+    // Another caller's fdatasync may already have covered this append.
+    if (syncedSequence_ >= sequence) return;
+    std::shared_ptr<Segment> segment;
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segment = active_;
+        target = appendSequence_;
+    }
+    common::countSyscalls();
+    if (::fdatasync(segment->fd) == 0) syncedSequence_ = target;
+}
+
+bool LogChunkStore::put(const common::Digest& key, std::vector<uint8_t> data) {
+    bool stored = putBytes(key, data.data(), data.size());
+    common::BufferPool::shared().release(std::move(data));
+    return stored;
+}
+
+bool LogChunkStore::putBytes(const common::Digest& key, const uint8_t* data, size_t len) {
+    if (len > UINT32_MAX - kHeaderSize) return false;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_) return false;
+        if (index_.count(key) == 0) {
+            Location location;
+            if (!appendLocked(kPutRecord, key, data, static_cast<uint32_t>(len), location)) {
+                return false;
+            }
+            index_[key] = location;
+        }
+        sequence = appendSequence_;
+    }
+    if (options_.fsync == FsyncPolicy::ALWAYS) syncAppended(sequence);
+    return true;
+}
+
+bool LogChunkStore::get(const common::Digest& key, std::vector<uint8_t>& data) {
+    Location location;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) return false;
+        location = it->second;
+    }
+    data.resize(location.length);
+    return readFully(location.segment->fd, data.data(), location.length, location.offset + kHeaderSize);
+}
+
+bool LogChunkStore::openChunk(const common::Digest& key, ChunkFile& file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    // A duplicate keeps the record readable after compaction unlinks it.
+    common::countSyscalls();
+    int fd = ::dup(it->second.segment->fd);
+    if (fd < 0) return false;
+    file = ChunkFile(fd, it->second.offset + kHeaderSize, it->second.length);
+    return true;
+}
+
+bool LogChunkStore::erase(const common::Digest& key) {
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_) return false;
+        auto it = index_.find(key);
+        if (it == index_.end()) return false;
+        Location tombstone;
+        if (!appendLocked(kTombstoneRecord, key, nullptr, 0, tombstone)) return false;
+        dropLocked(it->second);
+        index_.erase(it);
+        sequence = appendSequence_;
+    }
+    if (options_.fsync == FsyncPolicy::ALWAYS) syncAppended(sequence);
+    return true;
+}
+
+bool LogChunkStore::contains(const common::Digest& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.count(key) > 0;
+}
+
+size_t LogChunkStore::chunkCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+size_t LogChunkStore::segmentCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
+
+size_t LogChunkStore::compact() {
+    std::lock_guard<std::mutex> compactLock(compactMutex_);
+    std::vector<std::shared_ptr<Segment>> victims;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_) return 0;
+        for (const auto& entry : segments_) {
+            const std::shared_ptr<Segment>& segment = entry.second;
+            if (segment == active_ || segment->size == 0) continue;
+            double dead = static_cast<double>(segment->size - segment->liveBytes);
+            if (dead >= options_.compactRatio * static_cast<double>(segment->size)) victims.push_back(segment);
+        }
+    }
+    size_t reclaimed = 0;
+    for (const auto& segment : victims) {
+        if (compactSegment(segment)) reclaimed++;
+    }
+    return reclaimed;
+}
+
+bool LogChunkStore::compactSegment(const std::shared_ptr<Segment>& segment) {
+    bool oldest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        oldest = segments_.begin()->second == segment;
+    }
+    // Sealed segments never change, so records are read without the lock and
+    // only moved if the index still points at them once it is held.
+    uint64_t offset = 0;
+    uint8_t raw[kHeaderSize];
+    std::vector<uint8_t> payload;
+    while (offset + kHeaderSize <= segment->size) {
+        if (!readFully(segment->fd, raw, kHeaderSize, offset)) return false;
+        RecordHeader header;
+        if (!decodeHeader(raw, header) || offset + kHeaderSize + header.length > segment->size) break;
+        const uint64_t recordOffset = offset;
+        offset += kHeaderSize + header.length;
+
+        if (header.type == kTombstoneRecord) {
+            // Still needed while an older segment may hold the deleted chunk,
+            // unless the chunk has been stored again since.
+            if (oldest) continue;
+            std::lock_guard<std::mutex> lock(mutex_);
+            Location moved;
+            if (index_.count(header.key) == 0 && !appendLocked(kTombstoneRecord, header.key, nullptr, 0, moved)) {
+                return false;
+            }
+            continue;
+        }
+
+        auto isLive = [&](const Location& location) {
+            return location.segment == segment && location.offset == recordOffset;
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(header.key);
+            if (it == index_.end() || !isLive(it->second)) continue;
+        }
+        payload.resize(header.length);
+        if (!readFully(segment->fd, payload.data(), header.length, recordOffset + kHeaderSize)) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(header.key);
+        if (it == index_.end() || !isLive(it->second)) continue;
+        if (!checksumMatches(raw, header, payload.data())) {
+            std::cerr << "Dropping corrupt chunk " << header.key << " from " << segment->path << std::endl;
+            dropLocked(it->second);
+            index_.erase(it);
+            continue;
+        }
+        Location moved;
+        if (!appendLocked(kPutRecord, header.key, payload.data(), header.length, moved)) return false;
+        dropLocked(it->second);
+        it->second = moved;
+    }
+
+    // The moved records must be durable before their old copies go away.
+    if (options_.fsync != FsyncPolicy::NEVER) {
+        uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sequence = appendSequence_;
+        }
+        syncAppended(sequence);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.erase(segment->id);
+    }
+    // Readers that already looked up a location keep the file open until
+    // they finish.
+    ::unlink(segment->path.c_str());
+    return true;
+}
+
+void LogChunkStore::maintenanceLoop() {
+    const auto period =
+        options_.fsync == FsyncPolicy::INTERVAL ? options_.syncInterval : std::chrono::milliseconds(1000);
+    std::unique_lock<std::mutex> lock(maintenanceMutex_);
+    while (!maintenanceCv_.wait_for(lock, period, [this]() { return stopping_; })) {
+        lock.unlock();
+        if (options_.fsync == FsyncPolicy::INTERVAL) {
+            uint64_t sequence;
+            {
+                std::lock_guard<std::mutex> storeLock(mutex_);
+                sequence = appendSequence_;
+            }
+            syncAppended(sequence);
+        }
+        compact();
+        lock.lock();
+    }
+}
+
+}  // namespace storage
+}  // namespace dfs
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "storage/chunk_store.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace dfs {
+namespace storage {
+
+// When appended records are forced to disk.
+// ALWAYS: put() and erase() return after fdatasync; concurrent callers share
+//         one sync (group commit).
+// INTERVAL: the background thread syncs every syncInterval.
+// NEVER: left to kernel writeback.
+enum class FsyncPolicy { ALWAYS, INTERVAL, NEVER };
+
+struct LogStoreOptions {
+    uint64_t segmentBytes{64ull * 1024 * 1024};
+    FsyncPolicy fsync{FsyncPolicy::INTERVAL};
+    std::chrono::milliseconds syncInterval{100};
+    // A sealed segment is rewritten once this fraction of it is dead.
+    double compactRatio{0.5};
+};
+
+// Append-only log of checksummed chunk records in segment-NNNNNNNN.log files
+// under `directory`, with an in-memory digest -> (segment, offset, length)
+// index rebuilt by replaying the segments on open. A torn record at the end
+// of the newest segment is truncated away. Erase appends a tombstone; a
+// background thread compacts sealed segments that are mostly dead and
+// applies the INTERVAL fsync policy.
+class LogChunkStore : public ChunkStore {
+public:
+    explicit LogChunkStore(const std::string& directory, LogStoreOptions options = LogStoreOptions());
+    ~LogChunkStore() override;
+    LogChunkStore(const LogChunkStore&) = delete;
+    LogChunkStore& operator=(const LogChunkStore&) = delete;
+
+    bool isOpen() const { return open_; }
+    bool put(const common::Digest& key, std::vector<uint8_t> data) override;
+    bool putBytes(const common::Digest& key, const uint8_t* data, size_t len) override;
+    bool get(const common::Digest& key, std::vector<uint8_t>& data) override;
+    bool erase(const common::Digest& key) override;
+    bool contains(const common::Digest& key) override;
+    bool openChunk(const common::Digest& key, ChunkFile& file) override;
+    size_t chunkCount() override;
+    const char* name() const override { return "log"; }
+
+    // Rewrites every sealed segment past compactRatio and deletes it; returns
+    // how many segments were reclaimed. Normally run by the background thread.
+    size_t compact();
+    size_t segmentCount();
+
+private:
+    struct Segment {
+        uint32_t id{0};
+        std::string path;
+        int fd{-1};
+        uint64_t size{0};       // bytes of records, including dead ones
+        uint64_t liveBytes{0};  // bytes of records the index points at
+        ~Segment();
+    };
+    struct Location {
+        std::shared_ptr<Segment> segment;
+        uint64_t offset{0};  // of the record header
+        uint32_t length{0};  // payload bytes
+    };
+
+    bool openSegments();
+    bool replay(const std::shared_ptr<Segment>& segment, bool newest);
+    std::shared_ptr<Segment> createSegment(uint32_t id);
+    bool appendLocked(uint8_t type, const common::Digest& key, const uint8_t* data, uint32_t len,
+                      Location& location);
+    void dropLocked(const Location& location);
+    void syncAppended(uint64_t sequence);
+    bool compactSegment(const std::shared_ptr<Segment>& segment);
+    void maintenanceLoop();
+
+    const std::string directory_;
+    const LogStoreOptions options_;
+    bool open_{false};
+
+    // Guards the index, the segment list and appends to the active segment.
+    // Reads of record bytes happen outside it: segments are append-only and a
+    // Location keeps its segment's file open.
+    std::mutex mutex_;
+    std::unordered_map<common::Digest, Location> index_;
+    std::map<uint32_t, std::shared_ptr<Segment>> segments_;
+    std::shared_ptr<Segment> active_;
+    uint64_t appendSequence_{0};
+
+    std::mutex syncMutex_;
+    uint64_t syncedSequence_{0};
+
+    std::mutex compactMutex_;
+
+    std::mutex maintenanceMutex_;
+    std::condition_variable maintenanceCv_;
+    bool stopping_{false};
+    std::thread maintenance_;
+};
+
+}  // namespace storage
+}  // namespace dfs
@@ -0,0 +1,64 @@
+#include "storage/memory_chunk_store.hpp"
+#include "common/buffer_pool.hpp"
+
+namespace dfs {
+namespace storage {
+
+MemoryChunkStore::Shard& MemoryChunkStore::shardFor(const common::Digest& key) {
+    // Digests are uniform, and std::hash<Digest> reads the leading bytes, so
+    // the last byte picks a shard independently of the bucket.
+    return shards_[key.bytes[common::Digest::kSize - 1] % kShards];
+}
+
+bool MemoryChunkStore::put(const common::Digest& key, std::vector<uint8_t> data) {
+    // A pooled buffer can be up to twice the chunk's size: keep an exact
+    // copy for good and recycle the buffer.
+    if (data.capacity() - data.size() > data.size() / 4) {
+        std::vector<uint8_t> exact(data.begin(), data.end());
+        common::BufferPool::shared().release(std::move(data));
+        data = std::move(exact);
+    }
+    // Wrapped before locking; a duplicate put just drops the new buffer.
+    SharedChunk chunk = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.chunks.emplace(key, std::move(chunk)).second) count_++;
+    return true;
+}
+
+bool MemoryChunkStore::get(const common::Digest& key, std::vector<uint8_t>& data) {
+    SharedChunk chunk = getShared(key);
+    if (!chunk) return false;
+    data = *chunk;
+    return true;
+}
+
+SharedChunk MemoryChunkStore::getShared(const common::Digest& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.chunks.find(key);
+    if (it == shard.chunks.end()) return nullptr;
+    return it->second;
+}
+
+bool MemoryChunkStore::erase(const common::Digest& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Readers still holding the buffer keep it alive until they finish.
+    if (shard.chunks.erase(key) == 0) return false;
+    count_--;
+    return true;
+}
+
+bool MemoryChunkStore::contains(const common::Digest& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.chunks.count(key) > 0;
+}
+
+size_t MemoryChunkStore::chunkCount() {
+    return count_.load();
+}
+
+}  // namespace storage
+}  // namespace dfs
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "storage/chunk_store.hpp"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace dfs {
+namespace storage {
+
+// Chunks held in RAM; capacity is the node's memory and a restart loses them.
+// The table is split into shards, each with its own lock, and every chunk is
+// an immutable shared buffer: a GET only holds its shard's lock long enough
+// to take a reference, so readers of different chunks never contend and
+// readers of the same chunk never copy under a lock.
+class MemoryChunkStore : public ChunkStore {
+public:
+    bool put(const common::Digest& key, std::vector<uint8_t> data) override;
+    bool get(const common::Digest& key, std::vector<uint8_t>& data) override;
+    SharedChunk getShared(const common::Digest& key) override;
+    bool erase(const common::Digest& key) override;
+    bool contains(const common::Digest& key) override;
+    size_t chunkCount() override;
+    const char* name() const override { return "memory"; }
+
+private:
+    static constexpr size_t kShards = 64;
+
+    // Cache-line aligned so neighbouring shards' locks do not false-share.
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<common::Digest, SharedChunk> chunks;
+    };
+
+    Shard& shardFor(const common::Digest& key);
+
+    Shard shards_[kShards];
+    std::atomic<size_t> count_{0};
+};
+
+}  // namespace storage
+}  // namespace dfs
@@ -1,24 +1,59 @@
 #include "storage/storage_node.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/sha256.hpp"
+#include "storage/memory_chunk_store.hpp"
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 namespace dfs {
 namespace storage {
 
-StorageNode::StorageNode() = default;
+StorageNode::StorageNode(std::unique_ptr<ChunkStore> store)
+    : store_(store ? std::move(store) : std::unique_ptr<ChunkStore>(new MemoryChunkStore())) {}
 
 StorageNode::~StorageNode() {
     running_ = false;
     server_.stop();
 }
 
-void StorageNode::start(int port) {
+void StorageNode::setArtificialDelay(std::chrono::milliseconds delay, double probability) {
+    artificialDelay_ = delay;
+    delayProbability_ = probability;
+}
+
+void StorageNode::setCacheBudget(size_t bytes) {
+    cache_.reset(bytes > 0 ? new ChunkCache(bytes) : nullptr);
+}
+
+void StorageNode::start(int port, dfs::network::ServerMode mode) {
     if (!server_.start(port)) {
         std::cerr << "Failed to start storage node on port " << port << std::endl;
         return;
     }
     running_ = true;
-    std::cout << "Storage Node started on port " << port << std::endl;
+    muxWorkers_.reset(new common::ThreadPool(kMultiplexWorkers));
+    std::cout << "Storage Node started on port " << port << " (" << store_->name() << " store)" << std::endl;
+
+    if (mode != dfs::network::ServerMode::THREADED) {
+        server_.runEventLoop(
+            [this](dfs::network::Connection& conn, std::vector<uint8_t> frame) {
+                ClientSession* session;
+                {
+                    std::lock_guard<std::mutex> lock(sessionsMutex_);
+                    session = &sessions_[conn.id()];
+                }
+                if (!handleFrame(conn, *session, std::move(frame))) server_.closeClient(conn.id());
+            },
+            [this](int clientId) {
+                std::lock_guard<std::mutex> lock(sessionsMutex_);
+                sessions_.erase(clientId);
+            },
+            0, mode);
+        muxWorkers_->shutdown();
+        return;
+    }
 
     while (running_) {
         int clientId = server_.acceptClient();
@@ -34,65 +69,409 @@ void StorageNode::start(int port) {
     // Wait for all client handlers to finish before destroying server
     std::unique_lock<std::mutex> lock(handlersMutex_);
     handlersCv_.wait(lock, [this]() { return activeHandlers_.load() == 0; });
+    muxWorkers_->shutdown();
 }
 
 void StorageNode::handleClient(int clientId) {
+    auto conn = server_.connection(clientId);
+    if (!conn) return;
+    ClientSession session;
     while (running_) {
-        std::string command = server_.recvMessage(clientId);
-        if (command.empty()) break;
-
-        std::istringstream iss(command);
-        std::string op;
-        iss >> op;
-
-        if (op == "STORE") {
-            std::string hash;
-            if (!(iss >> hash)) {
-                server_.sendMessage(clientId, "ERROR");
-                continue;
-            }
-            server_.sendMessage(clientId, "READY");
-            auto data = server_.recvData(clientId);
-            if (!data.empty()) {
-                size_t sz = data.size();
-                {
-                    std::lock_guard<std::mutex> lock(storageMutex_);
-                    storage_[hash] = std::move(data);
-                }
-                server_.sendMessage(clientId, "ACK");
-                std::cout << "Stored chunk: " << hash << " (" << sz << " bytes)" << std::endl;
-            } else {
-                break;
-            }
-        } else if (op == "GET") {
-            std::string hash;
-            if (!(iss >> hash)) {
-                server_.sendMessage(clientId, "ERROR");
-                continue;
+        if (!handleFrame(*conn, session, conn->recvData())) break;
+    }
+    server_.closeClient(clientId);
+}
+
+namespace {
+
+using dfs::network::MessageWriter;
+using dfs::network::Opcode;
+using dfs::network::Status;
+
+// The text protocol's word for `status` in reply to `op`.
+const char* textReply(Opcode op, Status status) {
+    switch (status) {
+    case Status::OK:
+        return (op == Opcode::GET || op == Opcode::GET_RANGE || op == Opcode::HAS) ? "FOUND" : "ACK";
+    case Status::READY:
+        return "READY";
+    case Status::NOT_FOUND:
+        return "NOT_FOUND";
+    default:
+        return "ERROR";
+    }
+}
+
+}  // namespace
+
+bool StorageNode::parseRequest(const std::vector<uint8_t>& frame, Request& request) {
+    dfs::network::MessageReader payload;
+    if (dfs::network::parseMessage(frame, request.header, payload)) {
+        request.binary = true;
+        request.op = request.header.opcode;
+        uint32_t count = 0;
+        switch (request.op) {
+        case Opcode::STORE:
+            // Multiplexed: the rest of the payload is the chunk.
+            if (request.header.flags & dfs::network::kFlagMultiplexed) {
+                request.digests.resize(1);
+                payload.digest(request.digests[0]);
+                request.dataOffset = frame.size() - payload.remaining();
+                return payload.ok() && payload.remaining() > 0;
             }
-            std::vector<uint8_t> data;
-            {
-                std::lock_guard<std::mutex> lock(storageMutex_);
-                auto it = storage_.find(hash);
-                if (it != storage_.end()) data = it->second;
+            count = 1;
+            break;
+        case Opcode::GET:
+        case Opcode::DELETE:
+        case Opcode::HAS:
+            count = 1;
+            break;
+        case Opcode::GET_RANGE:
+            request.digests.resize(1);
+            payload.digest(request.digests[0]);
+            payload.u64(request.rangeOffset);
+            payload.u32(request.rangeLength);
+            return payload.ok() && payload.remaining() == 0 && request.rangeLength > 0;
+        case Opcode::HAS_MULTI:
+        case Opcode::GET_MULTI:
+            if (!payload.u32(count) || count > payload.remaining() / common::Digest::kSize) return false;
+            break;
+        case Opcode::STORE_MULTI: {
+            if (!payload.u32(count) || count > payload.remaining() / (common::Digest::kSize + 4)) return false;
+            request.digests.resize(count);
+            request.extents.resize(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t len = 0;
+                const uint8_t* data = nullptr;
+                if (!payload.digest(request.digests[i]) || !payload.u32(len) || !payload.bytes(data, len)) return false;
+                request.extents[i] = {static_cast<size_t>(data - frame.data()), len};
             }
-            if (!data.empty()) {
-                server_.sendMessage(clientId, "FOUND");
-                server_.sendData(clientId, data);
-                std::cout << "Served chunk: " << hash << std::endl;
-            } else {
-                server_.sendMessage(clientId, "NOT_FOUND");
+            return payload.remaining() == 0;
+        }
+        case Opcode::STATS:
+        case Opcode::DIE:
+            break;
+        default:
+            return false;
+        }
+        request.digests.resize(count);
+        for (auto& digest : request.digests) payload.digest(digest);
+        return payload.ok() && payload.remaining() == 0;
+    }
+    // A frame that starts like a binary message but fails to parse is not
+    // retried as text.
+    if (dfs::network::isBinaryFrame(frame)) {
+        request.binary = true;
+        return false;
+    }
+
+    std::istringstream iss(std::string(frame.begin(), frame.end()));
+    std::string op, arg;
+    iss >> op;
+    if (op == "STORE") {
+        request.op = Opcode::STORE;
+    } else if (op == "GET") {
+        request.op = Opcode::GET;
+    } else if (op == "GET_RANGE") {
+        // "GET_RANGE <hex> <offset> <length>"
+        request.op = Opcode::GET_RANGE;
+        request.digests.resize(1);
+        return static_cast<bool>(iss >> arg >> request.rangeOffset >> request.rangeLength) &&
+               request.rangeLength > 0 && common::Digest::fromHex(arg, request.digests[0]);
+    } else if (op == "DELETE") {
+        request.op = Opcode::DELETE;
+    } else if (op == "HAS") {
+        request.op = Opcode::HAS;
+    } else if (op == "HAS_MULTI") {
+        // "HAS_MULTI <hex>,<hex>,..."
+        request.op = Opcode::HAS_MULTI;
+        if (!(iss >> arg)) return false;
+        request.digests.reserve(arg.size() / (common::Digest::kSize * 2 + 1) + 1);
+        std::istringstream hs(arg);
+        std::string hex;
+        while (std::getline(hs, hex, ',')) {
+            request.digests.emplace_back();
+            if (!common::Digest::fromHex(hex, request.digests.back())) return false;
+        }
+        return true;
+    } else if (op == "STATS") {
+        request.op = Opcode::STATS;
+        return true;
+    } else if (op == "DIE") {
+        request.op = Opcode::DIE;
+        return true;
+    } else {
+        return false;
+    }
+    request.digests.resize(1);
+    return static_cast<bool>(iss >> arg) && common::Digest::fromHex(arg, request.digests[0]);
+}
+
+void StorageNode::reply(dfs::network::Connection& conn, const Request& request, Status status) {
+    if (request.binary) {
+        conn.sendData(MessageWriter::response(request.header, status).finish());
+    } else {
+        conn.sendMessage(textReply(request.op, status));
+    }
+}
+
+bool StorageNode::handleFrame(dfs::network::Connection& conn, ClientSession& session, std::vector<uint8_t> frame) {
+    if (session.awaitingData) {
+        session.awaitingData = false;
+        if (frame.empty()) return false;
+        const common::Digest& hash = session.store.digests[0];
+        size_t sz = frame.size();
+        if (conn.frameDigest() != hash) {
+            std::cerr << "Rejected chunk " << hash << ": content hashes to " << conn.frameDigest() << std::endl;
+            reply(conn, session.store, Status::ERROR);
+            return true;
+        }
+        if (!store_->put(hash, std::move(frame))) {
+            std::cerr << "Failed to store chunk " << hash << std::endl;
+            reply(conn, session.store, Status::ERROR);
+            return true;
+        }
+        reply(conn, session.store, Status::OK);
+        if (verbose_) std::cout << "Stored chunk: " << hash << " (" << sz << " bytes)" << std::endl;
+        return true;
+    }
+
+    if (frame.empty()) return false;
+    Request request;
+    if (!parseRequest(frame, request)) {
+        reply(conn, request, request.binary ? Status::BAD_REQUEST : Status::ERROR);
+        return true;
+    }
+    if ((request.header.flags & dfs::network::kFlagMultiplexed) && request.op != Opcode::DIE) {
+        // Past kMaxMultiplexedRequests the request runs here instead, which
+        // holds up this connection's next frame; the reactor then stops
+        // reading the socket once its queue of frames is full.
+        std::shared_ptr<dfs::network::Connection> shared = server_.connection(conn.id());
+        if (shared && muxWorkers_ && shared->startRequest(kMaxMultiplexedRequests)) {
+            using Task = std::pair<Request, std::vector<uint8_t>>;
+            auto task = std::make_shared<Task>(std::move(request), std::move(frame));
+            bool submitted = muxWorkers_->submit([this, shared, task]() {
+                execute(*shared, nullptr, task->first, task->second);
+                shared->finishRequest();
+            });
+            if (submitted) return true;
+            shared->finishRequest();
+            return execute(conn, nullptr, task->first, task->second);
+        }
+        return execute(conn, nullptr, request, frame);
+    }
+    return execute(conn, &session, request, frame);
+}
+
+bool StorageNode::execute(dfs::network::Connection& conn, ClientSession* session, Request& request,
+                          std::vector<uint8_t>& frame) {
+    const common::Digest* hash = request.digests.empty() ? nullptr : &request.digests[0];
+
+    switch (request.op) {
+    case Opcode::STORE:
+        if (!session) {
+            // The data came with the request; nothing hashed it on arrival.
+            const uint8_t* data = frame.data() + request.dataOffset;
+            size_t sz = frame.size() - request.dataOffset;
+            if (common::sha256(data, sz) != *hash) {
+                std::cerr << "Rejected chunk " << *hash << ": content does not match" << std::endl;
+                reply(conn, request, Status::ERROR);
+                break;
             }
-        } else if (op == "DIE") {
-            std::cout << "Received DIE command. Stopping..." << std::endl;
-            running_ = false;
-            server_.stop();
+            bool stored = store_->putBytes(*hash, data, sz);
+            common::BufferPool::shared().release(std::move(frame));
+            if (!stored) std::cerr << "Failed to store chunk " << *hash << std::endl;
+            reply(conn, request, stored ? Status::OK : Status::ERROR);
+            if (verbose_ && stored) std::cout << "Stored chunk: " << *hash << " (" << sz << " bytes)" << std::endl;
             break;
+        }
+        session->store = std::move(request);
+        session->awaitingData = true;
+        // Armed before READY: the client only sends the data after seeing it.
+        conn.hashNextFrame();
+        reply(conn, session->store, Status::READY);
+        break;
+    case Opcode::GET:
+    case Opcode::GET_RANGE:
+        handleGet(conn, request);
+        break;
+    case Opcode::STORE_MULTI:
+        handleStoreMulti(conn, request, frame);
+        break;
+    case Opcode::GET_MULTI:
+        handleGetMulti(conn, request);
+        break;
+    case Opcode::DELETE: {
+        // Dropped from the store first: a GET that read the chunk before
+        // can then no longer insert it (see ChunkCache::insert), and the
+        // cache erase removes what such GETs inserted earlier.
+        bool erased = store_->erase(*hash);
+        if (cache_) cache_->erase(*hash);
+        reply(conn, request, erased ? Status::OK : Status::NOT_FOUND);
+        if (verbose_ && erased) std::cout << "Deleted chunk: " << *hash << std::endl;
+        break;
+    }
+    case Opcode::HAS:
+        reply(conn, request, store_->contains(*hash) ? Status::OK : Status::NOT_FOUND);
+        break;
+    case Opcode::HAS_MULTI: {
+        // Text: "PRESENT <bits>", one '1' or '0' per digest in request order.
+        // Binary: the same answers packed eight to a byte.
+        if (request.binary) {
+            std::vector<uint8_t> bitmap((request.digests.size() + 7) / 8, 0);
+            for (size_t i = 0; i < request.digests.size(); ++i) {
+                if (store_->contains(request.digests[i])) bitmap[i / 8] |= static_cast<uint8_t>(0x80 >> (i % 8));
+            }
+            conn.sendData(
+                MessageWriter::response(request.header, Status::OK).bytes(bitmap.data(), bitmap.size()).finish());
         } else {
-            server_.sendMessage(clientId, "ERROR");
+            std::string bits;
+            bits.reserve(request.digests.size());
+            for (const auto& digest : request.digests) bits += store_->contains(digest) ? '1' : '0';
+            conn.sendMessage("PRESENT " + bits);
         }
+        break;
     }
-    server_.closeClient(clientId);
+    case Opcode::STATS: {
+        std::ostringstream stats;
+        stats << "chunks=" << store_->chunkCount();
+        if (cache_) {
+            CacheStats cache = cache_->stats();
+            stats << " cache_hits=" << cache.hits << " cache_misses=" << cache.misses
+                  << " cache_evictions=" << cache.evictions << " cache_chunks=" << cache.chunks
+                  << " cache_bytes=" << cache.bytes << " cache_budget=" << cache.budget;
+        }
+        if (request.binary) {
+            std::string text = stats.str();
+            conn.sendData(MessageWriter::response(request.header, Status::OK)
+                              .bytes(reinterpret_cast<const uint8_t*>(text.data()), text.size())
+                              .finish());
+        } else {
+            conn.sendMessage("STATS " + stats.str());
+        }
+        break;
+    }
+    case Opcode::DIE:
+        std::cout << "Received DIE command. Stopping..." << std::endl;
+        running_ = false;
+        server_.stop();
+        return false;
+    default:
+        reply(conn, request, Status::BAD_REQUEST);
+        break;
+    }
+    return true;
+}
+
+// Either format sends the chunk as its own raw frame after the reply, so it
+// can still go out with sendfile; a multiplexed GET sends the response
+// header and the chunk as one frame, so responses cannot interleave.
+// GET_RANGE goes the same way with only its slice of the chunk.
+void StorageNode::handleGet(dfs::network::Connection& conn, const Request& request) {
+    const common::Digest& hash = request.digests[0];
+    // A cached buffer, a file to send from, or else a reference to the
+    // stored bytes; none copies the chunk.
+    ChunkFile file;
+    SharedChunk data;
+    if (cache_) {
+        data = cache_->lookup(hash);
+        if (!data && zeroCopy_ && !cache_->remembered(hash) && store_->openChunk(hash, file)) {
+            cache_->remember(hash, file.length());
+        } else if (!data) {
+            data = store_->getShared(hash);
+            cache_->insert(hash, data, store_.get());
+        }
+    } else if (!zeroCopy_ || !store_->openChunk(hash, file)) {
+        data = store_->getShared(hash);
+    }
+    if (artificialDelay_.count() > 0) {
+        thread_local std::mt19937 gen(std::random_device{}());
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(gen) < delayProbability_) {
+            std::this_thread::sleep_for(artificialDelay_);
+        }
+    }
+    size_t size = file ? file.length() : (data ? data->size() : 0);
+    if (size == 0) {
+        reply(conn, request, Status::NOT_FOUND);
+        return;
+    }
+    uint64_t offset = 0;
+    size_t len = size;
+    if (request.op == Opcode::GET_RANGE) {
+        if (request.rangeOffset >= size) {
+            reply(conn, request, Status::BAD_REQUEST);
+            return;
+        }
+        offset = request.rangeOffset;
+        len = std::min<size_t>(request.rangeLength, size - offset);
+    }
+    bool multiplexed = request.header.flags & dfs::network::kFlagMultiplexed;
+    if (file) {
+        if (multiplexed) {
+            conn.sendFile(file.fd(), file.offset() + offset, len,
+                          MessageWriter::response(request.header, Status::OK).finish(len));
+        } else {
+            reply(conn, request, Status::OK);
+            conn.sendFile(file.fd(), file.offset() + offset, len);
+        }
+    } else {
+        if (multiplexed) {
+            conn.sendData(MessageWriter::response(request.header, Status::OK).finish(len), data->data() + offset, len);
+        } else {
+            reply(conn, request, Status::OK);
+            conn.sendData(data->data() + offset, len);
+        }
+    }
+    if (verbose_) std::cout << "Served chunk: " << hash << std::endl;
+}
+
+// Each chunk of the batch is checked against its digest and stored on its
+// own; the response carries one status per chunk, in request order.
+void StorageNode::handleStoreMulti(dfs::network::Connection& conn, const Request& request,
+                                   const std::vector<uint8_t>& frame) {
+    std::vector<uint8_t> statuses(request.digests.size(), static_cast<uint8_t>(Status::OK));
+    size_t stored = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < request.digests.size(); ++i) {
+        const common::Digest& hash = request.digests[i];
+        const uint8_t* data = frame.data() + request.extents[i].first;
+        size_t len = request.extents[i].second;
+        if (len == 0 || common::sha256(data, len) != hash) {
+            std::cerr << "Rejected chunk " << hash << ": content does not match" << std::endl;
+            statuses[i] = static_cast<uint8_t>(Status::ERROR);
+        } else if (!store_->putBytes(hash, data, len)) {
+            std::cerr << "Failed to store chunk " << hash << std::endl;
+            statuses[i] = static_cast<uint8_t>(Status::ERROR);
+        } else {
+            stored++;
+            bytes += len;
+        }
+    }
+    conn.sendData(MessageWriter::response(request.header, Status::OK).bytes(statuses.data(), statuses.size()).finish());
+    if (verbose_ && stored > 0) {
+        std::cout << "Stored " << stored << " chunks in one batch (" << bytes << " bytes)" << std::endl;
+    }
+}
+
+// Chunks are copied into the one response frame; past kMaxBatchBytes the
+// rest are answered ERROR and left for single GETs.
+void StorageNode::handleGetMulti(dfs::network::Connection& conn, const Request& request) {
+    MessageWriter response = MessageWriter::response(request.header, Status::OK);
+    size_t bytes = 0;
+    for (const common::Digest& hash : request.digests) {
+        SharedChunk data = cache_ ? cache_->lookup(hash) : nullptr;
+        if (!data) data = store_->getShared(hash);
+        if (!data || data->empty()) {
+            response.u8(static_cast<uint8_t>(Status::NOT_FOUND));
+        } else if (bytes + data->size() > dfs::network::kMaxBatchBytes) {
+            response.u8(static_cast<uint8_t>(Status::ERROR));
+        } else {
+            response.u8(static_cast<uint8_t>(Status::OK)).u32(static_cast<uint32_t>(data->size()));
+            response.bytes(data->data(), data->size());
+            bytes += data->size();
+        }
+    }
+    conn.sendData(response.finish());
 }
 
 }  // namespace storage
@@ -1,12 +1,20 @@
 #pragma once
 
+#include "common/digest.hpp"
+#include "common/thread_pool.hpp"
+#include "network/protocol.hpp"
 #include "network/tcp_server.hpp"
+#include "storage/chunk_cache.hpp"
+#include "storage/chunk_store.hpp"
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace dfs {
@@ -14,16 +22,77 @@ namespace storage {
 
 class StorageNode {
 public:
-    StorageNode();
+    // Keeps chunks in `store`, or in memory when none is given.
+    explicit StorageNode(std::unique_ptr<ChunkStore> store = nullptr);
     ~StorageNode();
-    void start(int port);
+    void start(int port, dfs::network::ServerMode mode = dfs::network::ServerMode::THREADED);
+    void setVerbose(bool verbose) { verbose_ = verbose; }
+    // Serve GETs with sendfile(2) when the store keeps chunks in files.
+    // On by default; off forces the copy through get().
+    void setZeroCopy(bool enabled) { zeroCopy_ = enabled; }
+    // Keeps up to `bytes` of frequently read chunks in memory in front of
+    // the store (0 disables it). Useful in front of the log and files
+    // engines. With zero-copy on, a chunk's first miss is still sent with
+    // sendfile and the kernel's page cache stands in for A1in; a repeat
+    // miss reads it into the cache. Call before start().
+    void setCacheBudget(size_t bytes);
+    // URING mode only: poll the submission queue from a kernel thread.
+    void setSqPoll(bool enabled) { server_.setSqPoll(enabled); }
+    // Testing aid: holds back a GET response by `delay` with the given
+    // probability, to simulate a slow replica.
+    void setArtificialDelay(std::chrono::milliseconds delay, double probability = 1.0);
 
 private:
+    // A request decoded from either wire format; replies go out in the same one.
+    struct Request {
+        dfs::network::Opcode op{dfs::network::Opcode::PING};
+        std::vector<common::Digest> digests;
+        bool binary{false};
+        dfs::network::MessageHeader header;
+        // Multiplexed STORE: where the chunk starts in the request frame.
+        size_t dataOffset{0};
+        // STORE_MULTI: offset and length of each digest's chunk in the frame.
+        std::vector<std::pair<size_t, size_t>> extents;
+        // GET_RANGE: the slice of the chunk asked for.
+        uint64_t rangeOffset{0};
+        uint32_t rangeLength{0};
+    };
+    // Per-connection protocol state: STORE is followed by a separate data frame.
+    struct ClientSession {
+        Request store;
+        bool awaitingData{false};
+    };
+
     void handleClient(int clientId);
+    bool handleFrame(dfs::network::Connection& conn, ClientSession& session, std::vector<uint8_t> frame);
+    // Runs a parsed request. `session` is null for multiplexed requests,
+    // which run on muxWorkers_ and carry STORE data inline.
+    bool execute(dfs::network::Connection& conn, ClientSession* session, Request& request,
+                 std::vector<uint8_t>& frame);
+    // False for malformed requests and unknown commands.
+    static bool parseRequest(const std::vector<uint8_t>& frame, Request& request);
+    void handleGet(dfs::network::Connection& conn, const Request& request);
+    void handleStoreMulti(dfs::network::Connection& conn, const Request& request, const std::vector<uint8_t>& frame);
+    void handleGetMulti(dfs::network::Connection& conn, const Request& request);
+    // Replies with just a status: a binary response, or the text word for it.
+    void reply(dfs::network::Connection& conn, const Request& request, dfs::network::Status status);
     dfs::network::TCPServer server_;
-    std::map<std::string, std::vector<uint8_t>> storage_;
-    std::mutex storageMutex_;
+    std::unique_ptr<ChunkStore> store_;
+    std::unique_ptr<ChunkCache> cache_;
+    // Multiplexed requests of one connection run here side by side, so a
+    // slow one does not hold back the responses behind it.
+    std::unique_ptr<common::ThreadPool> muxWorkers_;
+    static constexpr size_t kMultiplexWorkers = 16;
+    // Multiplexed requests of one connection running or queued on
+    // muxWorkers_ at once; twice the workers keeps them all busy.
+    static constexpr size_t kMaxMultiplexedRequests = 2 * kMultiplexWorkers;
+    std::map<int, ClientSession> sessions_;
+    std::mutex sessionsMutex_;
     std::atomic<bool> running_{false};
+    bool verbose_{true};
+    bool zeroCopy_{true};
+    std::chrono::milliseconds artificialDelay_{0};
+    double delayProbability_{0.0};
     std::atomic<int> activeHandlers_{0};
     std::condition_variable handlersCv_;
     std::mutex handlersMutex_;